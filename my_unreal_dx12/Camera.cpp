@@ -1 +1,21 @@
 #include "Camera.h"
+#include "Culling.h"
+
+using namespace DirectX;
+
+void Camera::UpdateViewConstants() const
+{
+	ViewConstants& c = m_constants;
+	c.view = m_view;
+	c.proj = m_proj;
+	c.viewProj = XMMatrixMultiply(m_view, m_proj);
+	c.invView = XMMatrixInverse(nullptr, m_view);
+	XMStoreFloat4x4(&c.viewProjTransposed, XMMatrixTranspose(c.viewProj));
+	XMStoreFloat3(&c.position, c.invView.r[3]);
+
+	FrustumCuller frustum;
+	frustum.SetViewProj(c.viewProj);
+	for (uint32_t i = 0; i < 6; ++i) c.frustumPlanes[i] = frustum.Planes()[i];
+
+	m_constantsDirty = false;
+}
@@ -1,6 +1,25 @@
 #pragma once
 #include <DirectXMath.h>
 
+/**
+ * @struct ViewConstants
+ * @brief Everything the passes need from the camera, computed once per frame.
+ */
+struct ViewConstants
+{
+	DirectX::XMMATRIX view = DirectX::XMMatrixIdentity();
+	DirectX::XMMATRIX proj = DirectX::XMMatrixIdentity();
+	DirectX::XMMATRIX viewProj = DirectX::XMMatrixIdentity();
+	DirectX::XMMATRIX invView = DirectX::XMMatrixIdentity();
+
+	/** viewProj transposed, ready to copy into a constant buffer. */
+	DirectX::XMFLOAT4X4 viewProjTransposed{};
+	DirectX::XMFLOAT3 position{ 0.f, 0.f, 0.f };
+
+	/** Left, right, bottom, top, far and near planes, normalized, pointing inside. */
+	DirectX::XMFLOAT4 frustumPlanes[6]{};
+};
+
 /**
  * @class Camera
  * @brief Represents a camera in the 3D scene.
@@ -20,6 +39,7 @@ public:
 	{
 		using namespace DirectX;
 		m_proj = XMMatrixPerspectiveFovLH(fovRadians, aspect, zNear, zFar);
+		m_constantsDirty = true;
 	}
 
 	/**
@@ -32,6 +52,7 @@ public:
 	{
 		using namespace DirectX;
 		m_view = XMMatrixLookAtLH(eye, at, up);
+		m_constantsDirty = true;
 	}
 
 	/**
@@ -50,19 +71,29 @@ public:
 	 * @brief Gets the position of the camera.
 	 * @return The position of the camera.
 	 */
-	DirectX::XMFLOAT3 getPosition() const
+	DirectX::XMFLOAT3 getPosition() const { return GetViewConstants().position; }
+
+	/**
+	 * @brief Gets the per-frame view constants.
+	 * They are recomputed on the first call after the view or projection changed.
+	 * @return The view constants.
+	 */
+	const ViewConstants& GetViewConstants() const
 	{
-		using namespace DirectX;
-		XMVECTOR det;
-		XMMATRIX invView = XMMatrixInverse(&det, m_view);
-		XMVECTOR pos = invView.r[3];
-		XMFLOAT3 position;
-		XMStoreFloat3(&position, pos);
-		return position;
+		if (m_constantsDirty) UpdateViewConstants();
+		return m_constants;
 	}
 
+	/**
+	 * @brief Recomputes the view constants from the current view and projection.
+	 */
+	void UpdateViewConstants() const;
+
 
 private:
 	DirectX::XMMATRIX m_view = DirectX::XMMatrixIdentity();
 	DirectX::XMMATRIX m_proj = DirectX::XMMatrixIdentity();
+
+	mutable ViewConstants m_constants;
+	mutable bool m_constantsDirty = true;
 };
\ No newline at end of file
@@ -1,12 +1,18 @@
 #pragma once
 #include <wrl.h>
 #include <d3d12.h>
+#include <vector>
 #include "Utils.h"
+#include "StateCache.h"
 
 /**
  * @class CommandContext
  * @brief Manages a command list and command allocators.
  * This class simplifies the process of recording and submitting command lists.
+ * Each frame in flight has its own allocator, and the context remembers the state bound on
+ * its list. Buffers bound on the list are kept alive until its frame slot is recorded again,
+ * which the renderer only does once the GPU is done with it. A context is recorded by one thread at a time, so the renderer gives each chunk
+ * of a pass recorded in parallel a context of its own.
  */
 class CommandContext
 {
@@ -17,7 +23,7 @@ public:
      */
     void Initialize(ID3D12Device* device)
     {
-        for (UINT i = 0; i < 2; ++i)
+        for (UINT i = 0; i < kMaxFramesInFlight; ++i)
         {
             DXThrow(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_alloc[i])));
         }
@@ -27,12 +33,25 @@ public:
 
     /**
      * @brief Begins a new command list.
-     * @param frameIndex The current frame index.
+     * @param frameSlot The slot of the frame in flight, whose previous work the GPU finished.
      */
-    void Begin(UINT frameIndex)
+    void Begin(UINT frameSlot)
     {
-        DXThrow(m_alloc[frameIndex]->Reset());
-        DXThrow(m_list->Reset(m_alloc[frameIndex].Get(), nullptr));
+        DXThrow(m_alloc[frameSlot]->Reset());
+        DXThrow(m_list->Reset(m_alloc[frameSlot].Get(), nullptr));
+        m_slot = frameSlot;
+        m_keepAlive[frameSlot].clear();
+        m_state.Invalidate();
+        m_state.ResetStats();
+    }
+
+    /**
+     * @brief Holds a reference on a resource until the GPU finished this frame.
+     * @param resource The resource read by the commands recorded so far.
+     */
+    void KeepAlive(ID3D12Resource* resource)
+    {
+        if (resource) m_keepAlive[m_slot].emplace_back(resource);
     }
 
     /**
@@ -49,7 +68,17 @@ public:
      */
     ID3D12GraphicsCommandList* Get() const { return m_list.Get(); }
 
+    /**
+     * @brief Gets the state bound on the command list since Begin.
+     * @return The state cache.
+     */
+    CommandStateCache<ID3D12GraphicsCommandList>& State() { return m_state; }
+    const CommandStateCache<ID3D12GraphicsCommandList>& State() const { return m_state; }
+
 private:
-    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_alloc[2];
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_alloc[kMaxFramesInFlight];
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_list;
-};
\ No newline at end of file
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_keepAlive[kMaxFramesInFlight];
+    UINT m_slot = 0;
+    CommandStateCache<ID3D12GraphicsCommandList> m_state;
+};
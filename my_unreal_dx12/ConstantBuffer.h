@@ -31,10 +31,51 @@ struct alignas(16) SceneCB
 
     DirectX::XMFLOAT3 uKe;
     float _pad1;
+
+    DirectX::XMFLOAT3 uTint;
+    /** Fraction of the pixels drawn, below 1 while the object fades out for its screen size. */
+    float uFade;
 };
 
 static_assert(sizeof(SceneCB) % 16 == 0, "SceneCB must be 16-byte aligned");
 
+/**
+ * @struct ImpostorCB
+ * @brief Represents the constant buffer data for an impostor quad.
+ * Starts like SceneCB, so the lighting fields sit at the same offsets.
+ */
+struct alignas(16) ImpostorCB
+{
+    DirectX::XMFLOAT4X4 uModel;
+    DirectX::XMFLOAT4X4 uViewProj;
+    DirectX::XMFLOAT4X4 uNormalMatrix;
+
+    DirectX::XMFLOAT3 uCameraPos;
+    float uFrames;
+
+    DirectX::XMFLOAT4X4 uLightViewProj;
+
+    DirectX::XMFLOAT3 uLightDir;
+    /** Radius of the sphere the atlas was baked around, in local units. */
+    float uAtlasRadius;
+
+    /** World-space sphere covered by the quad. */
+    DirectX::XMFLOAT3 uCenter;
+    float uRadius;
+
+    DirectX::XMFLOAT3 uTint;
+    /** The impostor covers the dither thresholds in [uFadeStart, uFadeEnd): the pixels
+     * left by the mesh it crossfades with, up to the mesh's screen-size fade. */
+    float uFadeStart;
+
+    float uFadeEnd;
+    float uFrameSize;
+    DirectX::XMFLOAT2 _pad1;
+};
+
+static_assert(sizeof(ImpostorCB) % 16 == 0, "ImpostorCB must be 16-byte aligned");
+static_assert(sizeof(ImpostorCB) <= sizeof(SceneCB), "ImpostorCB must fit in a SceneCB slice");
+
 /**
  * @class ConstantBuffer
  * @brief Manages a constant buffer resource.
@@ -77,11 +118,13 @@ public:
     /**
      * @brief Uploads a slice of data to the constant buffer.
      * @param sliceIndex The index of the slice to upload.
-     * @param data The data to upload.
+     * @param data The data to upload, a SceneCB or a smaller constant struct.
      * @return The GPU virtual address of the uploaded slice.
      */
-    D3D12_GPU_VIRTUAL_ADDRESS UploadSlice(UINT sliceIndex, const SceneCB& data)
+    template <typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS UploadSlice(UINT sliceIndex, const T& data)
     {
+        static_assert(sizeof(T) <= sizeof(SceneCB), "constants must fit in a slice");
         std::memcpy(m_mapped + sliceIndex * m_sliceSize, &data, sizeof(data));
         return m_resource->GetGPUVirtualAddress() + sliceIndex * m_sliceSize;
     }
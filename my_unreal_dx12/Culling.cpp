@@ -0,0 +1,187 @@
+#include "Culling.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+void FrustumCuller::SetViewProj(FXMMATRIX viewProj, bool keepNearPlane) {
+    // With row vectors, clip = v * M, so each clip coordinate is a dot product with a column.
+    const XMMATRIX t = XMMatrixTranspose(viewProj);
+    const XMVECTOR planes[6] = {
+        XMVectorAdd(t.r[3], t.r[0]),      // left:   x >= -w
+        XMVectorSubtract(t.r[3], t.r[0]), // right:  x <=  w
+        XMVectorAdd(t.r[3], t.r[1]),      // bottom: y >= -w
+        XMVectorSubtract(t.r[3], t.r[1]), // top:    y <=  w
+        XMVectorSubtract(t.r[3], t.r[2]), // far:    z <=  w
+        t.r[2],                           // near:   z >=  0
+    };
+    m_planeCount = keepNearPlane ? 6 : 5;
+    for (uint32_t i = 0; i < m_planeCount; ++i)
+        XMStoreFloat4(&m_planes[i], XMPlaneNormalize(planes[i]));
+}
+
+void FrustumCuller::SetPlanes(const XMFLOAT4* planes, uint32_t count) {
+    m_planeCount = std::min<uint32_t>(count, 6);
+    for (uint32_t i = 0; i < m_planeCount; ++i) m_planes[i] = planes[i];
+}
+
+CullResult FrustumCuller::Test(const BoundingBox& box) const {
+    CullResult r;
+    Test(&box, 1, &r);
+    return r;
+}
+
+void FrustumCuller::Test(const BoundingBox* boxes, size_t count, CullResult* results) const {
+    Test(boxes, count, results, nullptr);
+}
+
+void FrustumCuller::Test(const BoundingBox* boxes, size_t count, CullResult* results, float* margins) const {
+    const XMVECTOR zero = XMVectorZero();
+
+    for (size_t i = 0; i < count; i += 4) {
+        const size_t n = std::min<size_t>(4, count - i);
+
+        // Transpose four centers and extents into x, y and z vectors. A partial last group
+        // repeats its last box; the extra lanes are ignored.
+        XMMATRIX c, e;
+        for (size_t k = 0; k < 4; ++k) {
+            const BoundingBox& b = boxes[i + std::min(k, n - 1)];
+            c.r[k] = XMLoadFloat3(&b.Center);
+            e.r[k] = XMLoadFloat3(&b.Extents);
+        }
+        c = XMMatrixTranspose(c);
+        e = XMMatrixTranspose(e);
+
+        XMVECTOR outside = XMVectorFalseInt();
+        XMVECTOR straddling = XMVectorFalseInt();
+        // Depth of the nearest point inside all planes, and of the box behind its worst plane.
+        XMVECTOR depthInside = XMVectorReplicate(FLT_MAX);
+        XMVECTOR depthOutside = XMVectorReplicate(-FLT_MAX);
+        for (uint32_t p = 0; p < m_planeCount; ++p) {
+            const XMVECTOR plane = XMLoadFloat4(&m_planes[p]);
+            const XMVECTOR nx = XMVectorSplatX(plane);
+            const XMVECTOR ny = XMVectorSplatY(plane);
+            const XMVECTOR nz = XMVectorSplatZ(plane);
+
+            XMVECTOR dist = XMVectorMultiplyAdd(c.r[0], nx, XMVectorSplatW(plane));
+            dist = XMVectorMultiplyAdd(c.r[1], ny, dist);
+            dist = XMVectorMultiplyAdd(c.r[2], nz, dist);
+
+            XMVECTOR radius = XMVectorMultiply(e.r[0], XMVectorAbs(nx));
+            radius = XMVectorMultiplyAdd(e.r[1], XMVectorAbs(ny), radius);
+            radius = XMVectorMultiplyAdd(e.r[2], XMVectorAbs(nz), radius);
+
+            const XMVECTOR farthest = XMVectorAdd(dist, radius);
+            const XMVECTOR nearest = XMVectorSubtract(dist, radius);
+            outside = XMVectorOrInt(outside, XMVectorLess(farthest, zero));
+            straddling = XMVectorOrInt(straddling, XMVectorLess(nearest, zero));
+            depthInside = XMVectorMin(depthInside, nearest);
+            depthOutside = XMVectorMax(depthOutside, XMVectorNegate(farthest));
+        }
+
+        uint32_t out[4], cross[4];
+        XMStoreInt4(out, outside);
+        XMStoreInt4(cross, straddling);
+        for (size_t k = 0; k < n; ++k) {
+            results[i + k] = out[k] ? CullResult::Outside
+                           : cross[k] ? CullResult::Intersecting
+                           : CullResult::Inside;
+        }
+        if (!margins) continue;
+
+        float in[4], behind[4];
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(in), depthInside);
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(behind), depthOutside);
+        for (size_t k = 0; k < n; ++k)
+            margins[i + k] = out[k] ? behind[k] : cross[k] ? 0.f : in[k];
+    }
+}
+
+void CullHistory::BeginFrame(FXMMATRIX view, CXMMATRIX proj) {
+    XMFLOAT4X4 p;
+    XMStoreFloat4x4(&p, proj);
+    ++m_frame;
+    if (std::memcmp(&p, &m_proj, sizeof(p)) != 0) {
+        m_proj = p;
+        m_oldest = m_frame;
+    }
+
+    // The rows of the view rotation are the camera axes in world space.
+    XMFLOAT4X4 v;
+    XMStoreFloat4x4(&v, view);
+    Viewpoint& vp = m_views[m_frame % kMaxAge];
+    vp.axes[0] = XMFLOAT3(v._11, v._21, v._31);
+    vp.axes[1] = XMFLOAT3(v._12, v._22, v._32);
+    vp.axes[2] = XMFLOAT3(v._13, v._23, v._33);
+    XMStoreFloat3(&vp.eye, XMMatrixInverse(nullptr, view).r[3]);
+}
+
+void CullHistory::SetMaxAge(uint32_t frames) {
+    m_maxAge = std::clamp<uint32_t>(frames, 1, kMaxAge);
+}
+
+bool CullHistory::CanReuse(const CullCache& cache, const BoundingBox& bounds) const {
+    if (!cache.valid || cache.margin <= 0.f) return false;
+    if (cache.frame < m_oldest || m_frame - cache.frame >= m_maxAge) return false;
+
+    const Viewpoint& then = m_views[cache.frame % kMaxAge];
+    const Viewpoint& now = m_views[m_frame % kMaxAge];
+    const XMVECTOR eye = XMLoadFloat3(&then.eye);
+    const float moved = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&now.eye), eye)));
+
+    // trace(R) = 1 + 2 cos(angle), and |R n - n| <= 2 sin(angle / 2) = sqrt(2 - 2 cos(angle)).
+    float trace = 0.f;
+    for (int a = 0; a < 3; ++a)
+        trace += XMVectorGetX(XMVector3Dot(XMLoadFloat3(&then.axes[a]), XMLoadFloat3(&now.axes[a])));
+    const float chord = std::sqrt(std::max(0.f, 3.f - trace));
+
+    const float reach = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&bounds.Center), eye)))
+                      + XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+    return moved + reach * chord < cache.margin;
+}
+
+void ScreenSizeCuller::SetView(FXMMATRIX view, CXMMATRIX proj, float viewportHeight) {
+    XMFLOAT4X4 p;
+    XMStoreFloat4x4(&p, proj);
+    m_perspective = p._34 != 0.f;
+
+    // w = dot(world, column 3 of view * proj); a diameter d covers d * _22 / w half-viewports.
+    XMFLOAT4X4 vp;
+    XMStoreFloat4x4(&vp, XMMatrixMultiply(view, proj));
+    m_wPlane = XMFLOAT4(vp._14, vp._24, vp._34, vp._44);
+    m_pixelsPerUnit = 0.5f * p._22 * viewportHeight;
+}
+
+float ScreenSizeCuller::ProjectedSize(const BoundingSphere& sphere) const {
+    const float w = m_wPlane.x * sphere.Center.x + m_wPlane.y * sphere.Center.y
+                  + m_wPlane.z * sphere.Center.z + m_wPlane.w;
+    if (m_perspective && w <= sphere.Radius) return FLT_MAX;
+    return 2.f * sphere.Radius * m_pixelsPerUnit / w;
+}
+
+float ScreenSizeCuller::PixelsPerUnitAt(const BoundingSphere& sphere) const {
+    const float w = m_wPlane.x * sphere.Center.x + m_wPlane.y * sphere.Center.y
+                  + m_wPlane.z * sphere.Center.z + m_wPlane.w;
+    if (m_perspective && w <= sphere.Radius) return FLT_MAX;
+    return m_pixelsPerUnit / w;
+}
+
+uint32_t LodSelector::Select(const float* errors, uint32_t count, float pixelsPerUnit,
+    float threshold, float hysteresis, uint32_t current) {
+    if (count < 2) return 0;
+    current = std::min(current, count - 1);
+
+    auto coarsest = [&](float limit) {
+        for (uint32_t level = count - 1; level > 0; --level) {
+            if (errors[level] * pixelsPerUnit <= limit) return level;
+        }
+        return 0u;
+    };
+
+    const uint32_t coarser = coarsest(threshold * (1.f - hysteresis));
+    if (coarser > current) return coarser;
+    if (errors[current] * pixelsPerUnit <= threshold * (1.f + hysteresis)) return current;
+    return coarsest(threshold);
+}
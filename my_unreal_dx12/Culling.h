@@ -0,0 +1,282 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+/**
+ * @enum CullResult
+ * @brief Where a bounding box lies relative to a frustum.
+ */
+enum class CullResult : uint8_t
+{
+    Outside,
+    Intersecting,
+    Inside
+};
+
+/**
+ * @class FrustumCuller
+ * @brief Tests axis-aligned bounding boxes against the six planes of a view frustum.
+ * Boxes are processed four at a time: their centers and extents are transposed into
+ * x/y/z vectors so each plane is tested against four boxes with a handful of SIMD ops.
+ */
+class FrustumCuller
+{
+public:
+    /**
+     * @brief Extracts the frustum planes from a view-projection matrix.
+     * Works for any D3D-style projection (depth in [0, 1]), perspective or orthographic.
+     * @param viewProj The view-projection matrix, with row vectors as in DirectXMath.
+     * @param keepNearPlane False to leave the volume open towards the eye, e.g. for shadow
+     * casters that lie between the light and its near plane.
+     */
+    void SetViewProj(DirectX::FXMMATRIX viewProj, bool keepNearPlane = true);
+
+    /**
+     * @brief Sets the frustum planes directly.
+     * @param planes The planes, normalized, with normals pointing inside.
+     * @param count The number of planes, at most six.
+     */
+    void SetPlanes(const DirectX::XMFLOAT4* planes, uint32_t count);
+
+    /**
+     * @brief Gets the frustum planes.
+     * @return The planes, normalized, with normals pointing inside.
+     */
+    const DirectX::XMFLOAT4* Planes() const { return m_planes; }
+
+    /**
+     * @brief Gets the number of planes in use.
+     * @return The plane count.
+     */
+    uint32_t PlaneCount() const { return m_planeCount; }
+
+    /**
+     * @brief Tests one box.
+     * @param box The world-space box.
+     * @return Where the box lies relative to the frustum.
+     */
+    CullResult Test(const DirectX::BoundingBox& box) const;
+
+    /**
+     * @brief Tests an array of boxes, four per iteration.
+     * @param boxes The world-space boxes.
+     * @param count The number of boxes.
+     * @param results Receives one result per box.
+     */
+    void Test(const DirectX::BoundingBox* boxes, size_t count, CullResult* results) const;
+
+    /**
+     * @brief Tests an array of boxes and measures how far each one is from changing result.
+     * An inside box gets the distance from its nearest point to the nearest plane, an outside
+     * box the distance from the plane it lies furthest behind; boxes crossing a plane get zero.
+     * @param boxes The world-space boxes.
+     * @param count The number of boxes.
+     * @param results Receives one result per box.
+     * @param margins Receives one margin per box, in world units.
+     */
+    void Test(const DirectX::BoundingBox* boxes, size_t count, CullResult* results, float* margins) const;
+
+private:
+    DirectX::XMFLOAT4 m_planes[6]{};
+    uint32_t m_planeCount = 0;
+};
+
+/**
+ * @struct CullCache
+ * @brief The frustum result of an object, kept so later frames can reuse it.
+ */
+struct CullCache
+{
+    /** How far any point of the bounds may move relative to the planes before the result can change. */
+    float margin = 0.f;
+    /** CullHistory frame of the test. */
+    uint32_t frame = 0;
+    CullResult result = CullResult::Outside;
+    bool valid = false;
+};
+
+/**
+ * @class CullHistory
+ * @brief Remembers the viewpoints of the last frames so that frustum results can be reused
+ * while the view barely moves.
+ * The frustum keeps its shape and moves rigidly with the view, so between two frames a plane
+ * moves, at a point x, by at most |t| + |x - eye| * 2 sin(angle / 2), where t and angle are
+ * the translation and rotation of the view. A result stays valid as long as this bound is
+ * under the margin measured by FrustumCuller. Objects that move must drop their cache.
+ */
+class CullHistory
+{
+public:
+    static constexpr uint32_t kMaxAge = 16;
+
+    /**
+     * @brief Records the viewpoint of a new frame. A change of projection forgets the older
+     * frames, since the shape of the frustum changed.
+     * @param view The view matrix.
+     * @param proj The projection matrix.
+     */
+    void BeginFrame(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj);
+
+    /**
+     * @brief Forgets every viewpoint, so all cached results are tested again.
+     */
+    void Reset() { m_oldest = m_frame + 1; }
+
+    /**
+     * @brief Sets how many frames a result may be reused before it is tested again.
+     * @param frames The number of frames, clamped to [1, kMaxAge].
+     */
+    void SetMaxAge(uint32_t frames);
+
+    /**
+     * @brief Gets how many frames a result may be reused.
+     * @return The number of frames.
+     */
+    uint32_t MaxAge() const { return m_maxAge; }
+
+    /**
+     * @brief Checks whether a cached result still holds for the current viewpoint.
+     * @param cache The cached result.
+     * @param bounds The world-space bounds the result was computed for.
+     * @return True if the result can be used without testing.
+     */
+    bool CanReuse(const CullCache& cache, const DirectX::BoundingBox& bounds) const;
+
+    /**
+     * @brief Stores a result computed for the current viewpoint.
+     * @param cache Receives the result.
+     * @param result The frustum result.
+     * @param margin The margin measured by FrustumCuller.
+     */
+    void Store(CullCache& cache, CullResult result, float margin) const {
+        cache = { margin, m_frame, result, true };
+    }
+
+private:
+    struct Viewpoint {
+        DirectX::XMFLOAT3 eye;
+        /** Rows of the view rotation. */
+        DirectX::XMFLOAT3 axes[3];
+    };
+
+    Viewpoint m_views[kMaxAge]{};
+    DirectX::XMFLOAT4X4 m_proj{};
+    uint32_t m_frame = 0;
+    /** Oldest frame whose viewpoint is still valid. */
+    uint32_t m_oldest = 1;
+    uint32_t m_maxAge = 8;
+};
+
+/**
+ * @class ScreenSizeCuller
+ * @brief Estimates how many pixels an object covers on screen, so that objects too small
+ * to matter can be skipped. Works for perspective and orthographic projections.
+ */
+class ScreenSizeCuller
+{
+public:
+    /**
+     * @brief Sets the view the sizes are measured in.
+     * @param view The view matrix.
+     * @param proj The projection matrix.
+     * @param viewportHeight The height of the render target in pixels.
+     */
+    void SetView(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, float viewportHeight);
+
+    /**
+     * @brief Estimates the projected diameter of a sphere.
+     * @param sphere The world-space bounding sphere.
+     * @return The diameter in pixels, or FLT_MAX if the eye is inside the sphere.
+     */
+    float ProjectedSize(const DirectX::BoundingSphere& sphere) const;
+
+    /**
+     * @brief Gets how many pixels a world-space length covers at the depth of a sphere.
+     * @param sphere The world-space bounding sphere.
+     * @return The pixels per world unit, or FLT_MAX if the eye is inside the sphere.
+     */
+    float PixelsPerUnitAt(const DirectX::BoundingSphere& sphere) const;
+
+    /**
+     * @brief Decides whether an object is big enough to draw.
+     * An object that was dropped must grow past the threshold by the hysteresis fraction
+     * before it comes back, so objects hovering around the threshold do not flicker.
+     * @param size The projected size in pixels.
+     * @param threshold The minimum size in pixels.
+     * @param hysteresis The fraction of the threshold to add before showing a dropped object again.
+     * @param wasDropped Whether the object was dropped in the previous frame.
+     * @return True if the object should be drawn.
+     */
+    static bool Keep(float size, float threshold, float hysteresis, bool wasDropped) {
+        return size >= (wasDropped ? threshold * (1.f + hysteresis) : threshold);
+    }
+
+private:
+    /** Clip-space w as a function of the world position. */
+    DirectX::XMFLOAT4 m_wPlane{ 0.f, 0.f, 0.f, 1.f };
+    float m_pixelsPerUnit = 1.f;
+    bool m_perspective = true;
+};
+
+/**
+ * @class LodSelector
+ * @brief Picks a level of detail from the geometric error of each level.
+ */
+class LodSelector
+{
+public:
+    /**
+     * @brief Picks the coarsest level whose error, projected on screen, stays under a threshold.
+     * A coarser level is only taken once its error is under the threshold by the hysteresis
+     * fraction, and the current level is kept until its error is over it by the same
+     * fraction, so objects near a transition do not flicker.
+     * @param errors The geometric error of each level, from the finest to the coarsest.
+     * @param count The number of levels.
+     * @param pixelsPerUnit The pixels covered by one unit of error at the object.
+     * @param threshold The largest error allowed, in pixels.
+     * @param hysteresis The fraction of the threshold used as a margin.
+     * @param current The level used in the previous frame.
+     * @return The level to draw.
+     */
+    static uint32_t Select(const float* errors, uint32_t count, float pixelsPerUnit,
+        float threshold, float hysteresis, uint32_t current);
+};
+
+/**
+ * @struct CullingStats
+ * @brief Counts the objects tested and culled during a frame.
+ */
+struct CullingStats
+{
+    uint32_t meshesTested = 0;
+    uint32_t meshesCulled = 0;
+    uint32_t submeshesTested = 0;
+    uint32_t submeshesCulled = 0;
+    uint32_t shadowCastersTested = 0;
+    uint32_t shadowCastersCulled = 0;
+
+    /** Meshes and shadow casters dropped for their screen size; also counted as culled. */
+    uint32_t meshesTooSmall = 0;
+    uint32_t shadowCastersTooSmall = 0;
+
+    /** Meshes hidden behind occluders; they are also counted in meshesCulled. */
+    uint32_t meshesOccluded = 0;
+
+    /** Time spent rasterizing occluders and testing meshes against them, in milliseconds. */
+    float occlusionMs = 0.f;
+
+    /** Meshes drawn at a coarser level of detail, and the triangles it saved. */
+    uint32_t meshesReduced = 0;
+    uint32_t trianglesSaved = 0;
+    uint32_t shadowCastersReduced = 0;
+    uint32_t shadowTrianglesSaved = 0;
+
+    /** Meshes drawn as impostors, whether alone or while crossfading with the mesh. */
+    uint32_t meshesImpostored = 0;
+
+    /** Frustum tests skipped because the result of an earlier frame still held. */
+    uint32_t meshesReused = 0;
+    uint32_t shadowCastersReused = 0;
+};
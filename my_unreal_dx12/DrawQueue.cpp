@@ -0,0 +1,93 @@
+#include "DrawQueue.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+uint32_t DrawQueue::QuantizeDepth(float depth) {
+    if (!(depth > 0.f)) return 0;
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    // The sign bit is clear; drop it and the low mantissa bits.
+    return bits >> (31 - kDepthBits);
+}
+
+uint64_t DrawQueue::HashPointer(const void* p) {
+    // Allocations are aligned, so the low bits carry little; mix them all in.
+    uint64_t x = uint64_t(reinterpret_cast<uintptr_t>(p));
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return x;
+}
+
+void DrawQueue::Sort() {
+    const size_t count = m_items.size();
+    if (count < 2) return;
+
+    m_scratch.resize(count);
+    m_histograms.resize(size_t(kMaxLevels) << kDigitBits);
+    SortRange(m_items.data(), m_scratch.data(), count, true, 0);
+}
+
+void DrawQueue::SortRange(Item* src, Item* dst, size_t count, bool resultInSrc, uint32_t level) {
+    Item* const out = resultInSrc ? src : dst;
+    if (count <= kInsertionSortMax) {
+        if (!resultInSrc) std::memcpy(dst, src, count * sizeof(Item));
+        for (size_t i = 1; i < count; ++i) {
+            const Item item = out[i];
+            size_t j = i;
+            for (; j > 0 && out[j - 1].key > item.key; --j) out[j] = out[j - 1];
+            out[j] = item;
+        }
+        return;
+    }
+
+    // Only the bits that differ between the keys of the range need sorting.
+    uint64_t anyBits = 0, allBits = ~0ull;
+    for (size_t i = 0; i < count; ++i) {
+        anyBits |= src[i].key;
+        allBits &= src[i].key;
+    }
+    const uint64_t varying = anyBits ^ allBits;
+    if (!varying) {
+        if (!resultInSrc) std::memcpy(dst, src, count * sizeof(Item));
+        return;
+    }
+
+    // The digit takes the highest varying bits, and is narrower for smaller ranges.
+    uint32_t top = 64;
+    while (!(varying >> (top - 1))) --top;
+    uint32_t sizeBits = 0;
+    while ((count >> sizeBits) > 1) ++sizeBits;
+    const uint32_t bits = std::min<uint32_t>(top, std::min<uint32_t>(kDigitBits, std::max<uint32_t>(kMinDigitBits, sizeBits - 2)));
+    const uint32_t shift = top - bits;
+    const uint32_t buckets = 1u << bits;
+    const uint64_t mask = buckets - 1;
+
+    uint32_t* histogram = m_histograms.data() + (size_t(level) << kDigitBits);
+    std::fill(histogram, histogram + buckets, 0u);
+    for (size_t i = 0; i < count; ++i)
+        ++histogram[(src[i].key >> shift) & mask];
+    uint32_t offset = 0;
+    for (uint32_t bucket = 0; bucket < buckets; ++bucket) {
+        const uint32_t n = histogram[bucket];
+        histogram[bucket] = offset;
+        offset += n;
+    }
+    for (size_t i = 0; i < count; ++i)
+        dst[histogram[(src[i].key >> shift) & mask]++] = src[i];
+
+    // With no bits left below the digit, every bucket holds equal keys.
+    if (shift == 0) {
+        if (resultInSrc) std::memcpy(src, dst, count * sizeof(Item));
+        return;
+    }
+
+    // Each bucket now ends where the next one began; sort them on the remaining bits.
+    uint32_t begin = 0;
+    for (uint32_t bucket = 0; bucket < buckets; ++bucket) {
+        const uint32_t end = histogram[bucket];
+        if (end > begin) SortRange(dst + begin, src + begin, end - begin, !resultInSrc, level + 1);
+        begin = end;
+    }
+}
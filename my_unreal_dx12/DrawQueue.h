@@ -0,0 +1,140 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class DrawQueue
+ * @brief Draws of a pass, ordered by 64-bit sort keys.
+ * A key packs, from the most significant bits down, the pass, the pipeline, then the state
+ * and depth fields of the draw, so sorting the keys groups draws by state. Opaque keys put
+ * the material and mesh before the depth, so draws sharing state stay together and go out
+ * front to back within their group; transparent keys put the inverted depth first, so
+ * they go out back to front. Each draw carries a payload, typically the index of its
+ * command in an array of the caller.
+ * Keys are sorted with a stable MSD radix sort that only looks at the bits that differ
+ * between the keys of a range: fields shared by all draws, like the pass of a single-pass
+ * queue or the material inside a material group, cost nothing. Small ranges finish with an
+ * insertion sort.
+ */
+class DrawQueue
+{
+public:
+    /** Passes, in the order they are drawn. */
+    enum Pass : uint64_t { Opaque = 0, Transparent = 1 };
+
+    static constexpr uint32_t kPipelineBits = 2;
+    static constexpr uint32_t kMaterialBits = 20;
+    static constexpr uint32_t kMeshBits = 16;
+    static constexpr uint32_t kDepthBits = 24;
+
+    struct Item {
+        uint64_t key;
+        uint32_t payload;
+    };
+
+    /**
+     * @brief Builds the key of an opaque draw.
+     * @param pipeline The pipeline, under 2^kPipelineBits; draws sort by pipeline first.
+     * @param material Identifies the textures and material; only the low kMaterialBits are kept.
+     * @param mesh Identifies the geometry; only the low kMeshBits are kept.
+     * @param depth The distance from the eye, see QuantizeDepth.
+     * @return The key.
+     */
+    static uint64_t OpaqueKey(uint32_t pipeline, uint64_t material, uint64_t mesh, float depth) {
+        return (uint64_t(Opaque) << 62)
+             | (uint64_t(pipeline) << 60)
+             | ((material & ((1ull << kMaterialBits) - 1)) << 40)
+             | ((mesh & ((1ull << kMeshBits) - 1)) << 24)
+             | QuantizeDepth(depth);
+    }
+
+    /**
+     * @brief Builds the key of a transparent draw.
+     * @param pipeline The pipeline, under 2^kPipelineBits.
+     * @param material Identifies the textures and material; only the low kMaterialBits are kept.
+     * @param mesh Identifies the geometry; only the low kMeshBits are kept.
+     * @param depth The distance from the eye; farther draws come first.
+     * @return The key.
+     */
+    static uint64_t TransparentKey(uint32_t pipeline, uint64_t material, uint64_t mesh, float depth) {
+        return (uint64_t(Transparent) << 62)
+             | (uint64_t(pipeline) << 60)
+             | (uint64_t(((1u << kDepthBits) - 1) - QuantizeDepth(depth)) << 36)
+             | ((material & ((1ull << kMaterialBits) - 1)) << 16)
+             | (mesh & ((1ull << kMeshBits) - 1));
+    }
+
+    /**
+     * @brief Gets the pipeline field of a key.
+     * @param key A key built by OpaqueKey or TransparentKey.
+     * @return The pipeline.
+     */
+    static uint32_t PipelineOf(uint64_t key) { return uint32_t(key >> 60) & ((1u << kPipelineBits) - 1); }
+
+    /**
+     * @brief Maps a distance to kDepthBits bits, keeping its order.
+     * The bits of a positive float grow with its value, so the top bits of its exponent and
+     * mantissa give a logarithmic quantization without knowing the depth range.
+     * @param depth The distance; negative values count as zero.
+     * @return The quantized depth.
+     */
+    static uint32_t QuantizeDepth(float depth);
+
+    /**
+     * @brief Hashes a pointer into a key field.
+     * @param p The pointer.
+     * @return Well mixed bits; distinct pointers may still collide once truncated.
+     */
+    static uint64_t HashPointer(const void* p);
+
+    /**
+     * @brief Removes every draw.
+     */
+    void Clear() { m_items.clear(); }
+
+    /**
+     * @brief Adds a draw.
+     * @param key The sort key.
+     * @param payload The value handed back with the key.
+     */
+    void Push(uint64_t key, uint32_t payload) { m_items.push_back({ key, payload }); }
+
+    /**
+     * @brief Sorts the draws by key. Draws with equal keys keep the order they were pushed in.
+     */
+    void Sort();
+
+    /**
+     * @brief Gets the draws, in key order after Sort.
+     * @return The draws.
+     */
+    const std::vector<Item>& Items() const { return m_items; }
+
+    /**
+     * @brief Gets the number of draws.
+     * @return The draw count.
+     */
+    size_t Size() const { return m_items.size(); }
+
+private:
+    static constexpr uint32_t kDigitBits = 11;
+    static constexpr uint32_t kMinDigitBits = 4;
+    /** Every level but the last takes at least kMinDigitBits bits. */
+    static constexpr uint32_t kMaxLevels = 64 / kMinDigitBits + 1;
+    static constexpr size_t kInsertionSortMax = 32;
+
+    /**
+     * @brief Sorts a range by key.
+     * @param src The range.
+     * @param dst Scratch space of the same size.
+     * @param count The number of draws.
+     * @param resultInSrc Whether the sorted draws end up in src or in dst.
+     * @param level The recursion depth, which selects the histogram.
+     */
+    void SortRange(Item* src, Item* dst, size_t count, bool resultInSrc, uint32_t level);
+
+    std::vector<Item> m_items;
+    std::vector<Item> m_scratch;
+    std::vector<uint32_t> m_histograms;
+};
@@ -0,0 +1,243 @@
+#include "DynamicAABBTree.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace {
+    inline float HalfArea(FXMVECTOR bmin, FXMVECTOR bmax) {
+        XMFLOAT3 e;
+        XMStoreFloat3(&e, XMVectorSubtract(bmax, bmin));
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+}
+
+int32_t DynamicAABBTree::AllocateNode() {
+    if (m_freeList == kNullNode) {
+        m_nodes.push_back({});
+        m_nodes.back().parent = kNullNode;
+        m_freeList = int32_t(m_nodes.size()) - 1;
+    }
+    const int32_t id = m_freeList;
+    Node& n = m_nodes[id];
+    m_freeList = n.parent;
+    n.parent = kNullNode;
+    n.child1 = kNullNode;
+    n.child2 = kNullNode;
+    n.height = 0;
+    n.userData = nullptr;
+    return id;
+}
+
+void DynamicAABBTree::FreeNode(int32_t node) {
+    m_nodes[node].parent = m_freeList;
+    m_nodes[node].height = -1;
+    m_freeList = node;
+}
+
+void DynamicAABBTree::SetFatBounds(Node& node, const BoundingBox& box, FXMVECTOR displacement) const {
+    const XMVECTOR c = XMLoadFloat3(&box.Center), e = XMLoadFloat3(&box.Extents);
+    const float maxExtent = std::max({ box.Extents.x, box.Extents.y, box.Extents.z });
+    const XMVECTOR fat = XMVectorAdd(e, XMVectorReplicate(m_marginAbs + m_marginRel * maxExtent));
+
+    // Stretch only on the side the object is heading to.
+    const XMVECTOR d = XMVectorScale(displacement, m_displacementMultiplier);
+    const XMVECTOR zero = XMVectorZero();
+    XMStoreFloat3(&node.bmin, XMVectorAdd(XMVectorSubtract(c, fat), XMVectorMin(d, zero)));
+    XMStoreFloat3(&node.bmax, XMVectorAdd(XMVectorAdd(c, fat), XMVectorMax(d, zero)));
+}
+
+int32_t DynamicAABBTree::CreateProxy(const BoundingBox& box, void* userData) {
+    const int32_t proxy = AllocateNode();
+    SetFatBounds(m_nodes[proxy], box, XMVectorZero());
+    m_nodes[proxy].userData = userData;
+    InsertLeaf(proxy);
+    ++m_proxyCount;
+    return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(int32_t proxy) {
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    --m_proxyCount;
+}
+
+bool DynamicAABBTree::MoveProxy(int32_t proxy, const BoundingBox& box, FXMVECTOR displacement) {
+    Node& n = m_nodes[proxy];
+    const XMVECTOR c = XMLoadFloat3(&box.Center), e = XMLoadFloat3(&box.Extents);
+    if (XMVector3LessOrEqual(XMLoadFloat3(&n.bmin), XMVectorSubtract(c, e))
+        && XMVector3LessOrEqual(XMVectorAdd(c, e), XMLoadFloat3(&n.bmax)))
+        return false;
+
+    RemoveLeaf(proxy);
+    SetFatBounds(m_nodes[proxy], box, displacement);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void DynamicAABBTree::InsertLeaf(int32_t leaf) {
+    if (m_root == kNullNode) {
+        m_root = leaf;
+        m_nodes[leaf].parent = kNullNode;
+        return;
+    }
+
+    // Descend towards the sibling that minimizes the added surface area.
+    const XMVECTOR leafMin = XMLoadFloat3(&m_nodes[leaf].bmin);
+    const XMVECTOR leafMax = XMLoadFloat3(&m_nodes[leaf].bmax);
+    int32_t index = m_root;
+    while (!m_nodes[index].IsLeaf()) {
+        const Node& n = m_nodes[index];
+        const XMVECTOR nMin = XMLoadFloat3(&n.bmin), nMax = XMLoadFloat3(&n.bmax);
+        const float area = HalfArea(nMin, nMax);
+        const float combinedArea = HalfArea(XMVectorMin(nMin, leafMin), XMVectorMax(nMax, leafMax));
+
+        // Cost of pairing the leaf with this node, and the cost pushed down to its children.
+        const float cost = 2.f * combinedArea;
+        const float inheritance = 2.f * (combinedArea - area);
+
+        auto descendCost = [&](int32_t child) {
+            const Node& c = m_nodes[child];
+            const XMVECTOR cMin = XMLoadFloat3(&c.bmin), cMax = XMLoadFloat3(&c.bmax);
+            const float merged = HalfArea(XMVectorMin(cMin, leafMin), XMVectorMax(cMax, leafMax));
+            return c.IsLeaf() ? merged + inheritance : merged - HalfArea(cMin, cMax) + inheritance;
+        };
+        const float cost1 = descendCost(n.child1);
+        const float cost2 = descendCost(n.child2);
+
+        if (cost < cost1 && cost < cost2) break;
+        index = cost1 < cost2 ? n.child1 : n.child2;
+    }
+
+    const int32_t sibling = index;
+    const int32_t oldParent = m_nodes[sibling].parent;
+    const int32_t newParent = AllocateNode();
+
+    Node& p = m_nodes[newParent];
+    p.parent = oldParent;
+    p.height = m_nodes[sibling].height + 1;
+    XMStoreFloat3(&p.bmin, XMVectorMin(XMLoadFloat3(&m_nodes[sibling].bmin), leafMin));
+    XMStoreFloat3(&p.bmax, XMVectorMax(XMLoadFloat3(&m_nodes[sibling].bmax), leafMax));
+    p.child1 = sibling;
+    p.child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent == kNullNode) {
+        m_root = newParent;
+    }
+    else if (m_nodes[oldParent].child1 == sibling) {
+        m_nodes[oldParent].child1 = newParent;
+    }
+    else {
+        m_nodes[oldParent].child2 = newParent;
+    }
+
+    // The new parent already has its bounds, so the walk starts above it unless it rotates.
+    const int32_t top = Balance(newParent);
+    FixUpwards(m_nodes[top].parent);
+}
+
+void DynamicAABBTree::RemoveLeaf(int32_t leaf) {
+    if (leaf == m_root) {
+        m_root = kNullNode;
+        return;
+    }
+
+    const int32_t parent = m_nodes[leaf].parent;
+    const int32_t grandParent = m_nodes[parent].parent;
+    const int32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    if (grandParent == kNullNode) {
+        m_root = sibling;
+        m_nodes[sibling].parent = kNullNode;
+        FreeNode(parent);
+        return;
+    }
+
+    if (m_nodes[grandParent].child1 == parent) m_nodes[grandParent].child1 = sibling;
+    else m_nodes[grandParent].child2 = sibling;
+    m_nodes[sibling].parent = grandParent;
+    FreeNode(parent);
+
+    FixUpwards(grandParent);
+}
+
+void DynamicAABBTree::FixUpwards(int32_t index) {
+    while (index != kNullNode) {
+        const int32_t balanced = Balance(index);
+
+        Node& n = m_nodes[balanced];
+        const Node& a = m_nodes[n.child1];
+        const Node& b = m_nodes[n.child2];
+        const int32_t height = 1 + std::max(a.height, b.height);
+        const XMVECTOR mn = XMVectorMin(XMLoadFloat3(&a.bmin), XMLoadFloat3(&b.bmin));
+        const XMVECTOR mx = XMVectorMax(XMLoadFloat3(&a.bmax), XMLoadFloat3(&b.bmax));
+
+        // Ancestors only depend on the bounds and height of this node, so once neither
+        // changed the rest of the path is already correct.
+        if (balanced == index && height == n.height
+            && XMVector3Equal(mn, XMLoadFloat3(&n.bmin)) && XMVector3Equal(mx, XMLoadFloat3(&n.bmax)))
+            return;
+
+        n.height = height;
+        XMStoreFloat3(&n.bmin, mn);
+        XMStoreFloat3(&n.bmax, mx);
+        index = n.parent;
+    }
+}
+
+// Rotates node A's taller child up if the two subtrees differ in height by more than one.
+// Returns the node now at A's position.
+int32_t DynamicAABBTree::Balance(int32_t iA) {
+    Node& A = m_nodes[iA];
+    if (A.IsLeaf() || A.height < 2) return iA;
+
+    const int32_t iB = A.child1;
+    const int32_t iC = A.child2;
+    const int32_t balance = m_nodes[iC].height - m_nodes[iB].height;
+    if (balance >= -1 && balance <= 1) return iA;
+
+    // The taller child U is promoted; its children X and Y are shared between U and A.
+    const bool rotateC = balance > 1;
+    const int32_t iU = rotateC ? iC : iB;
+    const int32_t iOther = rotateC ? iB : iC;
+    Node& U = m_nodes[iU];
+    const int32_t iX = U.child1;
+    const int32_t iY = U.child2;
+    Node& X = m_nodes[iX];
+    Node& Y = m_nodes[iY];
+
+    U.child1 = iA;
+    U.parent = A.parent;
+    A.parent = iU;
+
+    if (U.parent != kNullNode) {
+        Node& up = m_nodes[U.parent];
+        if (up.child1 == iA) up.child1 = iU;
+        else up.child2 = iU;
+    }
+    else {
+        m_root = iU;
+    }
+
+    // The taller grandchild stays under U; the other one replaces U under A.
+    const bool keepX = X.height > Y.height;
+    const int32_t iKeep = keepX ? iX : iY;
+    const int32_t iMove = keepX ? iY : iX;
+    U.child2 = iKeep;
+    if (rotateC) A.child2 = iMove;
+    else A.child1 = iMove;
+    m_nodes[iMove].parent = iA;
+
+    const Node& other = m_nodes[iOther];
+    const Node& moved = m_nodes[iMove];
+    const Node& kept = m_nodes[iKeep];
+    XMStoreFloat3(&A.bmin, XMVectorMin(XMLoadFloat3(&other.bmin), XMLoadFloat3(&moved.bmin)));
+    XMStoreFloat3(&A.bmax, XMVectorMax(XMLoadFloat3(&other.bmax), XMLoadFloat3(&moved.bmax)));
+    XMStoreFloat3(&U.bmin, XMVectorMin(XMLoadFloat3(&A.bmin), XMLoadFloat3(&kept.bmin)));
+    XMStoreFloat3(&U.bmax, XMVectorMax(XMLoadFloat3(&A.bmax), XMLoadFloat3(&kept.bmax)));
+    A.height = 1 + std::max(other.height, moved.height);
+    U.height = 1 + std::max(A.height, kept.height);
+
+    return iU;
+}
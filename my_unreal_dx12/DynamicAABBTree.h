@@ -0,0 +1,241 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "Culling.h"
+
+/**
+ * @class DynamicAABBTree
+ * @brief Incrementally updated bounding volume tree over moving objects.
+ * Every object is a leaf (a proxy) holding a fat AABB: its bounds enlarged by a margin.
+ * Moving an object only touches the tree once it leaves its fat AABB, so small motions
+ * are free. Leaves are inserted where they increase the surface area the least, and
+ * AVL-style rotations keep the tree balanced as objects are added, removed and moved.
+ */
+class DynamicAABBTree
+{
+public:
+    static constexpr int32_t kNullNode = -1;
+
+    /**
+     * @brief Adds an object to the tree.
+     * @param box The world-space bounds of the object.
+     * @param userData A value returned with the proxy by queries.
+     * @return The proxy id.
+     */
+    int32_t CreateProxy(const DirectX::BoundingBox& box, void* userData);
+
+    /**
+     * @brief Removes an object from the tree.
+     * @param proxy The proxy id returned by CreateProxy.
+     */
+    void DestroyProxy(int32_t proxy);
+
+    /**
+     * @brief Updates the bounds of an object.
+     * When reinserted, the fat AABB is also stretched along the displacement, so an object
+     * moving at a steady velocity stays inside it for several frames.
+     * @param proxy The proxy id.
+     * @param box The new world-space bounds.
+     * @param displacement How far the object moved since the previous update.
+     * @return True if the proxy had to be reinserted because it left its fat AABB.
+     */
+    bool MoveProxy(int32_t proxy, const DirectX::BoundingBox& box, DirectX::FXMVECTOR displacement = DirectX::XMVectorZero());
+
+    /**
+     * @brief Gets the user data of a proxy.
+     * @param proxy The proxy id.
+     * @return The user data passed to CreateProxy.
+     */
+    void* GetUserData(int32_t proxy) const { return m_nodes[proxy].userData; }
+
+    /**
+     * @brief Sets the user data of a proxy.
+     * @param proxy The proxy id.
+     * @param userData The new user data.
+     */
+    void SetUserData(int32_t proxy, void* userData) { m_nodes[proxy].userData = userData; }
+
+    /**
+     * @brief Visits the proxies whose fat AABB overlaps a box.
+     * @param box The world-space box.
+     * @param visit Called with each proxy id.
+     */
+    template<typename Visitor>
+    void QueryBox(const DirectX::BoundingBox& box, Visitor&& visit) const;
+
+    /**
+     * @brief Visits the proxies whose fat AABB overlaps a sphere.
+     * @param center The sphere center.
+     * @param radius The sphere radius.
+     * @param visit Called with each proxy id.
+     */
+    template<typename Visitor>
+    void QuerySphere(DirectX::FXMVECTOR center, float radius, Visitor&& visit) const;
+
+    /**
+     * @brief Visits the proxies whose fat AABB is not outside a frustum.
+     * Subtrees entirely inside the frustum are reported without testing their leaves.
+     * @param culler The frustum.
+     * @param visit Called with each proxy id and where its fat AABB lies.
+     */
+    template<typename Visitor>
+    void QueryFrustum(const FrustumCuller& culler, Visitor&& visit) const;
+
+    /**
+     * @brief Gets the number of proxies.
+     * @return The proxy count.
+     */
+    uint32_t ProxyCount() const { return m_proxyCount; }
+
+    /**
+     * @brief Gets the height of the tree.
+     * @return The height of the root, or zero if the tree is empty.
+     */
+    int32_t Height() const { return m_root == kNullNode ? 0 : m_nodes[m_root].height; }
+
+    /**
+     * @brief Sets the margin added around object bounds.
+     * @param absolute A margin added on each side, in world units.
+     * @param relative A margin proportional to the size of the object.
+     */
+    void SetMargin(float absolute, float relative) { m_marginAbs = absolute; m_marginRel = relative; }
+
+    /**
+     * @brief Sets how far ahead the fat AABB of a reinserted proxy is stretched.
+     * @param multiplier The number of updates of the last displacement the fat AABB covers.
+     */
+    void SetDisplacementMultiplier(float multiplier) { m_displacementMultiplier = multiplier; }
+
+private:
+    struct Node {
+        DirectX::XMFLOAT3 bmin;
+        DirectX::XMFLOAT3 bmax;
+        void* userData;
+        /** Parent while in the tree, next free node while in the free list. */
+        int32_t parent;
+        int32_t child1;
+        int32_t child2;
+        /** Zero for leaves, -1 for free nodes. */
+        int32_t height;
+
+        bool IsLeaf() const { return child1 == kNullNode; }
+    };
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t node);
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    int32_t Balance(int32_t node);
+    void FixUpwards(int32_t node);
+    void SetFatBounds(Node& node, const DirectX::BoundingBox& box, DirectX::FXMVECTOR displacement) const;
+
+    static DirectX::BoundingBox ToBox(const Node& n);
+
+    std::vector<Node> m_nodes;
+    int32_t m_root = kNullNode;
+    int32_t m_freeList = kNullNode;
+    uint32_t m_proxyCount = 0;
+
+    float m_marginAbs = 0.5f;
+    float m_marginRel = 0.1f;
+    float m_displacementMultiplier = 24.f;
+
+    static constexpr int kStackSize = 256;
+};
+
+inline DirectX::BoundingBox DynamicAABBTree::ToBox(const Node& n) {
+    using namespace DirectX;
+    const XMVECTOR mn = XMLoadFloat3(&n.bmin), mx = XMLoadFloat3(&n.bmax);
+    BoundingBox b;
+    XMStoreFloat3(&b.Center, XMVectorScale(XMVectorAdd(mn, mx), 0.5f));
+    XMStoreFloat3(&b.Extents, XMVectorScale(XMVectorSubtract(mx, mn), 0.5f));
+    return b;
+}
+
+template<typename Visitor>
+void DynamicAABBTree::QueryBox(const DirectX::BoundingBox& box, Visitor&& visit) const {
+    using namespace DirectX;
+    if (m_root == kNullNode) return;
+
+    const XMVECTOR c = XMLoadFloat3(&box.Center), e = XMLoadFloat3(&box.Extents);
+    const XMVECTOR qmin = XMVectorSubtract(c, e), qmax = XMVectorAdd(c, e);
+
+    int32_t stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = m_root;
+    while (sp > 0) {
+        const Node& n = m_nodes[stack[--sp]];
+        if (!XMVector3LessOrEqual(XMLoadFloat3(&n.bmin), qmax) || !XMVector3LessOrEqual(qmin, XMLoadFloat3(&n.bmax)))
+            continue;
+        if (n.IsLeaf()) {
+            visit(int32_t(&n - m_nodes.data()));
+        }
+        else if (sp + 2 <= kStackSize) {
+            stack[sp++] = n.child1;
+            stack[sp++] = n.child2;
+        }
+    }
+}
+
+template<typename Visitor>
+void DynamicAABBTree::QuerySphere(DirectX::FXMVECTOR center, float radius, Visitor&& visit) const {
+    using namespace DirectX;
+    if (m_root == kNullNode) return;
+
+    const float radiusSq = radius * radius;
+    int32_t stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = m_root;
+    while (sp > 0) {
+        const Node& n = m_nodes[stack[--sp]];
+        const XMVECTOR closest = XMVectorClamp(center, XMLoadFloat3(&n.bmin), XMLoadFloat3(&n.bmax));
+        if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(closest, center))) > radiusSq)
+            continue;
+        if (n.IsLeaf()) {
+            visit(int32_t(&n - m_nodes.data()));
+        }
+        else if (sp + 2 <= kStackSize) {
+            stack[sp++] = n.child1;
+            stack[sp++] = n.child2;
+        }
+    }
+}
+
+template<typename Visitor>
+void DynamicAABBTree::QueryFrustum(const FrustumCuller& culler, Visitor&& visit) const {
+    using namespace DirectX;
+    if (m_root == kNullNode) return;
+
+    struct Entry { int32_t node; bool inside; };
+    Entry stack[kStackSize];
+    int sp = 0;
+
+    const CullResult rootResult = culler.Test(ToBox(m_nodes[m_root]));
+    if (rootResult == CullResult::Outside) return;
+    stack[sp++] = { m_root, rootResult == CullResult::Inside };
+
+    while (sp > 0) {
+        const Entry e = stack[--sp];
+        const Node& n = m_nodes[e.node];
+        if (n.IsLeaf()) {
+            visit(e.node, e.inside ? CullResult::Inside : CullResult::Intersecting);
+            continue;
+        }
+        if (sp + 2 > kStackSize) continue;
+
+        if (e.inside) {
+            stack[sp++] = { n.child1, true };
+            stack[sp++] = { n.child2, true };
+            continue;
+        }
+
+        // Both children are tested in one SIMD pass.
+        const BoundingBox boxes[2] = { ToBox(m_nodes[n.child1]), ToBox(m_nodes[n.child2]) };
+        CullResult results[2];
+        culler.Test(boxes, 2, results);
+        if (results[0] != CullResult::Outside) stack[sp++] = { n.child1, results[0] == CullResult::Inside };
+        if (results[1] != CullResult::Outside) stack[sp++] = { n.child2, results[1] == CullResult::Inside };
+    }
+}
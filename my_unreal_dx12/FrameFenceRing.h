@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @class FrameFenceRing
+ * @brief Tracks the frames in flight on a queue, so that per-frame resources, like command
+ * allocators and regions of upload buffers, are only reused once the GPU is done with them.
+ * Frames cycle through FrameCount() slots. EndFrame signals the fence and remembers the value
+ * in the slot of the frame; BeginFrame only blocks when the slot it is about to reuse still
+ * has work pending on the GPU.
+ * Nothing here depends on the graphics API. The fence type provides:
+ *   uint64_t Signal();            queues a signal of a new, larger value and returns it;
+ *   uint64_t CompletedValue();    returns the last value the GPU reached;
+ *   void WaitFor(uint64_t value); blocks until the GPU reaches the value;
+ * so a fake fence can drive the ring without a device.
+ */
+template <typename Fence>
+class FrameFenceRing
+{
+public:
+    static constexpr uint32_t kMaxFrames = 3;
+
+    /**
+     * @brief Sets up the ring.
+     * @param fence The fence signaled at the end of each frame; must outlive the ring.
+     * @param frameCount The number of frames in flight, from 1 to kMaxFrames.
+     */
+    void Initialize(Fence* fence, uint32_t frameCount)
+    {
+        m_fence = fence;
+        SetFrameCount(frameCount);
+    }
+
+    /**
+     * @brief Sets the number of frames the CPU may record ahead of the GPU.
+     * Takes effect from the next BeginFrame; slots beyond the new count are left alone.
+     * @param frameCount The number of frames in flight, clamped to [1, kMaxFrames].
+     */
+    void SetFrameCount(uint32_t frameCount)
+    {
+        m_count = frameCount < 1 ? 1 : frameCount > kMaxFrames ? kMaxFrames : frameCount;
+    }
+
+    /**
+     * @brief Gets the number of frames in flight.
+     * @return The frame count.
+     */
+    uint32_t FrameCount() const { return m_count; }
+
+    /**
+     * @brief Starts a frame, waiting for the GPU to finish the last frame recorded in its slot.
+     * @return The slot of the frame, under kMaxFrames.
+     */
+    uint32_t BeginFrame()
+    {
+        m_slot = m_next % m_count;
+        const uint64_t pending = m_values[m_slot];
+        m_waited = pending > m_fence->CompletedValue();
+        if (m_waited)
+            m_fence->WaitFor(pending);
+        return m_slot;
+    }
+
+    /**
+     * @brief Ends the frame; call it once its command lists are submitted.
+     */
+    void EndFrame()
+    {
+        m_values[m_slot] = m_fence->Signal();
+        m_next = (m_slot + 1) % m_count;
+    }
+
+    /**
+     * @brief Blocks until the GPU finished every frame submitted so far.
+     */
+    void WaitIdle()
+    {
+        m_fence->WaitFor(m_fence->Signal());
+    }
+
+    /**
+     * @brief Gets the slot of the frame being recorded.
+     * @return The slot.
+     */
+    uint32_t Slot() const { return m_slot; }
+
+    /**
+     * @brief Gets the fence value that marks the end of the last frame recorded in a slot.
+     * @param slot The slot.
+     * @return The fence value, zero if the slot was never used.
+     */
+    uint64_t SlotValue(uint32_t slot) const { return m_values[slot]; }
+
+    /**
+     * @brief Checks whether the last BeginFrame had to wait for the GPU.
+     * @return True if it blocked.
+     */
+    bool Waited() const { return m_waited; }
+
+private:
+    Fence* m_fence = nullptr;
+    uint64_t m_values[kMaxFrames] = {};
+    uint32_t m_count = 2;
+    uint32_t m_slot = 0;
+    uint32_t m_next = 0;
+    bool m_waited = false;
+};
@@ -106,8 +106,32 @@ public:
      * This method signals the fence and waits for the GPU to complete the work.
      */
     void WaitGPU() {
+        WaitFor(Signal());
+    }
+
+    /**
+     * @brief Signals the fence on the queue after the work submitted so far.
+     * @return The fence value the GPU reaches once that work is done.
+     */
+    UINT64 Signal() {
         const UINT64 v = ++m_fenceValue;
         DXThrow(m_queue->Signal(m_fence.Get(), v));
+        return v;
+    }
+
+    /**
+     * @brief Gets the last fence value the GPU reached.
+     * @return The completed value.
+     */
+    UINT64 CompletedValue() const {
+        return m_fence->GetCompletedValue();
+    }
+
+    /**
+     * @brief Blocks until the GPU reaches a fence value.
+     * @param v The value returned by Signal.
+     */
+    void WaitFor(UINT64 v) {
         if (m_fence->GetCompletedValue() < v) {
             DXThrow(m_fence->SetEventOnCompletion(v, m_fenceEvent.get()));
             const DWORD r = WaitForSingleObject(m_fenceEvent.get(), INFINITE);
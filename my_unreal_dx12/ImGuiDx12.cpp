@@ -17,4 +17,5 @@ void ImGuiDx12::Draw(Renderer &r)
 	}
     ImGui::End();
     m_imgui.Render(r.GetCommandList());
+    r.InvalidateState();
 }
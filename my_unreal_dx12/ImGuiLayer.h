@@ -42,7 +42,7 @@ public:
         ImGui_ImplWin32_Init(hwnd);
         ImGui_ImplDX12_Init(
             gd.Device(),
-            sc.BufferCount(),
+            kMaxFramesInFlight,
             DXGI_FORMAT_R8G8B8A8_UNORM,
             m_heap.Get(),
             m_heap->GetCPUDescriptorHandleForHeapStart(),
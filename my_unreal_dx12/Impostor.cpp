@@ -0,0 +1,224 @@
+#include "Impostor.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace {
+    // Uncovered texels take the color of a covered neighbor over this many passes, so
+    // bilinear filtering at the silhouette does not bleed the background in.
+    constexpr int kDilatePasses = 2;
+
+    inline float SignNotZero(float v) { return v >= 0.f ? 1.f : -1.f; }
+
+    inline uint8_t ToByte(float v) {
+        return uint8_t(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+    }
+
+    struct Texel
+    {
+        float depth = FLT_MAX;
+        XMFLOAT3 color{};
+        XMFLOAT3 normal{};
+    };
+
+    void DilateFrame(std::vector<uint8_t>& image, uint32_t atlasSize, uint32_t x0, uint32_t y0, uint32_t size) {
+        auto at = [&](uint32_t x, uint32_t y) { return (size_t(y0 + y) * atlasSize + x0 + x) * 4; };
+
+        std::vector<uint8_t> filled(size_t(size) * size), next;
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) filled[size_t(y) * size + x] = image[at(x, y) + 3] != 0;
+        }
+
+        for (int pass = 0; pass < kDilatePasses; ++pass) {
+            next = filled;
+            for (uint32_t y = 0; y < size; ++y) {
+                for (uint32_t x = 0; x < size; ++x) {
+                    if (filled[size_t(y) * size + x]) continue;
+                    uint32_t sum[3]{}, count = 0;
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        for (int dx = -1; dx <= 1; ++dx) {
+                            const int nx = int(x) + dx, ny = int(y) + dy;
+                            if (nx < 0 || ny < 0 || nx >= int(size) || ny >= int(size)) continue;
+                            if (!filled[size_t(ny) * size + nx]) continue;
+                            const size_t src = at(uint32_t(nx), uint32_t(ny));
+                            for (int c = 0; c < 3; ++c) sum[c] += image[src + c];
+                            ++count;
+                        }
+                    }
+                    if (!count) continue;
+                    const size_t dst = at(x, y);
+                    for (int c = 0; c < 3; ++c) image[dst + c] = uint8_t(sum[c] / count);
+                    next[size_t(y) * size + x] = 1;
+                }
+            }
+            filled.swap(next);
+        }
+    }
+}
+
+XMFLOAT2 ImpostorBaker::DirectionToGrid(FXMVECTOR direction, uint32_t frames) {
+    XMFLOAT3 d;
+    XMStoreFloat3(&d, direction);
+    const float l1 = std::fabs(d.x) + std::fabs(d.y) + std::fabs(d.z);
+    float u = 0.f, v = 0.f;
+    if (l1 > 0.f) {
+        u = d.x / l1;
+        v = d.z / l1;
+        // The lower hemisphere is folded over the corners of the square.
+        if (d.y < 0.f) {
+            const float fu = (1.f - std::fabs(v)) * SignNotZero(u);
+            const float fv = (1.f - std::fabs(u)) * SignNotZero(v);
+            u = fu;
+            v = fv;
+        }
+    }
+    return { (u * 0.5f + 0.5f) * float(frames) - 0.5f, (v * 0.5f + 0.5f) * float(frames) - 0.5f };
+}
+
+XMVECTOR ImpostorBaker::FrameDirection(uint32_t x, uint32_t y, uint32_t frames) {
+    const float u = (float(x) + 0.5f) / float(frames) * 2.f - 1.f;
+    const float v = (float(y) + 0.5f) / float(frames) * 2.f - 1.f;
+    float dy = 1.f - std::fabs(u) - std::fabs(v);
+    float dx = u, dz = v;
+    if (dy < 0.f) {
+        dx = (1.f - std::fabs(v)) * SignNotZero(u);
+        dz = (1.f - std::fabs(u)) * SignNotZero(v);
+    }
+    return XMVector3Normalize(XMVectorSet(dx, dy, dz, 0.f));
+}
+
+void ImpostorBaker::FrameBasis(FXMVECTOR direction, XMVECTOR& right, XMVECTOR& up) {
+    // Same axes as XMMatrixLookToLH looking back at the asset.
+    const XMVECTOR forward = XMVectorNegate(direction);
+    const XMVECTOR worldUp = std::fabs(XMVectorGetY(direction)) > 0.999f
+        ? XMVectorSet(0.f, 0.f, 1.f, 0.f)
+        : XMVectorSet(0.f, 1.f, 0.f, 0.f);
+    right = XMVector3Normalize(XMVector3Cross(worldUp, forward));
+    up = XMVector3Cross(forward, right);
+}
+
+std::shared_ptr<ImpostorAtlas> ImpostorBaker::BakeGeometry(const std::vector<Vertex>& vertices,
+    const std::vector<uint32_t>& indices, const std::vector<XMFLOAT3>& triangleColors,
+    const XMFLOAT3& sphereCenter, float radius, uint32_t frames, uint32_t frameSize) {
+    frames = std::max<uint32_t>(frames, 1);
+    frameSize = std::max<uint32_t>(frameSize, 1);
+
+    auto atlas = std::make_shared<ImpostorAtlas>();
+    atlas->frames = frames;
+    atlas->frameSize = frameSize;
+    atlas->center = sphereCenter;
+    atlas->radius = radius;
+
+    const uint32_t size = atlas->Size();
+    atlas->albedo.assign(size_t(size) * size * 4, 0);
+    atlas->normals.assign(size_t(size) * size * 4, 0);
+    if (vertices.empty() || indices.size() < 3 || atlas->radius <= 0.f) return atlas;
+
+    const uint32_t triangleCount = uint32_t(std::min(indices.size() / 3, triangleColors.size()));
+
+    const XMVECTOR center = XMLoadFloat3(&atlas->center);
+    const float invRadius = 1.f / atlas->radius;
+    const uint32_t frameCount = frames * frames;
+
+    // Frames write disjoint tiles of the atlas, so each can be rendered on its own thread.
+    JobSystem::I().ParallelFor(frameCount, 1, [&](uint32_t begin, uint32_t end) {
+        std::vector<Texel> texels;
+        std::vector<XMFLOAT3> projected(vertices.size());
+
+        for (uint32_t frame = begin; frame < end; ++frame) {
+            const uint32_t fx = frame % frames;
+            const uint32_t fy = frame / frames;
+            const XMVECTOR direction = FrameDirection(fx, fy, frames);
+            XMVECTOR right, up;
+            FrameBasis(direction, right, up);
+            const XMVECTOR forward = XMVectorNegate(direction);
+
+            // Pixel coordinates and depth of every vertex in this view.
+            const float half = 0.5f * float(frameSize);
+            for (size_t i = 0; i < vertices.size(); ++i) {
+                const XMVECTOR p = XMVectorScale(
+                    XMVectorSubtract(XMVectorSet(vertices[i].px, vertices[i].py, vertices[i].pz, 0.f), center), invRadius);
+                projected[i] = {
+                    (XMVectorGetX(XMVector3Dot(p, right)) + 1.f) * half,
+                    (1.f - XMVectorGetX(XMVector3Dot(p, up))) * half,
+                    XMVectorGetX(XMVector3Dot(p, forward)) };
+            }
+
+            texels.assign(size_t(frameSize) * frameSize, Texel{});
+            for (uint32_t t = 0; t < triangleCount; ++t) {
+                const uint32_t i0 = indices[t * 3], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+                if (i0 >= vertices.size() || i1 >= vertices.size() || i2 >= vertices.size()) continue;
+                const XMFLOAT3& a = projected[i0];
+                const XMFLOAT3& b = projected[i1];
+                const XMFLOAT3& c = projected[i2];
+
+                const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+                if (std::fabs(area) < 1e-12f) continue;
+                const float invArea = 1.f / area;
+
+                const int minX = std::max(0, int(std::floor(std::min({ a.x, b.x, c.x }))));
+                const int minY = std::max(0, int(std::floor(std::min({ a.y, b.y, c.y }))));
+                const int maxX = std::min(int(frameSize) - 1, int(std::ceil(std::max({ a.x, b.x, c.x }))));
+                const int maxY = std::min(int(frameSize) - 1, int(std::ceil(std::max({ a.y, b.y, c.y }))));
+
+                const Vertex& v0 = vertices[i0];
+                const Vertex& v1 = vertices[i1];
+                const Vertex& v2 = vertices[i2];
+                const XMFLOAT3& material = triangleColors[t];
+
+                // Both windings are drawn; the depth test keeps the closest surface.
+                for (int y = minY; y <= maxY; ++y) {
+                    const float py = float(y) + 0.5f;
+                    for (int x = minX; x <= maxX; ++x) {
+                        const float px = float(x) + 0.5f;
+                        const float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) * invArea;
+                        const float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) * invArea;
+                        const float w2 = 1.f - w0 - w1;
+                        if (w0 < 0.f || w1 < 0.f || w2 < 0.f) continue;
+
+                        Texel& texel = texels[size_t(y) * frameSize + x];
+                        const float depth = w0 * a.z + w1 * b.z + w2 * c.z;
+                        if (depth >= texel.depth) continue;
+                        texel.depth = depth;
+                        texel.color = {
+                            (w0 * v0.r + w1 * v1.r + w2 * v2.r) * material.x,
+                            (w0 * v0.g + w1 * v1.g + w2 * v2.g) * material.y,
+                            (w0 * v0.b + w1 * v1.b + w2 * v2.b) * material.z };
+                        texel.normal = {
+                            w0 * v0.nx + w1 * v1.nx + w2 * v2.nx,
+                            w0 * v0.ny + w1 * v1.ny + w2 * v2.ny,
+                            w0 * v0.nz + w1 * v1.nz + w2 * v2.nz };
+                    }
+                }
+            }
+
+            const uint32_t x0 = fx * frameSize, y0 = fy * frameSize;
+            for (uint32_t y = 0; y < frameSize; ++y) {
+                for (uint32_t x = 0; x < frameSize; ++x) {
+                    const Texel& texel = texels[size_t(y) * frameSize + x];
+                    if (texel.depth == FLT_MAX) continue;
+                    const size_t at = (size_t(y0 + y) * size + x0 + x) * 4;
+
+                    atlas->albedo[at + 0] = ToByte(texel.color.x);
+                    atlas->albedo[at + 1] = ToByte(texel.color.y);
+                    atlas->albedo[at + 2] = ToByte(texel.color.z);
+                    atlas->albedo[at + 3] = 255;
+
+                    XMFLOAT3 n;
+                    XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&texel.normal)));
+                    atlas->normals[at + 0] = ToByte(n.x * 0.5f + 0.5f);
+                    atlas->normals[at + 1] = ToByte(n.y * 0.5f + 0.5f);
+                    atlas->normals[at + 2] = ToByte(n.z * 0.5f + 0.5f);
+                    atlas->normals[at + 3] = 255;
+                }
+            }
+            DilateFrame(atlas->albedo, size, x0, y0, frameSize);
+            DilateFrame(atlas->normals, size, x0, y0, frameSize);
+        }
+    });
+
+    return atlas;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+class MeshAsset;
+class Texture;
+
+/**
+ * @struct ImpostorAtlas
+ * @brief Pre-rendered views of a mesh asset, drawn on a camera-facing quad in place of the
+ * mesh when it is far away.
+ * The views are taken from directions spread over the whole sphere and laid out on an
+ * octahedral grid: frame (x, y) holds the asset seen from ImpostorBaker::FrameDirection(x, y).
+ * Every frame is an orthographic view of the bounding sphere of the asset, so the asset
+ * fits in its frame from any direction.
+ */
+struct ImpostorAtlas
+{
+    /** Frames along each side of the atlas. */
+    uint32_t frames = 0;
+    /** Pixels along each side of a frame. */
+    uint32_t frameSize = 0;
+
+    /** Bounding sphere of the asset in local units; a frame spans its diameter. */
+    DirectX::XMFLOAT3 center{ 0.f, 0.f, 0.f };
+    float radius = 0.f;
+
+    /** Albedo in RGB and coverage in alpha, 4 bytes per pixel, row after row. */
+    std::vector<uint8_t> albedo;
+    /** Local-space normal remapped to [0, 1] in RGB and coverage in alpha. */
+    std::vector<uint8_t> normals;
+
+    /** GPU copies of the two images, created by the renderer on first use. */
+    std::shared_ptr<Texture> albedoTexture;
+    std::shared_ptr<Texture> normalTexture;
+
+    /**
+     * @brief Gets the size of the atlas.
+     * @return The width and height in pixels.
+     */
+    uint32_t Size() const { return frames * frameSize; }
+};
+
+/**
+ * @class ImpostorBaker
+ * @brief Renders impostor atlases on the CPU.
+ * Triangles are rasterized with a depth buffer into each frame. Vertex colors are multiplied
+ * by the diffuse color of their submesh and by the average color of its texture, since
+ * textures only live on the GPU; lighting is left to the impostor shader.
+ */
+class ImpostorBaker
+{
+public:
+    static constexpr uint32_t kDefaultFrames = 8;
+    static constexpr uint32_t kDefaultFrameSize = 64;
+
+    /**
+     * @brief Renders the views of an asset. Frames are spread over the job system.
+     * Assets whose CPU geometry was released are read back from the GPU first.
+     * @param asset The asset to render.
+     * @param frames The number of frames along each side of the atlas.
+     * @param frameSize The number of pixels along each side of a frame.
+     * @return The atlas, without its GPU textures.
+     */
+    static std::shared_ptr<ImpostorAtlas> Bake(const MeshAsset& asset,
+        uint32_t frames = kDefaultFrames, uint32_t frameSize = kDefaultFrameSize);
+
+    /**
+     * @brief Renders the views of raw geometry. Frames are spread over the job system.
+     * Bake gathers the geometry and colors of an asset and calls this.
+     * @param vertices The vertices, in the local space of the asset.
+     * @param indices The triangle list indices.
+     * @param triangleColors The material color of each triangle, multiplied by the vertex colors.
+     * @param sphereCenter The center of the bounding sphere the frames span.
+     * @param radius The radius of the bounding sphere.
+     * @param frames The number of frames along each side of the atlas.
+     * @param frameSize The number of pixels along each side of a frame.
+     * @return The atlas, without its GPU textures.
+     */
+    static std::shared_ptr<ImpostorAtlas> BakeGeometry(const std::vector<Vertex>& vertices,
+        const std::vector<uint32_t>& indices, const std::vector<DirectX::XMFLOAT3>& triangleColors,
+        const DirectX::XMFLOAT3& sphereCenter, float radius,
+        uint32_t frames = kDefaultFrames, uint32_t frameSize = kDefaultFrameSize);
+
+    /**
+     * @brief Maps a direction to continuous coordinates on the frame grid.
+     * Frame (x, y) is centered on coordinates (x, y).
+     * @param direction A local-space direction from the asset towards the viewer, not
+     * necessarily normalized.
+     * @param frames The number of frames along each side of the atlas.
+     * @return The grid coordinates, in [-0.5, frames - 0.5].
+     */
+    static DirectX::XMFLOAT2 DirectionToGrid(DirectX::FXMVECTOR direction, uint32_t frames);
+
+    /**
+     * @brief Gets the direction a frame was rendered from.
+     * @param x The frame column.
+     * @param y The frame row.
+     * @param frames The number of frames along each side of the atlas.
+     * @return The normalized local-space direction from the asset towards the viewer.
+     */
+    static DirectX::XMVECTOR FrameDirection(uint32_t x, uint32_t y, uint32_t frames);
+
+    /**
+     * @brief Gets the image plane of a view: the axes of the frame's u and v coordinates.
+     * The impostor shader builds the same basis to find where a point lands in a frame.
+     * @param direction The normalized direction towards the viewer.
+     * @param right Receives the axis along which u grows.
+     * @param up Receives the axis along which v decreases.
+     */
+    static void FrameBasis(DirectX::FXMVECTOR direction, DirectX::XMVECTOR& right, DirectX::XMVECTOR& up);
+};
@@ -0,0 +1,39 @@
+#include "Impostor.h"
+#include "MeshAsset.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+std::shared_ptr<ImpostorAtlas> ImpostorBaker::Bake(const MeshAsset& asset, uint32_t frames, uint32_t frameSize) {
+    std::vector<Vertex> readVertices;
+    std::vector<uint32_t> readIndices;
+    const std::vector<Vertex>* srcVertices = &asset.vertices;
+    const std::vector<uint32_t>* srcIndices = &asset.indices;
+    if (asset.IsCpuGeometryReleased()) {
+        asset.ReadBackGeometry(readVertices, readIndices);
+        srcVertices = &readVertices;
+        srcIndices = &readIndices;
+    }
+    const std::vector<Vertex>& vertices = *srcVertices;
+    const std::vector<uint32_t>& indices = *srcIndices;
+
+    // Color of every triangle's material: diffuse color times the average texture color.
+    const uint32_t triangleCount = uint32_t(indices.size() / 3);
+    std::vector<XMFLOAT3> triangleColor(triangleCount, XMFLOAT3(1.f, 1.f, 1.f));
+    auto materialColor = [](const XMFLOAT3& kd, const Texture* tex) {
+        if (!tex) return kd;
+        const XMFLOAT4& avg = tex->AverageColor();
+        return XMFLOAT3(kd.x * avg.x, kd.y * avg.y, kd.z * avg.z);
+    };
+    if (asset.submeshes.empty()) {
+        std::fill(triangleColor.begin(), triangleColor.end(), materialColor(XMFLOAT3(1.f, 1.f, 1.f), asset.texture.get()));
+    }
+    for (const Submesh& sm : asset.submeshes) {
+        const XMFLOAT3 color = materialColor(sm.kd, sm.texture ? sm.texture.get() : asset.texture.get());
+        const uint32_t first = std::min(sm.indexStart / 3, triangleCount);
+        const uint32_t last = std::min((sm.indexStart + sm.indexCount) / 3, triangleCount);
+        std::fill(triangleColor.begin() + first, triangleColor.begin() + last, color);
+    }
+
+    return BakeGeometry(vertices, indices, triangleColor, asset.sphere.Center, asset.sphere.Radius, frames, frameSize);
+}
@@ -0,0 +1,110 @@
+cbuffer Impostor : register(b0)
+{
+    float4x4 uModel;
+    float4x4 uViewProj;
+    float4x4 uNormalMatrix;
+
+    float3 uCameraPos;
+    float uFrames;
+
+    float4x4 uLightViewProj;
+
+    float3 uLightDir;
+    float uAtlasRadius;
+
+    float3 uCenter;
+    float uRadius;
+
+    float3 uTint;
+    float uFadeStart;
+
+    float uFadeEnd;
+    float uFrameSize;
+    float2 _pad1;
+};
+
+Texture2D uAlbedoAtlas : register(t0);
+Texture2D uShadowMap : register(t1);
+Texture2D uNormalAtlas : register(t2);
+
+SamplerState uSampler : register(s0);
+SamplerState uShadowSampler : register(s1);
+
+static const float3 kLightColor = float3(1.0, 0.98, 0.90);
+static const float3 kAmbient = float3(0.25, 0.25, 0.25);
+
+// Same pattern as PixelShader.hlsl, so the mesh and its impostor cover complementary pixels.
+static const float kBayer4x4[16] =
+{
+    0.0f, 8.0f, 2.0f, 10.0f,
+    12.0f, 4.0f, 14.0f, 6.0f,
+    3.0f, 11.0f, 1.0f, 9.0f,
+    15.0f, 7.0f, 13.0f, 5.0f
+};
+
+struct VSOut
+{
+    float4 pos : SV_Position;
+    float3 worldPos : TEXCOORD0;
+    float4 shadowPos : TEXCOORD1;
+    float2 frameUV0 : TEXCOORD2;
+    float2 frameUV1 : TEXCOORD3;
+    float2 frameUV2 : TEXCOORD4;
+    float2 frameUV3 : TEXCOORD5;
+    nointerpolation float4 cells01 : TEXCOORD6;
+    nointerpolation float4 cells23 : TEXCOORD7;
+    nointerpolation float4 weights : TEXCOORD8;
+};
+
+void SampleFrame(float2 uv, float2 cell, float weight, inout float4 albedo, inout float4 normal)
+{
+    if (weight <= 0.0f || any(uv < 0.0f) || any(uv > 1.0f))
+        return;
+
+    // Stay half a texel inside the frame so filtering does not reach the next one.
+    float halfTexel = 0.5f / uFrameSize;
+    float2 atlasUV = (cell + clamp(uv, halfTexel, 1.0f - halfTexel)) / uFrames;
+
+    float4 a = uAlbedoAtlas.Sample(uSampler, atlasUV);
+    float3 n = uNormalAtlas.Sample(uSampler, atlasUV).xyz * 2.0f - 1.0f;
+    float w = weight * a.a;
+    albedo += float4(a.rgb * w, w);
+    normal += float4(n * w, weight);
+}
+
+float ComputeShadow(float4 shadowPos)
+{
+    float3 proj = shadowPos.xyz / shadowPos.w;
+    float2 uv = proj.xy * float2(0.5, -0.5) + 0.5;
+    if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0 || proj.z <= 0.0 || proj.z >= 1.0)
+        return 1.0;
+    return step(proj.z - 0.0005f, uShadowMap.Sample(uShadowSampler, uv).r);
+}
+
+float4 main(VSOut i) : SV_Target
+{
+    uint2 p = uint2(i.pos.xy) & 3;
+    float threshold = (kBayer4x4[p.y * 4 + p.x] + 0.5f) / 16.0f;
+    if (threshold < uFadeStart || threshold >= uFadeEnd)
+        discard;
+
+    float4 albedo = 0.0f;
+    float4 normal = 0.0f;
+    SampleFrame(i.frameUV0, i.cells01.xy, i.weights.x, albedo, normal);
+    SampleFrame(i.frameUV1, i.cells01.zw, i.weights.y, albedo, normal);
+    SampleFrame(i.frameUV2, i.cells23.xy, i.weights.z, albedo, normal);
+    SampleFrame(i.frameUV3, i.cells23.zw, i.weights.w, albedo, normal);
+
+    // Coverage is the weighted alpha of the frames the pixel falls in.
+    if (normal.w <= 0.0f || albedo.w < 0.5f * normal.w)
+        discard;
+
+    float3 color = albedo.rgb / albedo.w * uTint;
+    float3 N = normalize(mul(normal.xyz, (float3x3) uNormalMatrix));
+    float3 L = normalize(uLightDir);
+    float NdotL = saturate(dot(N, L));
+
+    float shadow = ComputeShadow(i.shadowPos);
+    float3 lighting = kAmbient + shadow * kLightColor * NdotL;
+    return float4(color * lighting, 1.0f);
+}
@@ -0,0 +1,127 @@
+cbuffer Impostor : register(b0)
+{
+    float4x4 uModel;
+    float4x4 uViewProj;
+    float4x4 uNormalMatrix;
+
+    float3 uCameraPos;
+    float uFrames;
+
+    float4x4 uLightViewProj;
+
+    float3 uLightDir;
+    float uAtlasRadius;
+
+    float3 uCenter;
+    float uRadius;
+
+    float3 uTint;
+    float uFadeStart;
+
+    float uFadeEnd;
+    float uFrameSize;
+    float2 _pad1;
+};
+
+struct VSIn
+{
+    float3 pos : POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+struct VSOut
+{
+    float4 pos : SV_Position;
+    float3 worldPos : TEXCOORD0;
+    float4 shadowPos : TEXCOORD1;
+    // Position of the pixel in each of the 4 nearest frames.
+    float2 frameUV0 : TEXCOORD2;
+    float2 frameUV1 : TEXCOORD3;
+    float2 frameUV2 : TEXCOORD4;
+    float2 frameUV3 : TEXCOORD5;
+    nointerpolation float4 cells01 : TEXCOORD6;
+    nointerpolation float4 cells23 : TEXCOORD7;
+    nointerpolation float4 weights : TEXCOORD8;
+};
+
+float2 SignNotZero(float2 v)
+{
+    return float2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// Must match ImpostorBaker::DirectionToGrid and FrameDirection.
+float2 OctEncode(float3 d)
+{
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    float2 p = d.xz;
+    if (d.y < 0.0f)
+        p = (1.0f - abs(p.yx)) * SignNotZero(p);
+    return p * 0.5f + 0.5f;
+}
+
+float3 OctDecode(float2 uv)
+{
+    float2 p = uv * 2.0f - 1.0f;
+    float3 d = float3(p.x, 1.0f - abs(p.x) - abs(p.y), p.y);
+    if (d.y < 0.0f)
+        d.xz = (1.0f - abs(p.yx)) * SignNotZero(p);
+    return normalize(d);
+}
+
+// Must match ImpostorBaker::FrameBasis.
+void FrameBasis(float3 dir, out float3 right, out float3 up)
+{
+    float3 forward = -dir;
+    float3 worldUp = abs(dir.y) > 0.999f ? float3(0.0f, 0.0f, 1.0f) : float3(0.0f, 1.0f, 0.0f);
+    right = normalize(cross(worldUp, forward));
+    up = cross(forward, right);
+}
+
+float2 FrameUV(float3 p, float2 cell)
+{
+    float3 right, up;
+    FrameBasis(OctDecode((cell + 0.5f) / uFrames), right, up);
+    return float2(dot(p, right), -dot(p, up)) * 0.5f + 0.5f;
+}
+
+VSOut main(VSIn v)
+{
+    VSOut o;
+
+    // Camera-facing quad covering the bounding sphere.
+    float3 viewDir = normalize(uCameraPos - uCenter);
+    float3 right, up;
+    FrameBasis(viewDir, right, up);
+    float2 corner = float2(v.uv.x * 2.0f - 1.0f, 1.0f - v.uv.y * 2.0f);
+    float3 world = uCenter + (right * corner.x + up * corner.y) * uRadius;
+
+    o.pos = mul(float4(world, 1.0f), uViewProj);
+    o.worldPos = world;
+    // The quad cuts through the middle of the object; moving the shadow lookup to the lit
+    // side keeps the object from shadowing its own impostor.
+    o.shadowPos = mul(float4(world + normalize(uLightDir) * uRadius, 1.0f), uLightViewProj);
+
+    // The atlas was baked in local space, where the inverse model matrix takes us.
+    float3x3 toLocal = (float3x3) uNormalMatrix;
+    float3 localDir = normalize(mul(toLocal, viewDir));
+    float3 localPoint = mul(toLocal, world - uCenter) / uAtlasRadius;
+
+    // Blend the 4 frames around the view direction.
+    float2 grid = OctEncode(localDir) * uFrames - 0.5f;
+    float2 base = clamp(floor(grid), 0.0f, max(uFrames - 2.0f, 0.0f));
+    float2 f = saturate(grid - base);
+    o.weights = float4((1.0f - f.x) * (1.0f - f.y), f.x * (1.0f - f.y), (1.0f - f.x) * f.y, f.x * f.y);
+
+    float2 cell0 = base;
+    float2 cell1 = min(base + float2(1.0f, 0.0f), uFrames - 1.0f);
+    float2 cell2 = min(base + float2(0.0f, 1.0f), uFrames - 1.0f);
+    float2 cell3 = min(base + float2(1.0f, 1.0f), uFrames - 1.0f);
+    o.cells01 = float4(cell0, cell1);
+    o.cells23 = float4(cell2, cell3);
+    o.frameUV0 = FrameUV(localPoint, cell0);
+    o.frameUV1 = FrameUV(localPoint, cell1);
+    o.frameUV2 = FrameUV(localPoint, cell2);
+    o.frameUV3 = FrameUV(localPoint, cell3);
+
+    return o;
+}
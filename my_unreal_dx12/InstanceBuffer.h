@@ -0,0 +1,128 @@
+#pragma once
+#include <wrl.h>
+#include <atomic>
+#include <d3d12.h>
+#include <cstdint>
+#include <cstring>
+#include <DirectXMath.h>
+#include "Utils.h"
+
+/**
+ * @struct InstanceData
+ * @brief Per-instance data read by the main vertex shader from a structured buffer.
+ * Must match InstanceData in VertexShader.hlsl.
+ */
+struct InstanceData
+{
+    /** Model matrix and inverse model matrix, transposed like in SceneCB. */
+    DirectX::XMFLOAT4X4 model;
+    DirectX::XMFLOAT4X4 normalMatrix;
+
+    DirectX::XMFLOAT3 tint;
+    /** Fraction of the pixels drawn; see SceneCB::uFade. */
+    float fade;
+};
+
+static_assert(sizeof(InstanceData) % 16 == 0, "InstanceData must be a multiple of 16 bytes");
+
+/**
+ * @class InstanceBuffer
+ * @brief Upload buffer holding the instances of every draw of a frame, one region per
+ * frame in flight. Draws bind the address of their first instance as a root SRV, so
+ * instance IDs start at zero in every draw.
+ * Allocate, Write and Address may be called from several recording threads at once.
+ */
+class InstanceBuffer
+{
+public:
+    /**
+     * @brief Creates the buffer.
+     * @param device The D3D12 device.
+     * @param instancesPerFrame The number of instances a frame can hold.
+     * @param frameCount The number of frames in flight.
+     */
+    void Create(ID3D12Device* device, UINT instancesPerFrame, UINT frameCount)
+    {
+        m_capacity = instancesPerFrame;
+
+        D3D12_HEAP_PROPERTIES heap{};
+        heap.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+        D3D12_RESOURCE_DESC buf{};
+        buf.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        buf.Width = UINT64(sizeof(InstanceData)) * instancesPerFrame * frameCount;
+        buf.Height = 1;
+        buf.DepthOrArraySize = 1;
+        buf.MipLevels = 1;
+        buf.SampleDesc = { 1, 0 };
+        buf.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+        DXThrow(device->CreateCommittedResource(
+            &heap, D3D12_HEAP_FLAG_NONE,
+            &buf, D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, IID_PPV_ARGS(&m_resource)));
+
+        D3D12_RANGE r{ 0, 0 };
+        DXThrow(m_resource->Map(0, &r, reinterpret_cast<void**>(&m_mapped)));
+    }
+
+    /**
+     * @brief Starts filling the region of a frame.
+     * @param frameIndex The index of the frame in flight.
+     */
+    void BeginFrame(UINT frameIndex)
+    {
+        m_base = frameIndex * m_capacity;
+        m_cursor.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Reserves consecutive instances in the current frame.
+     * @param count The number of instances wanted.
+     * @param first Receives the index of the first instance, to pass to Write and Address.
+     * @return The number of instances reserved, less than count when the frame is full.
+     */
+    UINT Allocate(UINT count, UINT& first)
+    {
+        UINT cursor = m_cursor.load(std::memory_order_relaxed);
+        UINT taken;
+        do {
+            taken = count < m_capacity - cursor ? count : m_capacity - cursor;
+        } while (!m_cursor.compare_exchange_weak(cursor, cursor + taken, std::memory_order_relaxed));
+        first = cursor;
+        return taken;
+    }
+
+    /**
+     * @brief Writes an instance.
+     * @param index The index returned by Allocate, plus the offset in the range.
+     * @param data The instance.
+     */
+    void Write(UINT index, const InstanceData& data)
+    {
+        std::memcpy(m_mapped + size_t(m_base + index) * sizeof(InstanceData), &data, sizeof(data));
+    }
+
+    /**
+     * @brief Gets the GPU address of an instance, to bind as the start of a draw's instances.
+     * @param index The index returned by Allocate.
+     * @return The GPU virtual address.
+     */
+    D3D12_GPU_VIRTUAL_ADDRESS Address(UINT index) const
+    {
+        return m_resource->GetGPUVirtualAddress() + UINT64(m_base + index) * sizeof(InstanceData);
+    }
+
+    /**
+     * @brief Gets the number of instances written this frame.
+     * @return The instance count.
+     */
+    UINT Count() const { return m_cursor.load(std::memory_order_relaxed); }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_resource;
+    uint8_t* m_mapped = nullptr;
+    UINT m_capacity = 0;
+    UINT m_base = 0;
+    std::atomic<UINT> m_cursor{ 0 };
+};
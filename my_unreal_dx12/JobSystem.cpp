@@ -0,0 +1,80 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(uint32_t workerCount) {
+    if (workerCount == 0) {
+        const uint32_t hw = std::thread::hardware_concurrency();
+        workerCount = hw > 1 ? hw - 1 : 0;
+    }
+    m_workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i)
+        m_workers.emplace_back([this] { WorkerLoop(); });
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (auto& t : m_workers) t.join();
+}
+
+void JobSystem::RunChunks(const std::function<void(uint32_t, uint32_t)>& fn, uint32_t count, uint32_t chunkSize) {
+    for (;;) {
+        const uint32_t begin = m_next.fetch_add(chunkSize);
+        if (begin >= count) return;
+        fn(begin, std::min(begin + chunkSize, count));
+    }
+}
+
+void JobSystem::WorkerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        // The loop is copied under the lock; the members are rewritten by the next ParallelFor.
+        const std::function<void(uint32_t, uint32_t)>* fn;
+        uint32_t count, chunkSize;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+            if (m_quit) return;
+            seen = m_generation;
+            fn = m_fn;
+            count = m_count;
+            chunkSize = m_chunkSize;
+            ++m_busy;
+        }
+        RunChunks(*fn, count, chunkSize);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_busy;
+        }
+        m_done.notify_one();
+    }
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t)>& fn) {
+    if (count == 0) return;
+    chunkSize = std::max(chunkSize, 1u);
+    if (m_workers.empty() || count <= chunkSize) {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fn = &fn;
+        m_count = count;
+        m_chunkSize = chunkSize;
+        m_next.store(0);
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    RunChunks(fn, count, chunkSize);
+
+    // Workers that woke late find no chunk left and leave right away.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&] { return m_busy == 0; });
+    m_fn = nullptr;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class JobSystem
+ * @brief Small pool of worker threads running data-parallel loops.
+ * The calling thread takes part in the work, so a ParallelFor on a single-core machine
+ * simply runs inline.
+ */
+class JobSystem
+{
+public:
+    /**
+     * @brief Gets the shared job system, with one worker per hardware thread minus one.
+     * @return A reference to the singleton.
+     */
+    static JobSystem& I() { static JobSystem instance; return instance; }
+
+    /**
+     * @brief Creates a pool.
+     * @param workerCount The number of threads besides the caller; zero picks one per
+     * hardware thread minus one.
+     */
+    explicit JobSystem(uint32_t workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /**
+     * @brief Runs a function over [0, count) split into chunks, and waits for all of them.
+     * Not reentrant: the function must not call ParallelFor itself.
+     * @param count The number of items.
+     * @param chunkSize The number of items handed to a thread at a time.
+     * @param fn Called with the [begin, end) range of each chunk.
+     */
+    void ParallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t)>& fn);
+
+    /**
+     * @brief Gets the number of threads taking part in a ParallelFor, caller included.
+     * @return The thread count.
+     */
+    uint32_t ThreadCount() const { return uint32_t(m_workers.size()) + 1; }
+
+private:
+    void WorkerLoop();
+    void RunChunks(const std::function<void(uint32_t, uint32_t)>& fn, uint32_t count, uint32_t chunkSize);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    bool m_quit = false;
+    uint64_t m_generation = 0;
+    uint32_t m_busy = 0;
+
+    const std::function<void(uint32_t, uint32_t)>* m_fn = nullptr;
+    uint32_t m_count = 0;
+    uint32_t m_chunkSize = 1;
+    std::atomic<uint32_t> m_next{ 0 };
+};
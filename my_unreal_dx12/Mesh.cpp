@@ -1,5 +1,9 @@
 ﻿#include "Mesh.h"
 #include "WindowDX12.h"
+#include <atomic>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
 using namespace DirectX;
 
 static inline void NormalizeSafe(XMVECTOR& q) {
@@ -10,6 +14,8 @@ static inline void NormalizeSafe(XMVECTOR& q) {
         q = XMQuaternionNormalize(q);
     }
 }
+static std::atomic<uint64_t> s_nextMeshVersion{ 0 };
+
 static inline float DegToRad(float d) { return XMConvertToRadians(d); }
 
 static inline float WrapDeg(float a) {
@@ -18,11 +24,154 @@ static inline float WrapDeg(float a) {
     return a - 180.f;
 }
 
-void Mesh::UpdateMatrix() {
-    const XMMATRIX S = XMMatrixScalingFromVector(m_scale);
+void Mesh::InvalidateTransform() {
+    ++m_localVersion;
+    m_localDirty = true;
+    m_transformDirty = true;
+    m_boundsDirty = true;
+    Touch();
+}
+
+void Mesh::InvalidateRotation() {
+    m_rotationDirty = true;
+    InvalidateTransform();
+}
+
+void Mesh::ResolveLocal() const {
+    if (m_rotationDirty) {
+        const XMVECTOR qy = XMQuaternionRotationAxis(XMVectorSet(0.f, 1.f, 0.f, 0.f), DegToRad(m_yawDeg));
+        const XMVECTOR qx = XMQuaternionRotationAxis(XMVectorSet(1.f, 0.f, 0.f, 0.f), DegToRad(m_pitchDeg));
+        const XMVECTOR qz = XMQuaternionRotationAxis(XMVectorSet(0.f, 0.f, 1.f, 0.f), DegToRad(m_rollDeg));
+
+        XMVECTOR q = XMQuaternionMultiply(qy, XMQuaternionMultiply(qx, qz));
+        NormalizeSafe(q);
+        m_rotQ = q;
+        m_rotationDirty = false;
+    }
+
+    // S*R*T is R with its rows scaled and the position as last row, and its inverse is
+    // T^-1 * R^T * S^-1, so neither needs a matrix product or a general inverse.
     const XMMATRIX R = XMMatrixRotationQuaternion(m_rotQ);
-    const XMMATRIX T = XMMatrixTranslationFromVector(m_position);
-    m_transform = S * R * T;
+    m_local.r[0] = XMVectorMultiply(R.r[0], XMVectorSplatX(m_scale));
+    m_local.r[1] = XMVectorMultiply(R.r[1], XMVectorSplatY(m_scale));
+    m_local.r[2] = XMVectorMultiply(R.r[2], XMVectorSplatZ(m_scale));
+    m_local.r[3] = XMVectorSetW(m_position, 1.f);
+
+    const XMVECTOR invScale = XMVectorSetW(XMVectorReciprocal(m_scale), 0.f);
+    XMMATRIX inv = XMMatrixTranspose(R);
+    inv.r[0] = XMVectorMultiply(inv.r[0], invScale);
+    inv.r[1] = XMVectorMultiply(inv.r[1], invScale);
+    inv.r[2] = XMVectorMultiply(inv.r[2], invScale);
+    inv.r[3] = XMVectorSetW(XMVectorNegate(XMVector3TransformNormal(m_position, inv)), 1.f);
+    m_localInverse = inv;
+
+    m_localDirty = false;
+}
+
+void Mesh::ResolveTransform() const {
+    if (m_localDirty) ResolveLocal();
+    if (m_hasParent) {
+        m_transform = XMMatrixMultiply(m_local, m_parent);
+        m_inverseTransform = XMMatrixMultiply(m_parentInverse, m_localInverse);
+    }
+    else {
+        m_transform = m_local;
+        m_inverseTransform = m_localInverse;
+    }
+    m_transformDirty = false;
+}
+
+void Mesh::SetParentTransform(FXMMATRIX world, CXMMATRIX inverse) {
+    m_parent = world;
+    m_parentInverse = inverse;
+    m_hasParent = true;
+    m_transformDirty = true;
+    m_boundsDirty = true;
+    Touch();
+}
+
+void Mesh::ClearParentTransform() {
+    if (!m_hasParent) return;
+    m_hasParent = false;
+    m_transformDirty = true;
+    m_boundsDirty = true;
+    Touch();
+}
+
+void Mesh::ResolveTransforms(const Mesh* const* meshes, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (meshes[i]->m_transformDirty) meshes[i]->ResolveTransform();
+    }
+}
+
+void Mesh::Touch() {
+    m_version = ++s_nextMeshVersion;
+    m_sceneLink.MarkDirty();
+}
+
+void Mesh::UpdateWorldBounds() const {
+    if (m_asset) {
+        m_asset->bounds.Transform(m_worldBounds, Transform());
+        m_asset->sphere.Transform(m_worldSphere, Transform());
+    }
+    m_boundsDirty = false;
+}
+
+const BoundingBox& Mesh::WorldBounds() const {
+    if (m_boundsDirty) UpdateWorldBounds();
+    return m_worldBounds;
+}
+
+const BoundingSphere& Mesh::WorldSphere() const {
+    if (m_boundsDirty) UpdateWorldBounds();
+    return m_worldSphere;
+}
+
+BoundingBox Mesh::SubmeshWorldBounds(size_t index) const {
+    BoundingBox out{};
+    if (m_asset && index < m_asset->submeshes.size())
+        m_asset->submeshes[index].bounds.Transform(out, Transform());
+    return out;
+}
+
+bool Mesh::Raycast(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, MeshRayHit& hit) const {
+    if (!m_asset) return false;
+
+    float boxDistance;
+    if (!WorldBounds().Intersects(origin, dir, boxDistance) || boxDistance > maxDistance) return false;
+
+    // The local direction is not renormalized, so the hit parameter stays a world distance.
+    const XMMATRIX& inv = InverseTransform();
+    RayHit local;
+    if (!m_asset->GetBVH()->Raycast(XMVector3TransformCoord(origin, inv), XMVector3TransformNormal(dir, inv), maxDistance, local))
+        return false;
+
+    hit.distance = local.t;
+    hit.triangle = local.triangle;
+    XMStoreFloat3(&hit.position, XMVectorMultiplyAdd(dir, XMVectorReplicate(local.t), origin));
+    const XMVECTOR n = XMVector3TransformNormal(XMLoadFloat3(&local.normal), XMMatrixTranspose(inv));
+    XMStoreFloat3(&hit.normal, XMVector3Normalize(n));
+
+    hit.submesh = UINT32_MAX;
+    const uint32_t firstIndex = local.triangle * 3;
+    for (uint32_t i = 0; i < uint32_t(m_asset->submeshes.size()); ++i) {
+        const Submesh& sm = m_asset->submeshes[i];
+        if (firstIndex >= sm.indexStart && firstIndex < sm.indexStart + sm.indexCount) {
+            hit.submesh = i;
+            break;
+        }
+    }
+    return true;
+}
+
+bool Mesh::IsRayBlocked(FXMVECTOR origin, FXMVECTOR dir, float maxDistance) const {
+    if (!m_asset) return false;
+
+    float boxDistance;
+    if (!WorldBounds().Intersects(origin, dir, boxDistance) || boxDistance > maxDistance) return false;
+
+    const XMMATRIX& inv = InverseTransform();
+    return m_asset->GetBVH()->AnyHit(XMVector3TransformCoord(origin, inv), XMVector3TransformNormal(dir, inv), maxDistance);
 }
 
 Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
@@ -30,25 +179,43 @@ Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& ind
     m_asset->vertices = vertices;
     m_asset->indices = indices;
     m_asset->texture = ResourceCache::I().defaultWhite();
-	this->setShininess(m_asset->shininess);
+    m_asset->ComputeBounds();
     m_asset->Upload(WindowDX12::Get().GetDevice());
-    RecomputeRotationFromAbsoluteEuler();
+    Touch();
+}
+
+Mesh::Mesh(std::shared_ptr<MeshAsset> asset) : m_asset(std::move(asset)) {
+    if (m_asset && !m_asset->texture) m_asset->texture = ResourceCache::I().defaultWhite();
+    Touch();
 }
 
 Mesh::Mesh(const std::string& filename) {
     m_asset = ResourceCache::I().getMeshFromOBJ(filename);
     if (!m_asset->texture) m_asset->texture = ResourceCache::I().defaultWhite();
-    RecomputeRotationFromAbsoluteEuler();
+    Touch();
+}
+
+void Mesh::AddLod(std::shared_ptr<MeshAsset> asset, float geometricError) {
+    if (!asset) return;
+    size_t at = 0;
+    while (at < m_lods.size() && m_lodErrors[at + 1] <= geometricError) ++at;
+    m_lods.insert(m_lods.begin() + at, std::move(asset));
+    m_lodErrors.insert(m_lodErrors.begin() + at + 1, geometricError);
+    Touch();
+}
+
+void Mesh::ClearLods() {
+    m_lods.clear();
+    m_lodErrors.resize(1);
+    Touch();
 }
 
 void Mesh::SetColor(float r, float g, float b) {
-    for (auto& v : m_asset->vertices) { v.r = r; v.g = g; v.b = b; }
-    m_asset->Upload(nullptr);
+    m_tint = XMFLOAT3(r, g, b);
+    Touch();
 }
 std::tuple<float, float, float> Mesh::getColor() const {
-    if (m_asset->vertices.empty()) return { 1.f,1.f,1.f };
-    const auto& v = m_asset->vertices[0];
-    return { v.r, v.g, v.b };
+    return { m_tint.x, m_tint.y, m_tint.z };
 }
 
 // for revert triangle winding order (ABC -> ACB) useful for backface culling
@@ -58,10 +225,22 @@ inline static void MakeCW(std::vector<uint32_t>& idx)
         std::swap(idx[i + 1], idx[i + 2]);
 }
 
-Mesh Mesh::CreatePlane(float width, float depth, uint32_t m, uint32_t n)
+// Cache key for procedural meshes; %a keeps every float parameter bit-exact.
+static std::string ProceduralKey(const char* kind, std::initializer_list<double> params)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    std::string key = kind;
+    char buf[64];
+    for (double p : params) {
+        std::snprintf(buf, sizeof(buf), "|%a", p);
+        key += buf;
+    }
+    return key;
+}
+
+static void BuildPlane(MeshAsset& out, float width, float depth, uint32_t m, uint32_t n)
+{
+    std::vector<Vertex>& vertices = out.vertices;
+    std::vector<uint32_t>& indices = out.indices;
     vertices.resize(m * n);
     for (uint32_t i = 0; i < m; ++i) {
         float x = -0.5f * width + i * (width / (m - 1));
@@ -81,6 +260,7 @@ Mesh Mesh::CreatePlane(float width, float depth, uint32_t m, uint32_t n)
             v.v = static_cast<float>(j) / (n - 1);
         }
     }
+    indices.reserve(size_t(6) * (m - 1) * (n - 1));
     for (uint32_t i = 0; i < m - 1; ++i) {
         for (uint32_t j = 0; j < n - 1; ++j) {
             indices.push_back(i * n + j);
@@ -91,14 +271,13 @@ Mesh Mesh::CreatePlane(float width, float depth, uint32_t m, uint32_t n)
             indices.push_back((i + 1) * n + (j + 1));
         }
     }
-	return Mesh(vertices, indices);
 }
 
-Mesh Mesh::CreateCube(float size)
+static void BuildCube(MeshAsset& out, float size)
 {
     const float s = size * 0.5f;
 
-    std::vector<Vertex> vertices = {
+    out.vertices = {
         { -s, -s,  s,  0, 0, 1,  1, 1, 1,  0, 0 },
         {  s, -s,  s,  0, 0, 1,  1, 1, 1,  1, 0 },
         {  s,  s,  s,  0, 0, 1,  1, 1, 1,  1, 1 },
@@ -130,7 +309,8 @@ Mesh Mesh::CreateCube(float size)
         { -s,  s, -s, -1, 0, 0,  1, 1, 1,  0, 1 },
     };
 
-    std::vector<uint32_t> indices;
+    std::vector<uint32_t>& indices = out.indices;
+    indices.reserve(36);
     for (uint32_t f = 0; f < 6; ++f) {
         uint32_t i = f * 4;
         indices.push_back(i + 0);
@@ -140,16 +320,15 @@ Mesh Mesh::CreateCube(float size)
         indices.push_back(i + 2);
         indices.push_back(i + 3);
     }
-
-    return Mesh(vertices, indices);
 }
 
-Mesh Mesh::CreateSphere(float diameter, uint16_t slices, uint16_t stacks)
+static void BuildSphere(MeshAsset& out, float diameter, uint32_t slices, uint32_t stacks)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    std::vector<Vertex>& vertices = out.vertices;
+    std::vector<uint32_t>& indices = out.indices;
     float r = diameter * 0.5f;
 
+    vertices.reserve(size_t(stacks + 1) * (slices + 1));
     for (uint32_t i = 0; i <= stacks; ++i) {
         float phi = M_PI * i / stacks;
         for (uint32_t j = 0; j <= slices; ++j) {
@@ -161,6 +340,7 @@ Mesh Mesh::CreateSphere(float diameter, uint16_t slices, uint16_t stacks)
         }
     }
 
+    indices.reserve(size_t(6) * stacks * slices);
     for (uint32_t i = 0; i < stacks; ++i) {
         for (uint32_t j = 0; j < slices; ++j) {
             uint32_t a = i * (slices + 1) + j;
@@ -174,18 +354,19 @@ Mesh Mesh::CreateSphere(float diameter, uint16_t slices, uint16_t stacks)
         }
     }
     MakeCW(indices);
-
-    return Mesh(vertices, indices);
 }
 
-Mesh Mesh::CreateCylinder(float radius, float height, uint32_t slices, bool withCaps)
+static void BuildCylinder(MeshAsset& out, float radius, float height, uint32_t slices, bool withCaps)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    std::vector<Vertex>& vertices = out.vertices;
+    std::vector<uint32_t>& indices = out.indices;
 
     const float h = height * 0.5f;
     const float invS = 1.0f / slices;
 
+    vertices.reserve(size_t(2) * (slices + 1) + (withCaps ? size_t(2) * (slices + 2) : 0));
+    indices.reserve(size_t(6) * slices + (withCaps ? size_t(6) * slices : 0));
+
     for (uint32_t i = 0; i <= slices; ++i) {
         float t = i * invS;
         float th = 2.0f * float(M_PI) * t;
@@ -240,14 +421,12 @@ Mesh Mesh::CreateCylinder(float radius, float height, uint32_t slices, bool with
             indices.push_back(topStart + i);
         }
     }
-
-    return Mesh(vertices, indices);
 }
 
-Mesh Mesh::CreateCone(float radius, float height, uint32_t slices, bool withBase)
+static void BuildCone(MeshAsset& out, float radius, float height, uint32_t slices, bool withBase)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    std::vector<Vertex>& vertices = out.vertices;
+    std::vector<uint32_t>& indices = out.indices;
 
     const float h = height * 0.5f;
     const float invSlices = 1.0f / slices;
@@ -256,6 +435,9 @@ Mesh Mesh::CreateCone(float radius, float height, uint32_t slices, bool withBase
     const float ny_side = radius / denom;
     const float k_rad = height / denom;
 
+    vertices.reserve(size_t(2) * (slices + 1) + (withBase ? size_t(slices) + 2 : 0));
+    indices.reserve(size_t(3) * slices + (withBase ? size_t(3) * slices : 0));
+
     for (uint32_t i = 0; i <= slices; ++i) {
         float t = i * invSlices;
         float theta = 2.0f * float(M_PI) * t;
@@ -320,11 +502,86 @@ Mesh Mesh::CreateCone(float radius, float height, uint32_t slices, bool withBase
     }
 
 	MakeCW(indices);
-    return Mesh(vertices, indices);
 }
+
+// Coarser tessellations of the round shapes are chained as levels of detail, halving the
+// slice count down to this.
+static constexpr uint32_t kMinLodSlices = 8;
+static constexpr uint32_t kMinLodStacks = 4;
+
+// Largest distance between a circle of this radius and a polygon of `segments` sides on it.
+static inline float ChordError(float radius, uint32_t segments) {
+    return radius * (1.f - std::cos(float(M_PI) / float(segments)));
+}
+
+Mesh Mesh::CreatePlane(float width, float depth, uint32_t m, uint32_t n)
+{
+    return Mesh(ResourceCache::I().getProceduralMesh(
+        ProceduralKey("plane", { width, depth, double(m), double(n) }),
+        [&](MeshAsset& a) { BuildPlane(a, width, depth, m, n); }));
+}
+
+Mesh Mesh::CreateCube(float size)
+{
+    return Mesh(ResourceCache::I().getProceduralMesh(
+        ProceduralKey("cube", { size }),
+        [&](MeshAsset& a) { BuildCube(a, size); }));
+}
+
+Mesh Mesh::CreateSphere(float diameter, uint16_t slices, uint16_t stacks)
+{
+    auto build = [diameter](uint32_t s, uint32_t t) {
+        return ResourceCache::I().getProceduralMesh(
+            ProceduralKey("sphere", { diameter, double(s), double(t) }),
+            [&](MeshAsset& a) { BuildSphere(a, diameter, s, t); });
+    };
+    // Stacks only span half a turn.
+    const float radius = 0.5f * diameter;
+    auto error = [radius](uint32_t s, uint32_t t) { return std::max(ChordError(radius, s), ChordError(radius, 2 * t)); };
+
+    Mesh mesh(build(slices, stacks));
+    mesh.SetBaseLodError(error(slices, stacks));
+    uint32_t t = stacks;
+    for (uint32_t s = slices / 2; s >= kMinLodSlices; s /= 2) {
+        t = std::max(t / 2, kMinLodStacks);
+        mesh.AddLod(build(s, t), error(s, t));
+    }
+    return mesh;
+}
+
+Mesh Mesh::CreateCylinder(float radius, float height, uint32_t slices, bool withCaps)
+{
+    auto build = [=](uint32_t s) {
+        return ResourceCache::I().getProceduralMesh(
+            ProceduralKey("cylinder", { radius, height, double(s), withCaps ? 1.0 : 0.0 }),
+            [&](MeshAsset& a) { BuildCylinder(a, radius, height, s, withCaps); });
+    };
+
+    Mesh mesh(build(slices));
+    mesh.SetBaseLodError(ChordError(radius, slices));
+    for (uint32_t s = slices / 2; s >= kMinLodSlices; s /= 2)
+        mesh.AddLod(build(s), ChordError(radius, s));
+    return mesh;
+}
+
+Mesh Mesh::CreateCone(float radius, float height, uint32_t slices, bool withBase)
+{
+    auto build = [=](uint32_t s) {
+        return ResourceCache::I().getProceduralMesh(
+            ProceduralKey("cone", { radius, height, double(s), withBase ? 1.0 : 0.0 }),
+            [&](MeshAsset& a) { BuildCone(a, radius, height, s, withBase); });
+    };
+
+    Mesh mesh(build(slices));
+    mesh.SetBaseLodError(ChordError(radius, slices));
+    for (uint32_t s = slices / 2; s >= kMinLodSlices; s /= 2)
+        mesh.AddLod(build(s), ChordError(radius, s));
+    return mesh;
+}
+
 void Mesh::SetPosition(float x, float y, float z) {
     m_position = XMVectorSet(x, y, z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::SetPositionX(float x)
@@ -332,7 +589,7 @@ void Mesh::SetPositionX(float x)
     XMFLOAT3 p; XMStoreFloat3(&p, m_position);
     p.x = x;
     m_position = XMVectorSet(p.x, p.y, p.z, 0.0f);
-	UpdateMatrix();
+	InvalidateTransform();
 }
 
 void Mesh::SetPositionY(float y)
@@ -340,20 +597,20 @@ void Mesh::SetPositionY(float y)
     XMFLOAT3 p; XMStoreFloat3(&p, m_position);
     p.y = y;
     m_position = XMVectorSet(p.x, p.y, p.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 void Mesh::SetPositionZ(float z)
 {
     XMFLOAT3 p; XMStoreFloat3(&p, m_position);
     p.z = z;
     m_position = XMVectorSet(p.x, p.y, p.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 
 void Mesh::AddPosition(float dx, float dy, float dz) {
     m_position = XMVectorAdd(m_position, XMVectorSet(dx, dy, dz, 0.0f));
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::AddPositionX(float dx)
@@ -361,87 +618,73 @@ void Mesh::AddPositionX(float dx)
     XMFLOAT3 p; XMStoreFloat3(&p, m_position);
     p.x += dx;
     m_position = XMVectorSet(p.x, p.y, p.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 void Mesh::AddPositionY(float dy)
 {
     XMFLOAT3 p; XMStoreFloat3(&p, m_position);
     p.y += dy;
     m_position = XMVectorSet(p.x, p.y, p.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 void Mesh::AddPositionZ(float dz)
 {
     XMFLOAT3 p; XMStoreFloat3(&p, m_position);
     p.z += dz;
     m_position = XMVectorSet(p.x, p.y, p.z, 0.0f);
-    UpdateMatrix();
-}
-
-void Mesh::RecomputeRotationFromAbsoluteEuler()
-{
-    m_yawDeg = WrapDeg(m_yawDeg);
-    m_pitchDeg = WrapDeg(m_pitchDeg);
-    m_rollDeg = WrapDeg(m_rollDeg);
-
-    const XMVECTOR qy = XMQuaternionRotationAxis(XMVectorSet(0.f, 1.f, 0.f, 0.f), DegToRad(m_yawDeg));
-    const XMVECTOR qx = XMQuaternionRotationAxis(XMVectorSet(1.f, 0.f, 0.f, 0.f), DegToRad(m_pitchDeg));
-    const XMVECTOR qz = XMQuaternionRotationAxis(XMVectorSet(0.f, 0.f, 1.f, 0.f), DegToRad(m_rollDeg));
-
-    XMVECTOR q = XMQuaternionMultiply(qy, XMQuaternionMultiply(qx, qz));
-    NormalizeSafe(q);
-    m_rotQ = q;
-
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::SetRotationYawPitchRoll(float yawDeg, float pitchDeg, float rollDeg) {
-    m_yawDeg = yawDeg;
-    m_pitchDeg = pitchDeg;
-    m_rollDeg = rollDeg;
-    RecomputeRotationFromAbsoluteEuler();
+    m_yawDeg = WrapDeg(yawDeg);
+    m_pitchDeg = WrapDeg(pitchDeg);
+    m_rollDeg = WrapDeg(rollDeg);
+    InvalidateRotation();
 }
 
 void Mesh::SetRotationYaw(float yawDeg) {
-    m_yawDeg = yawDeg;
-    RecomputeRotationFromAbsoluteEuler();
+    m_yawDeg = WrapDeg(yawDeg);
+    InvalidateRotation();
 }
 
 void Mesh::SetRotationPitch(float pitchDeg) {
-    m_pitchDeg = pitchDeg;
-    RecomputeRotationFromAbsoluteEuler();
+    m_pitchDeg = WrapDeg(pitchDeg);
+    InvalidateRotation();
 }
 
 void Mesh::SetRotationRoll(float rollDeg) {
-    m_rollDeg = rollDeg;
-    RecomputeRotationFromAbsoluteEuler();
+    m_rollDeg = WrapDeg(rollDeg);
+    InvalidateRotation();
 }
 
 void Mesh::AddRotationYaw(float dyawDeg) {
     m_yawDeg = WrapDeg(m_yawDeg + dyawDeg);
-    RecomputeRotationFromAbsoluteEuler();
+    InvalidateRotation();
 }
 
 void Mesh::AddRotationPitch(float dpitchDeg) {
     m_pitchDeg = WrapDeg(m_pitchDeg + dpitchDeg);
-    RecomputeRotationFromAbsoluteEuler();
+    InvalidateRotation();
 }
 
 void Mesh::AddRotationRoll(float drollDeg) {
     m_rollDeg = WrapDeg(m_rollDeg + drollDeg);
-    RecomputeRotationFromAbsoluteEuler();
+    InvalidateRotation();
 }
 
 void Mesh::AddRotationYawPitchRoll(float dyawDeg, float dpitchDeg, float drollDeg) {
     m_yawDeg = WrapDeg(m_yawDeg + dyawDeg);
     m_pitchDeg = WrapDeg(m_pitchDeg + dpitchDeg);
     m_rollDeg = WrapDeg(m_rollDeg + drollDeg);
-    RecomputeRotationFromAbsoluteEuler();
+    InvalidateRotation();
 }
 
 void Mesh::SetScale(float sx, float sy, float sz) {
+    if (sx == 0) sx = 1e-6f;
+    if (sy == 0) sy = 1e-6f;
+    if (sz == 0) sz = 1e-6f;
     m_scale = XMVectorSet(sx, sy, sz, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 void Mesh::SetScaleX(float sx)
 {
@@ -449,7 +692,7 @@ void Mesh::SetScaleX(float sx)
     s.x = sx;
     if (s.x == 0) s.x = 1e-6f;
     m_scale = XMVectorSet(s.x, s.y, s.z, 0.0f);
-	UpdateMatrix();
+	InvalidateTransform();
 }
 
 void Mesh::SetScaleY(float sy)
@@ -458,7 +701,7 @@ void Mesh::SetScaleY(float sy)
     s.y = sy;
     if (s.y == 0) s.y = 1e-6f;
     m_scale = XMVectorSet(s.x, s.y, s.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::SetScaleZ(float sz)
@@ -467,7 +710,7 @@ void Mesh::SetScaleZ(float sz)
     s.z = sz;
     if (s.z == 0) s.z = 1e-6f;
     m_scale = XMVectorSet(s.x, s.y, s.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::AddScaleX(float dsx)
@@ -476,7 +719,7 @@ void Mesh::AddScaleX(float dsx)
     s.x += dsx;
     if (s.x == 0) s.x = 1e-6f;
     m_scale = XMVectorSet(s.x, s.y, s.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::AddScaleY(float dsy)
@@ -485,7 +728,7 @@ void Mesh::AddScaleY(float dsy)
     s.y += dsy;
     if (s.y == 0) s.y = 1e-6f;
     m_scale = XMVectorSet(s.x, s.y, s.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::AddScaleZ(float dsz)
@@ -494,7 +737,7 @@ void Mesh::AddScaleZ(float dsz)
     s.z += dsz;
     if (s.z == 0) s.z = 1e-6f;
     m_scale = XMVectorSet(s.x, s.y, s.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::AddScale(float dsx, float dsy, float dsz) {
@@ -504,11 +747,11 @@ void Mesh::AddScale(float dsx, float dsy, float dsz) {
     if (s.y == 0) s.y = 1e-6f;
     if (s.z == 0) s.z = 1e-6f;
     m_scale = XMVectorSet(s.x, s.y, s.z, 0.0f);
-    UpdateMatrix();
+    InvalidateTransform();
 }
 
 void Mesh::BindTexture(ID3D12GraphicsCommandList* cmdList, UINT rootParamIndex) const {
-    auto tx = m_asset->texture ? m_asset->texture : ResourceCache::I().defaultWhite();
+    auto tx = GetTextureShared();
     if (!tx) return;
     cmdList->SetGraphicsRootDescriptorTable(rootParamIndex, tx->GPUHandle());
 }
@@ -1,13 +1,34 @@
 #pragma once
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include <DirectXMath.h>
 #include "MeshAsset.h"
 #include "ResourceCache.h"
 #include "Utils.h"
+#include "RenderScene.h"
+#include "TransformHierarchy.h"
 #include <cmath>
 
 constexpr auto M_PI = 3.14159265358979323846f;
 
+/**
+ * @struct MeshRayHit
+ * @brief Describes where a world-space ray hit a mesh.
+ */
+struct MeshRayHit
+{
+    float distance = 0.f;
+    DirectX::XMFLOAT3 position{ 0.f, 0.f, 0.f };
+    DirectX::XMFLOAT3 normal{ 0.f, 0.f, 0.f };
+
+    /** Index of the triangle in the asset index buffer. */
+    uint32_t triangle = 0;
+
+    /** Index of the submesh containing the triangle, or UINT32_MAX if the asset has none. */
+    uint32_t submesh = 0;
+};
+
 /**
  * @class Mesh
  * @brief Represents a 3D mesh with its own transformation.
@@ -28,6 +49,12 @@ public:
      */
     Mesh(const std::string& filename);
 
+    /**
+     * @brief Constructs a new Mesh object that shares an already uploaded asset.
+     * @param asset The mesh asset to reference.
+     */
+    explicit Mesh(std::shared_ptr<MeshAsset> asset);
+
     Mesh(const Mesh&) = default;
     Mesh& operator=(const Mesh&) = default;
     Mesh(Mesh&&) noexcept = default;
@@ -52,6 +79,7 @@ public:
 
 	/**
 	 * @brief Creates a sphere mesh.
+	 * Coarser tessellations, halving the slices down to 8, are added as levels of detail.
 	 * @param diameter The diameter of the sphere.
 	 * @param sliceCount The number of slices.
 	 * @param stackCount The number of stacks.
@@ -61,6 +89,7 @@ public:
 
     /**
      * @brief Creates a cylinder mesh.
+     * Coarser tessellations, halving the slices down to 8, are added as levels of detail.
      * @param radius The radius of the cylinder.
      * @param height The height of the cylinder.
      * @param slices The number of slices.
@@ -71,6 +100,7 @@ public:
 
 	/**
 	 * @brief Creates a cone mesh.
+	 * Coarser tessellations, halving the slices down to 8, are added as levels of detail.
 	 * @param radius The radius of the cone.
 	 * @param height The height of the cone.
 	 * @param slices The number of slices.
@@ -243,23 +273,123 @@ public:
 
     /**
      * @brief Gets the transformation matrix of the mesh.
+     * Setters only flag the transform; it is rebuilt here on first use, or by
+     * ResolveTransforms for all the meshes changed during the frame.
+     * For a mesh attached to a TransformHierarchy, this is the world transform.
      * @return The transformation matrix.
      */
-    const DirectX::XMMATRIX& Transform() const { return m_transform; }
+    const DirectX::XMMATRIX& Transform() const { if (m_transformDirty) ResolveTransform(); return m_transform; }
+
+    /**
+     * @brief Gets the inverse of the transformation matrix, used for normals and ray queries.
+     * It is built from the scale, rotation and position instead of a general inverse,
+     * and cached with the transform.
+     * @return The inverse transformation matrix.
+     */
+    const DirectX::XMMATRIX& InverseTransform() const { if (m_transformDirty) ResolveTransform(); return m_inverseTransform; }
+
+    /**
+     * @brief Rebuilds the pending transforms of several meshes, one mesh after the other.
+     * Meshes are separate objects, so this is a plain loop rather than a SIMD pass over
+     * packed arrays; it gathers the rebuilds in one place before the proxies read them.
+     * @param meshes The meshes; those with an up-to-date transform are skipped.
+     * @param count The number of meshes.
+     */
+    static void ResolveTransforms(const Mesh* const* meshes, size_t count);
+
+    /**
+     * @brief Gets the transform set by the position, rotation and scale, relative to the parent.
+     * @return The local transformation matrix.
+     */
+    const DirectX::XMMATRIX& LocalTransform() const { if (m_localDirty) ResolveLocal(); return m_local; }
+
+    /**
+     * @brief Gets the inverse of the local transform.
+     * @return The inverse local transformation matrix.
+     */
+    const DirectX::XMMATRIX& LocalInverseTransform() const { if (m_localDirty) ResolveLocal(); return m_localInverse; }
+
+    /**
+     * @brief Gets a counter that changes every time the position, rotation or scale changes.
+     * @return The local transform version.
+     */
+    uint64_t LocalVersion() const { return m_localVersion; }
+
+    /**
+     * @brief Places the mesh in the space of a parent. Called by TransformHierarchy.
+     * @param world The world transform of the parent.
+     * @param inverse The inverse of the parent world transform.
+     */
+    void SetParentTransform(DirectX::FXMMATRIX world, DirectX::CXMMATRIX inverse);
+
+    /**
+     * @brief Makes the local transform the world transform again.
+     */
+    void ClearParentTransform();
+
+    /**
+     * @brief Checks whether the mesh is placed in the space of a parent.
+     * @return True if a parent transform is set.
+     */
+    bool HasParent() const { return m_hasParent; }
+
+    /**
+     * @brief Gets the world-space axis-aligned bounding box of the mesh.
+     * The result is cached and only recomputed after the transform changes.
+     * @return The world-space AABB.
+     */
+    const DirectX::BoundingBox& WorldBounds() const;
+
+    /**
+     * @brief Gets the world-space bounding sphere of the mesh.
+     * The result is cached and only recomputed after the transform changes.
+     * @return The world-space bounding sphere.
+     */
+    const DirectX::BoundingSphere& WorldSphere() const;
+
+    /**
+     * @brief Gets the world-space axis-aligned bounding box of one submesh.
+     * @param index The submesh index.
+     * @return The world-space AABB of the submesh.
+     */
+    DirectX::BoundingBox SubmeshWorldBounds(size_t index) const;
+
+    /**
+     * @brief Finds the closest point where a world-space ray hits the mesh.
+     * Uses the BVH of the asset, which is built on the first query if needed.
+     * @param origin The ray origin.
+     * @param dir The normalized ray direction.
+     * @param maxDistance Hits farther than this are ignored.
+     * @param hit Receives the closest hit.
+     * @return True if the mesh was hit.
+     */
+    bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance, MeshRayHit& hit) const;
+
+    /**
+     * @brief Checks whether the mesh blocks a world-space ray, for line-of-sight tests.
+     * Stops at the first triangle found, so it is cheaper than Raycast.
+     * @param origin The ray origin.
+     * @param dir The normalized ray direction.
+     * @param maxDistance Only hits closer than this block the ray.
+     * @return True if any triangle is hit.
+     */
+    bool IsRayBlocked(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance) const;
 
     /**
      * @brief Sets the texture of the mesh.
-     * @param t A shared pointer to the new texture.
+     * The texture belongs to this mesh and replaces the texture of the asset, which may be
+     * shared with other meshes and is left untouched. Submeshes with a texture of their
+     * own keep it.
+     * @param t A shared pointer to the new texture, or nullptr to use the asset's texture.
      */
-    void SetTexture(std::shared_ptr<Texture> t) { if (m_asset) m_asset->texture = std::move(t); }
+    void SetTexture(std::shared_ptr<Texture> t) { m_texture = std::move(t); Touch(); }
 
     /**
      * @brief Gets the texture of the mesh.
      * @return A pointer to the texture, or the default white texture if none is set.
      */
     Texture* GetTexture() const {
-        if (!m_asset) return nullptr;
-        auto t = m_asset->texture ? m_asset->texture : ResourceCache::I().defaultWhite();
+        auto t = GetTextureShared();
         return t ? t.get() : nullptr;
     }
 
@@ -268,12 +398,21 @@ public:
      * @return A shared pointer to the texture, or the default white texture if none is set.
      */
     std::shared_ptr<Texture> GetTextureShared() const {
+        if (m_texture) return m_texture;
         if (!m_asset) return {};
         return m_asset->texture ? m_asset->texture : ResourceCache::I().defaultWhite();
     }
 
+    /**
+     * @brief Checks whether the mesh replaces the texture of its asset.
+     * @return True if a texture was set with SetTexture.
+     */
+    bool HasOwnTexture() const { return m_texture != nullptr; }
+
     /**
      * @brief Sets the color of the mesh.
+     * The color is a per-instance tint multiplied with the vertex colors in the shader;
+     * the shared asset is left untouched.
      * @param r The red component.
      * @param g The green component.
      * @param b The blue component.
@@ -286,6 +425,12 @@ public:
      */
     std::tuple<float, float, float> getColor() const;
 
+    /**
+     * @brief Gets the per-instance tint of the mesh.
+     * @return The tint color.
+     */
+    const DirectX::XMFLOAT3& Tint() const { return m_tint; }
+
     /**
      * @brief Binds the texture of the mesh to the pipeline.
      * @param cmdList The command list.
@@ -313,6 +458,8 @@ public:
 
 	/**
 	 * @brief Sets the shininess of the mesh.
+	 * Like the tint, it is per-instance state: it replaces the shininess of every material
+	 * of the asset for this mesh only.
 	 * @param s The new shininess value.
 	 */
 	void setShininess(float s) {
@@ -322,25 +469,214 @@ public:
 		else if (s > 256.f) {
             std::cout << "[Warning]: shininess too high, Object may appear too shiny." << std::endl;
 		}
-        for (auto & sm : m_asset->submeshes) {
-            sm.shininess = s;
-		}
+        m_shininess = s;
+        Touch();
     }
 
+    /**
+     * @brief Gets the shininess set with setShininess.
+     * @return The shininess, or a negative value if the materials use their own.
+     */
+    float ShininessOverride() const { return m_shininess; }
+
+    /**
+     * @brief Marks the mesh as static geometry.
+     * Static meshes are pre-transformed and merged with other static meshes sharing
+     * the same material, so they should only rarely be moved or edited. Meshes with
+     * several levels of detail are not merged, as their level changes with distance.
+     * @param isStatic True to mark the mesh as static.
+     */
+    void SetStatic(bool isStatic) { m_static = isStatic; m_sceneLink.MarkDirty(); }
+
+    /**
+     * @brief Checks whether the mesh is marked as static geometry.
+     * @return True if the mesh is static.
+     */
+    bool IsStatic() const { return m_static; }
+
+    /**
+     * @brief Checks whether the mesh is merged into the static batches.
+     * @return True if the mesh is static and has a single level of detail.
+     */
+    bool IsBatched() const { return m_static && m_lods.empty(); }
+
+    /**
+     * @brief Adds a coarser level of detail.
+     * Levels are kept sorted by error; the renderer draws the coarsest one whose error,
+     * projected on screen, stays under its threshold.
+     * @param asset The geometry of the level, in the same local space as the mesh.
+     * @param geometricError The largest distance between this level and the full-detail
+     * surface, in local units.
+     */
+    void AddLod(std::shared_ptr<MeshAsset> asset, float geometricError);
+
+    /**
+     * @brief Removes the coarser levels of detail.
+     */
+    void ClearLods();
+
+    /**
+     * @brief Sets the geometric error of the full-detail level, e.g. the tessellation error
+     * of a procedural shape.
+     * @param geometricError The error in local units.
+     */
+    void SetBaseLodError(float geometricError) { m_lodErrors[0] = geometricError; }
+
+    /**
+     * @brief Gets the number of levels of detail, the full-detail one included.
+     * @return The level count.
+     */
+    uint32_t LodCount() const { return uint32_t(m_lodErrors.size()); }
+
+    /**
+     * @brief Gets the geometric error of every level, from the finest to the coarsest.
+     * @return LodCount() errors, in local units.
+     */
+    const float* LodErrors() const { return m_lodErrors.data(); }
+
+    /**
+     * @brief Gets the geometry of a level of detail.
+     * @param level The level, 0 being the full detail; clamped to the coarsest level.
+     * @return The asset of the level.
+     */
+    const MeshAsset* LodAsset(uint32_t level) const {
+        if (level == 0 || m_lods.empty()) return m_asset.get();
+        return m_lods[std::min<size_t>(level, m_lods.size()) - 1].get();
+    }
+
+    /**
+     * @brief Checks whether the mesh is registered in a retained scene.
+     * Registered meshes are drawn every frame without calling WindowDX12::Draw.
+     * @return True if the mesh is in a scene.
+     */
+    bool IsInScene() const { return m_sceneLink.IsLinked(); }
+
+    /**
+     * @brief Marks the mesh as an occluder.
+     * Occluders are rasterized into the CPU depth buffer used to cull the meshes behind
+     * them, so large, simple and opaque meshes such as walls and terrain work best.
+     * @param isOccluder True to mark the mesh as an occluder.
+     */
+    void SetOccluder(bool isOccluder) { m_occluder = isOccluder; }
+
+    /**
+     * @brief Checks whether the mesh is an occluder.
+     * @return True if the mesh is an occluder.
+     */
+    bool IsOccluder() const { return m_occluder; }
+
+    /**
+     * @brief Sets a simplified mesh rasterized in place of this one when it occludes.
+     * The simplified mesh must stay inside the real one, or objects may be culled wrongly.
+     * @param asset The simplified geometry, in the same local space; null to use the mesh itself.
+     */
+    void SetOccluderAsset(std::shared_ptr<const MeshAsset> asset) { m_occluderAsset = std::move(asset); }
+
+    /**
+     * @brief Gets the geometry rasterized when the mesh occludes.
+     * @return The simplified occluder asset if set, otherwise the mesh asset.
+     */
+    const MeshAsset* OccluderAsset() const { return m_occluderAsset ? m_occluderAsset.get() : m_asset.get(); }
+
+    /**
+     * @brief Overrides the size under which the mesh is not drawn.
+     * @param pixels The minimum projected diameter in pixels, or a negative value to use
+     * the renderer default.
+     */
+    void SetMinScreenSize(float pixels) { m_minScreenSize = pixels; }
+
+    /**
+     * @brief Gets the size under which the mesh is not drawn.
+     * @return The minimum projected diameter in pixels, negative for the renderer default.
+     */
+    float MinScreenSize() const { return m_minScreenSize; }
+
+    /**
+     * @brief Overrides the size in the shadow map under which the mesh casts no shadow.
+     * @param texels The minimum projected diameter in shadow map texels, or a negative
+     * value to use the renderer default.
+     */
+    void SetMinShadowScreenSize(float texels) { m_minShadowScreenSize = texels; }
+
+    /**
+     * @brief Gets the size in the shadow map under which the mesh casts no shadow.
+     * @return The minimum projected diameter in texels, negative for the renderer default.
+     */
+    float MinShadowScreenSize() const { return m_minShadowScreenSize; }
+
+    /**
+     * @brief Overrides the distance beyond which the mesh is drawn as an impostor.
+     * @param distance The distance from the camera in world units, zero to never use an
+     * impostor, or a negative value to use the renderer default.
+     */
+    void SetImpostorDistance(float distance) { m_impostorDistance = distance; }
+
+    /**
+     * @brief Gets the distance beyond which the mesh is drawn as an impostor.
+     * @return The distance in world units, zero for never, negative for the renderer default.
+     */
+    float ImpostorDistance() const { return m_impostorDistance; }
+
+    /**
+     * @brief Gets the version of the mesh content.
+     * The value changes every time the transform, color, texture or material changes,
+     * and is unique across all meshes.
+     * @return The content version.
+     */
+    uint64_t Version() const { return m_version; }
+
 
 private:
-    void UpdateMatrix();
+    friend class RenderScene;
+    friend class TransformHierarchy;
+
+    void InvalidateTransform();
+    void ResolveLocal() const;
+    void ResolveTransform() const;
+    void Touch();
     std::shared_ptr<MeshAsset> m_asset;
 
     DirectX::XMVECTOR m_position{ DirectX::XMVectorZero() };
     DirectX::XMVECTOR m_scale{ DirectX::XMVectorSet(1,1,1,0) };
-    DirectX::XMVECTOR m_rotQ{ DirectX::XMQuaternionIdentity() };
-
-    DirectX::XMMATRIX m_transform{ DirectX::XMMatrixIdentity() };
+    mutable DirectX::XMVECTOR m_rotQ{ DirectX::XMQuaternionIdentity() };
+
+    mutable DirectX::XMMATRIX m_local{ DirectX::XMMatrixIdentity() };
+    mutable DirectX::XMMATRIX m_localInverse{ DirectX::XMMatrixIdentity() };
+    mutable DirectX::XMMATRIX m_transform{ DirectX::XMMatrixIdentity() };
+    mutable DirectX::XMMATRIX m_inverseTransform{ DirectX::XMMatrixIdentity() };
+    DirectX::XMMATRIX m_parent{ DirectX::XMMatrixIdentity() };
+    DirectX::XMMATRIX m_parentInverse{ DirectX::XMMatrixIdentity() };
+    uint64_t m_localVersion = 0;
+    mutable bool m_localDirty = false;
+    mutable bool m_transformDirty = false;
+    mutable bool m_rotationDirty = false;
+    bool m_hasParent = false;
+
+    void UpdateWorldBounds() const;
+    mutable DirectX::BoundingBox m_worldBounds{};
+    mutable DirectX::BoundingSphere m_worldSphere{};
+    mutable bool m_boundsDirty = true;
+
+    DirectX::XMFLOAT3 m_tint{ 1.f, 1.f, 1.f };
+    std::shared_ptr<Texture> m_texture;
+    float m_shininess = -1.f;
+
+    uint64_t m_version = 0;
+    bool m_static = false;
+    bool m_occluder = false;
+    std::shared_ptr<const MeshAsset> m_occluderAsset;
+    std::vector<std::shared_ptr<MeshAsset>> m_lods;
+    std::vector<float> m_lodErrors = std::vector<float>(1, 0.f);
+    float m_minScreenSize = -1.f;
+    float m_minShadowScreenSize = -1.f;
+    float m_impostorDistance = -1.f;
 
     float m_yawDeg = 0.f;
     float m_pitchDeg = 0.f;
     float m_rollDeg = 0.f;
 
-    void RecomputeRotationFromAbsoluteEuler();
+    void InvalidateRotation();
+
+    SceneLink m_sceneLink;
+    HierarchyLink m_hierarchyLink;
 };
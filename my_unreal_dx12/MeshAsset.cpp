@@ -1,15 +1,76 @@
 #include "MeshAsset.h"
 #include "WindowDX12.h"
 #include "Utils.h"
+#include <atomic>
+
+using namespace DirectX;
+
+namespace {
+    std::atomic<size_t> s_cpuBytesReleased{ 0 };
+
+    template<typename T>
+    size_t VectorBytes(const std::vector<T>& v) { return v.capacity() * sizeof(T); }
+
+    template<typename T>
+    void ReadBuffer(ID3D12Resource* res, UINT bytes, std::vector<T>& out) {
+        out.resize(bytes / sizeof(T));
+        if (!res || !bytes) return;
+        void* p = nullptr; D3D12_RANGE r{ 0, bytes };
+        DXThrow(res->Map(0, &r, &p));
+        memcpy(out.data(), p, bytes);
+        D3D12_RANGE w{ 0, 0 }; res->Unmap(0, &w);
+    }
+
+    inline XMVECTOR LoadPosition(const Vertex& v) {
+        return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&v.px));
+    }
+
+    // Box via SIMD min/max, then a sphere centred on the box that encloses every point
+    // (tighter than the box circumsphere). fetch(i) returns the i-th position as XMVECTOR.
+    template<typename Fetch>
+    void ComputeRangeBounds(size_t count, Fetch&& fetch, BoundingBox& box, BoundingSphere& sphere)
+    {
+        if (count == 0) {
+            box = BoundingBox(XMFLOAT3(0.f, 0.f, 0.f), XMFLOAT3(0.f, 0.f, 0.f));
+            sphere = BoundingSphere(XMFLOAT3(0.f, 0.f, 0.f), 0.f);
+            return;
+        }
+
+        XMVECTOR vMin = fetch(0);
+        XMVECTOR vMax = vMin;
+        for (size_t i = 1; i < count; ++i) {
+            const XMVECTOR p = fetch(i);
+            vMin = XMVectorMin(vMin, p);
+            vMax = XMVectorMax(vMax, p);
+        }
+        BoundingBox::CreateFromPoints(box, vMin, vMax);
+
+        const XMVECTOR c = XMLoadFloat3(&box.Center);
+        XMVECTOR r2 = XMVectorZero();
+        for (size_t i = 0; i < count; ++i)
+            r2 = XMVectorMax(r2, XMVector3LengthSq(XMVectorSubtract(fetch(i), c)));
+
+        sphere.Center = box.Center;
+        sphere.Radius = XMVectorGetX(XMVectorSqrt(r2));
+    }
+}
+
+MeshAsset::~MeshAsset() {
+    s_cpuBytesReleased -= m_bytesReleased;
+}
 
 void MeshAsset::Upload(ID3D12Device* device) {
+    // The GPU buffers already hold the released geometry; there is nothing newer to upload.
+    if (IsCpuGeometryReleased()) return;
     if (!device) device = WindowDX12::Get().GetDevice();
 
     const UINT vbBytes = UINT(vertices.size() * sizeof(Vertex));
     const UINT ibBytes = UINT(indices.size() * sizeof(uint32_t));
 
+    // The previous buffers may still be read by frames in flight, so they are replaced rather
+    // than overwritten; the draws that used them hold them until their frame completes.
     auto makeBuf = [&](Microsoft::WRL::ComPtr<ID3D12Resource>& res, UINT bytes) {
-        if (res && res->GetDesc().Width >= bytes) return;
+        res.Reset();
         D3D12_HEAP_PROPERTIES hp{}; hp.Type = D3D12_HEAP_TYPE_UPLOAD;
         D3D12_RESOURCE_DESC rd{}; rd.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
         rd.Width = bytes ? bytes : 1; rd.Height = 1; rd.DepthOrArraySize = 1;
@@ -43,4 +104,103 @@ void MeshAsset::Upload(ID3D12Device* device) {
     ibv.SizeInBytes = ibBytes;
 
     indexCount = UINT(indices.size());
-}
\ No newline at end of file
+}
+
+void MeshAsset::ComputeBounds() {
+    // A released asset has no vertices: bounds come from the positions it kept, or from
+    // the GPU copy when it kept nothing.
+    std::vector<Vertex> readVertices;
+    std::vector<uint32_t> readIndices;
+    const std::vector<Vertex>* srcVertices = &vertices;
+    const std::vector<uint32_t>* srcIndices = &indices;
+    if (vertices.empty() && positions.empty() && IsCpuGeometryReleased()) {
+        ReadBackGeometry(readVertices, readIndices);
+        srcVertices = &readVertices;
+        srcIndices = &readIndices;
+    }
+    const bool fromPositions = srcVertices->empty() && !positions.empty();
+    const size_t vertexCount = fromPositions ? positions.size() : srcVertices->size();
+    auto position = [&](size_t i) {
+        return fromPositions ? XMLoadFloat3(&positions[i]) : LoadPosition((*srcVertices)[i]);
+    };
+
+    ComputeRangeBounds(vertexCount, position, bounds, sphere);
+
+    const std::vector<uint32_t>& idxAll = *srcIndices;
+    for (auto& sm : submeshes) {
+        const uint32_t start = std::min<uint32_t>(sm.indexStart, uint32_t(idxAll.size()));
+        const uint32_t count = vertexCount ? std::min<uint32_t>(sm.indexCount, uint32_t(idxAll.size()) - start) : 0;
+        const uint32_t* idx = idxAll.data() + start;
+        // Out-of-range indices are clamped rather than read past the end.
+        ComputeRangeBounds(count,
+            [&](size_t i) { return position(std::min<size_t>(idx[i], vertexCount - 1)); },
+            sm.bounds, sm.sphere);
+    }
+
+    impostor.reset();
+
+    std::lock_guard<std::mutex> lk(m_bvhMutex);
+    m_bvh.reset();
+}
+
+std::shared_ptr<const MeshBVH> MeshAsset::GetBVH() const {
+    std::lock_guard<std::mutex> lk(m_bvhMutex);
+    if (!m_bvh) {
+        auto bvh = std::make_shared<MeshBVH>();
+        bvh->Build(*this);
+        m_bvh = std::move(bvh);
+    }
+    return m_bvh;
+}
+
+size_t MeshAsset::ReleaseCpuGeometry(CpuRetention policy) {
+    if (policy == CpuRetention::Keep || IsCpuGeometryReleased() || !vb || !ib) return 0;
+
+    const size_t before = VectorBytes(vertices) + VectorBytes(indices);
+
+    if (policy == CpuRetention::PositionsOnly) {
+        positions.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+            positions[i] = XMFLOAT3(vertices[i].px, vertices[i].py, vertices[i].pz);
+    }
+    else {
+        std::vector<uint32_t>().swap(indices);
+    }
+    std::vector<Vertex>().swap(vertices);
+
+    const size_t after = VectorBytes(positions) + VectorBytes(indices);
+    m_retention = policy;
+    m_bytesReleased = before > after ? before - after : 0;
+    s_cpuBytesReleased += m_bytesReleased;
+    return m_bytesReleased;
+}
+
+size_t MeshAsset::RematerializeCpuGeometry() {
+    if (!IsCpuGeometryReleased()) return 0;
+
+    ReadBuffer(vb.Get(), vbv.SizeInBytes, vertices);
+    if (indices.empty())
+        ReadBuffer(ib.Get(), ibv.SizeInBytes, indices);
+    std::vector<XMFLOAT3>().swap(positions);
+
+    const size_t restored = m_bytesReleased;
+    s_cpuBytesReleased -= m_bytesReleased;
+    m_bytesReleased = 0;
+    m_retention = CpuRetention::Keep;
+    return restored;
+}
+
+void MeshAsset::ReadBackGeometry(std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices) const {
+    if (!IsCpuGeometryReleased()) {
+        outVertices = vertices;
+        outIndices = indices;
+        return;
+    }
+    ReadBuffer(vb.Get(), vbv.SizeInBytes, outVertices);
+    if (!indices.empty()) outIndices = indices;
+    else ReadBuffer(ib.Get(), ibv.SizeInBytes, outIndices);
+}
+
+size_t MeshAsset::CpuBytesReleased() {
+    return s_cpuBytesReleased.load();
+}
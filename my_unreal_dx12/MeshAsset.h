@@ -1,23 +1,15 @@
 #pragma once
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <wrl.h>
 #include <d3d12.h>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 #include "Texture.h"
-
-/**
- * @struct Vertex
- * @brief Represents a vertex in a mesh.
- */
-struct Vertex {
-    float px, py, pz;
-    float nx, ny, nz;
-    float r, g, b;
-    float u, v;
-    float tx, ty, tz;
-    float bx, by, bz;
-};
+#include "MeshBVH.h"
+#include "Vertex.h"
+#include "Impostor.h"
 
 /**
  * @struct Submesh
@@ -40,6 +32,20 @@ struct Submesh
 
     std::shared_ptr<Texture> metalRoughMap;
     bool hasMetalRoughMap = false;
+
+    DirectX::BoundingBox bounds{};
+    DirectX::BoundingSphere sphere{};
+};
+
+/**
+ * @enum CpuRetention
+ * @brief What a mesh asset keeps in system memory once its geometry is on the GPU.
+ */
+enum class CpuRetention
+{
+    Keep,            ///< Keep vertices and indices.
+    DropAfterUpload, ///< Release vertices and indices.
+    PositionsOnly    ///< Release vertices but keep positions and indices for picking and physics.
 };
 
 /**
@@ -50,9 +56,17 @@ struct Submesh
 class MeshAsset
 {
 public:
+    MeshAsset() = default;
+    MeshAsset(const MeshAsset&) = delete;
+    MeshAsset& operator=(const MeshAsset&) = delete;
+    ~MeshAsset();
+
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
 
+    /** Vertex positions, only filled while the asset is released with CpuRetention::PositionsOnly. */
+    std::vector<DirectX::XMFLOAT3> positions;
+
     float shininess = 128.f;
 
     Microsoft::WRL::ComPtr<ID3D12Resource> vb, ib;
@@ -64,6 +78,12 @@ public:
 
     std::vector<Submesh> submeshes;
 
+    DirectX::BoundingBox bounds{};
+    DirectX::BoundingSphere sphere{};
+
+    /** Views drawn in place of the asset from far away, baked by the renderer on first use. */
+    mutable std::shared_ptr<ImpostorAtlas> impostor;
+
 	/**
 	 * @brief Sets the shininess of the mesh asset.
 	 * @param s The new shininess value.
@@ -72,7 +92,76 @@ public:
 
     /**
      * @brief Uploads the mesh data to the GPU.
+     * Every call creates new buffers: frames in flight may still read the previous ones,
+     * which the command contexts keep alive until those frames complete.
      * @param device The D3D12 device.
      */
     void Upload(ID3D12Device* device);
+
+    /**
+     * @brief Computes the local-space bounds of the asset and of every submesh.
+     * Must be called again whenever the vertex positions or the index ranges change.
+     * Works on released assets too, from the kept positions or from a read-back of the GPU buffers.
+     * Also discards the ray query BVH and the impostor, which are rebuilt on next use.
+     */
+    void ComputeBounds();
+
+    /**
+     * @brief Gets the ray query BVH of the asset, building it on first use.
+     * Thread-safe; the returned tree stays valid even if the asset is rebuilt afterwards.
+     * @return A shared pointer to the BVH.
+     */
+    std::shared_ptr<const MeshBVH> GetBVH() const;
+
+    /**
+     * @brief Builds the ray query BVH now instead of on first use.
+     * Building before the CPU geometry is released avoids reading it back from the GPU.
+     */
+    void BuildBVH() const { GetBVH(); }
+
+    /**
+     * @brief Releases the CPU copy of the geometry according to a retention policy.
+     * Does nothing for CpuRetention::Keep or if the asset has not been uploaded.
+     * @param policy The retention policy to apply.
+     * @return The number of system memory bytes released.
+     */
+    size_t ReleaseCpuGeometry(CpuRetention policy);
+
+    /**
+     * @brief Restores the vertices and indices from the GPU buffers after a release.
+     * @return The number of system memory bytes allocated again.
+     */
+    size_t RematerializeCpuGeometry();
+
+    /**
+     * @brief Copies the uploaded geometry back from the GPU buffers without changing the asset.
+     * @param outVertices Receives the vertices.
+     * @param outIndices Receives the indices.
+     */
+    void ReadBackGeometry(std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices) const;
+
+    /**
+     * @brief Checks whether the vertices have been released from system memory.
+     * @return True if the CPU copy of the vertices is gone.
+     */
+    bool IsCpuGeometryReleased() const { return m_retention != CpuRetention::Keep; }
+
+    /**
+     * @brief Gets the retention policy currently applied to the asset.
+     * @return The retention policy.
+     */
+    CpuRetention Retention() const { return m_retention; }
+
+    /**
+     * @brief Gets the number of system memory bytes currently saved by released assets.
+     * @return The bytes saved across all live assets.
+     */
+    static size_t CpuBytesReleased();
+
+private:
+    CpuRetention m_retention = CpuRetention::Keep;
+    size_t m_bytesReleased = 0;
+
+    mutable std::mutex m_bvhMutex;
+    mutable std::shared_ptr<const MeshBVH> m_bvh;
 };
@@ -0,0 +1,289 @@
+#include "MeshBVH.h"
+#include "MeshAsset.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace {
+    constexpr int kBinCount = 16;
+    constexpr uint32_t kMaxLeafSize = 8;
+    constexpr int kMaxDepth = 60;
+    constexpr int kStackSize = 64;
+
+    // Relative costs of visiting a node and intersecting a triangle, used by the SAH.
+    constexpr float kTraversalCost = 1.0f;
+    constexpr float kIntersectCost = 1.5f;
+
+    struct Bin {
+        XMVECTOR bmin = XMVectorReplicate(FLT_MAX);
+        XMVECTOR bmax = XMVectorReplicate(-FLT_MAX);
+        uint32_t count = 0;
+    };
+
+    inline float HalfArea(FXMVECTOR bmin, FXMVECTOR bmax) {
+        XMFLOAT3 e;
+        XMStoreFloat3(&e, XMVectorMax(XMVectorSubtract(bmax, bmin), XMVectorZero()));
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    // Moller-Trumbore against a triangle stored as (v0, e1, e2).
+    inline bool IntersectTriangle(const XMFLOAT3* tri, FXMVECTOR origin, FXMVECTOR dir, float maxT,
+                                  float& t, float& u, float& v) {
+        const XMVECTOR e1 = XMLoadFloat3(&tri[1]);
+        const XMVECTOR e2 = XMLoadFloat3(&tri[2]);
+        const XMVECTOR p = XMVector3Cross(dir, e2);
+        const float det = XMVectorGetX(XMVector3Dot(e1, p));
+        if (std::fabs(det) < 1e-20f) return false;
+
+        const float invDet = 1.f / det;
+        const XMVECTOR s = XMVectorSubtract(origin, XMLoadFloat3(&tri[0]));
+        u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+        if (u < 0.f || u > 1.f) return false;
+
+        const XMVECTOR q = XMVector3Cross(s, e1);
+        v = XMVectorGetX(XMVector3Dot(dir, q)) * invDet;
+        if (v < 0.f || u + v > 1.f) return false;
+
+        t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+        return t > 0.f && t < maxT;
+    }
+}
+
+void MeshBVH::Build(const MeshAsset& asset) {
+    if (!asset.positions.empty()) {
+        Build(asset.positions, asset.indices);
+        return;
+    }
+
+    std::vector<Vertex> readVertices;
+    std::vector<uint32_t> readIndices;
+    const std::vector<Vertex>* vertices = &asset.vertices;
+    const std::vector<uint32_t>* indices = &asset.indices;
+    if (asset.IsCpuGeometryReleased()) {
+        asset.ReadBackGeometry(readVertices, readIndices);
+        vertices = &readVertices;
+        indices = &readIndices;
+    }
+
+    std::vector<XMFLOAT3> positions(vertices->size());
+    for (size_t i = 0; i < vertices->size(); ++i)
+        positions[i] = XMFLOAT3((*vertices)[i].px, (*vertices)[i].py, (*vertices)[i].pz);
+    Build(positions, *indices);
+}
+
+void MeshBVH::Build(const std::vector<XMFLOAT3>& positions, const std::vector<uint32_t>& indices) {
+    m_nodes.clear();
+    m_triangles.clear();
+    m_triangleIds.clear();
+
+    // Per-triangle bounds and centroids; triangles with out-of-range indices are skipped.
+    std::vector<uint32_t> order;
+    std::vector<XMFLOAT3> triMin, triMax, centroid;
+    const uint32_t triCount = uint32_t(indices.size() / 3);
+    order.reserve(triCount);
+    triMin.resize(triCount);
+    triMax.resize(triCount);
+    centroid.resize(triCount);
+
+    for (uint32_t t = 0; t < triCount; ++t) {
+        const uint32_t i0 = indices[3 * t], i1 = indices[3 * t + 1], i2 = indices[3 * t + 2];
+        if (i0 >= positions.size() || i1 >= positions.size() || i2 >= positions.size()) continue;
+        const XMVECTOR a = XMLoadFloat3(&positions[i0]);
+        const XMVECTOR b = XMLoadFloat3(&positions[i1]);
+        const XMVECTOR c = XMLoadFloat3(&positions[i2]);
+        const XMVECTOR mn = XMVectorMin(XMVectorMin(a, b), c);
+        const XMVECTOR mx = XMVectorMax(XMVectorMax(a, b), c);
+        XMStoreFloat3(&triMin[t], mn);
+        XMStoreFloat3(&triMax[t], mx);
+        XMStoreFloat3(&centroid[t], XMVectorScale(XMVectorAdd(mn, mx), 0.5f));
+        order.push_back(t);
+    }
+    if (order.empty()) return;
+
+    auto computeBounds = [&](Node& node) {
+        XMVECTOR mn = XMVectorReplicate(FLT_MAX), mx = XMVectorReplicate(-FLT_MAX);
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+            mn = XMVectorMin(mn, XMLoadFloat3(&triMin[order[i]]));
+            mx = XMVectorMax(mx, XMLoadFloat3(&triMax[order[i]]));
+        }
+        XMStoreFloat3(&node.bmin, mn);
+        XMStoreFloat3(&node.bmax, mx);
+    };
+
+    m_nodes.reserve(2 * order.size());
+    m_nodes.push_back({ {}, 0, {}, uint32_t(order.size()) });
+    computeBounds(m_nodes[0]);
+
+    struct Pending { uint32_t node; int depth; };
+    std::vector<Pending> pending{ { 0, 0 } };
+
+    while (!pending.empty()) {
+        const Pending job = pending.back();
+        pending.pop_back();
+
+        Node& node = m_nodes[job.node];
+        const uint32_t first = node.leftOrFirst;
+        const uint32_t count = node.count;
+        if (count <= 2 || job.depth >= kMaxDepth) continue;
+
+        XMVECTOR cMin = XMVectorReplicate(FLT_MAX), cMax = XMVectorReplicate(-FLT_MAX);
+        for (uint32_t i = first; i < first + count; ++i) {
+            const XMVECTOR c = XMLoadFloat3(&centroid[order[i]]);
+            cMin = XMVectorMin(cMin, c);
+            cMax = XMVectorMax(cMax, c);
+        }
+        XMFLOAT3 lo, hi;
+        XMStoreFloat3(&lo, cMin);
+        XMStoreFloat3(&hi, cMax);
+
+        // Binned SAH: evaluate kBinCount - 1 split planes on each axis.
+        float bestCost = FLT_MAX;
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float axisMin = (&lo.x)[axis];
+            const float extent = (&hi.x)[axis] - axisMin;
+            if (extent <= 0.f) continue;
+            const float scale = kBinCount / extent;
+
+            Bin bins[kBinCount];
+            for (uint32_t i = first; i < first + count; ++i) {
+                const uint32_t t = order[i];
+                const int b = std::min(kBinCount - 1, int(((&centroid[t].x)[axis] - axisMin) * scale));
+                bins[b].bmin = XMVectorMin(bins[b].bmin, XMLoadFloat3(&triMin[t]));
+                bins[b].bmax = XMVectorMax(bins[b].bmax, XMLoadFloat3(&triMax[t]));
+                ++bins[b].count;
+            }
+
+            float leftArea[kBinCount - 1], rightArea[kBinCount - 1];
+            uint32_t leftCount[kBinCount - 1], rightCount[kBinCount - 1];
+            XMVECTOR lMin = XMVectorReplicate(FLT_MAX), lMax = XMVectorReplicate(-FLT_MAX);
+            XMVECTOR rMin = lMin, rMax = lMax;
+            uint32_t lSum = 0, rSum = 0;
+            for (int i = 0; i < kBinCount - 1; ++i) {
+                lSum += bins[i].count;
+                lMin = XMVectorMin(lMin, bins[i].bmin);
+                lMax = XMVectorMax(lMax, bins[i].bmax);
+                leftCount[i] = lSum;
+                leftArea[i] = lSum ? HalfArea(lMin, lMax) : 0.f;
+
+                const int j = kBinCount - 1 - i;
+                rSum += bins[j].count;
+                rMin = XMVectorMin(rMin, bins[j].bmin);
+                rMax = XMVectorMax(rMax, bins[j].bmax);
+                rightCount[j - 1] = rSum;
+                rightArea[j - 1] = rSum ? HalfArea(rMin, rMax) : 0.f;
+            }
+
+            for (int i = 0; i < kBinCount - 1; ++i) {
+                if (!leftCount[i] || !rightCount[i]) continue;
+                const float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        if (bestAxis < 0) continue;
+
+        const float parentArea = HalfArea(XMLoadFloat3(&node.bmin), XMLoadFloat3(&node.bmax));
+        const float splitCost = kTraversalCost + kIntersectCost * bestCost / std::max(parentArea, 1e-20f);
+        const float leafCost = kIntersectCost * count;
+        if (count <= kMaxLeafSize && splitCost >= leafCost) continue;
+
+        const float axisMin = (&lo.x)[bestAxis];
+        const float scale = kBinCount / ((&hi.x)[bestAxis] - axisMin);
+        const auto mid = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t t) {
+            return std::min(kBinCount - 1, int(((&centroid[t].x)[bestAxis] - axisMin) * scale)) <= bestSplit;
+        });
+        const uint32_t leftCountFinal = uint32_t(mid - (order.begin() + first));
+        if (leftCountFinal == 0 || leftCountFinal == count) continue;
+
+        const uint32_t left = uint32_t(m_nodes.size());
+        m_nodes.push_back({ {}, first, {}, leftCountFinal });
+        m_nodes.push_back({ {}, first + leftCountFinal, {}, count - leftCountFinal });
+        computeBounds(m_nodes[left]);
+        computeBounds(m_nodes[left + 1]);
+
+        // push_back may have reallocated, so the parent is re-fetched.
+        m_nodes[job.node].leftOrFirst = left;
+        m_nodes[job.node].count = 0;
+
+        pending.push_back({ left, job.depth + 1 });
+        pending.push_back({ left + 1, job.depth + 1 });
+    }
+    m_nodes.shrink_to_fit();
+
+    m_triangles.resize(order.size() * 3);
+    m_triangleIds = order;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const uint32_t* tri = &indices[3 * size_t(order[i])];
+        const XMVECTOR v0 = XMLoadFloat3(&positions[tri[0]]);
+        m_triangles[3 * i] = positions[tri[0]];
+        XMStoreFloat3(&m_triangles[3 * i + 1], XMVectorSubtract(XMLoadFloat3(&positions[tri[1]]), v0));
+        XMStoreFloat3(&m_triangles[3 * i + 2], XMVectorSubtract(XMLoadFloat3(&positions[tri[2]]), v0));
+    }
+}
+
+template<bool AnyHitQuery>
+bool MeshBVH::Traverse(FXMVECTOR origin, FXMVECTOR dir, float maxT, RayHit* hit) const {
+    if (m_nodes.empty()) return false;
+
+    const XMVECTOR invDir = InverseDirection(dir);
+
+    float closest = maxT;
+    uint32_t best = UINT32_MAX;
+
+    struct Entry { uint32_t node; float t; };
+    Entry stack[kStackSize];
+    int sp = 0;
+
+    const float rootT = IntersectBox(m_nodes[0], origin, invDir, closest);
+    if (rootT == FLT_MAX) return false;
+    stack[sp++] = { 0, rootT };
+
+    while (sp > 0) {
+        const Entry e = stack[--sp];
+        if (e.t >= closest) continue;
+
+        const Node* node = &m_nodes[e.node];
+        while (!node->IsLeaf()) {
+            uint32_t c0 = node->leftOrFirst, c1 = c0 + 1;
+            float t0 = IntersectBox(m_nodes[c0], origin, invDir, closest);
+            float t1 = IntersectBox(m_nodes[c1], origin, invDir, closest);
+            if (t0 > t1) { std::swap(c0, c1); std::swap(t0, t1); }
+            if (t0 == FLT_MAX) { node = nullptr; break; }
+            if (t1 != FLT_MAX && sp < kStackSize) stack[sp++] = { c1, t1 };
+            node = &m_nodes[c0];
+        }
+        if (!node) continue;
+
+        for (uint32_t i = node->leftOrFirst; i < node->leftOrFirst + node->count; ++i) {
+            float t, u, v;
+            if (!IntersectTriangle(&m_triangles[3 * size_t(i)], origin, dir, closest, t, u, v)) continue;
+            if constexpr (AnyHitQuery) return true;
+            best = i;
+            closest = t;
+            hit->t = t;
+            hit->triangle = m_triangleIds[i];
+            hit->u = u;
+            hit->v = v;
+        }
+    }
+    if (best == UINT32_MAX) return false;
+
+    const XMVECTOR n = XMVector3Cross(XMLoadFloat3(&m_triangles[3 * size_t(best) + 1]), XMLoadFloat3(&m_triangles[3 * size_t(best) + 2]));
+    XMStoreFloat3(&hit->normal, XMVector3Normalize(n));
+    return true;
+}
+
+bool MeshBVH::Raycast(FXMVECTOR origin, FXMVECTOR dir, float maxT, RayHit& hit) const {
+    return Traverse<false>(origin, dir, maxT, &hit);
+}
+
+bool MeshBVH::AnyHit(FXMVECTOR origin, FXMVECTOR dir, float maxT) const {
+    return Traverse<true>(origin, dir, maxT, nullptr);
+}
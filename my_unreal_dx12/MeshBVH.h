@@ -0,0 +1,157 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+class MeshAsset;
+
+/**
+ * @struct RayHit
+ * @brief Describes the closest intersection found by a ray query.
+ */
+struct RayHit
+{
+    /** Distance along the ray, in units of the ray direction length. */
+    float t = 0.f;
+
+    /** Index of the triangle in the asset index buffer (first index / 3). */
+    uint32_t triangle = 0;
+
+    /** Barycentric coordinates of the hit relative to the second and third vertex. */
+    float u = 0.f;
+    float v = 0.f;
+
+    /** Unit geometric normal of the triangle, not oriented towards the ray. */
+    DirectX::XMFLOAT3 normal{ 0.f, 0.f, 0.f };
+};
+
+/**
+ * @class MeshBVH
+ * @brief Bounding volume hierarchy over the triangles of a mesh asset.
+ * The tree is built with a binned surface area heuristic. Nodes are 32 bytes, the two
+ * children of an interior node are stored next to each other, and the triangles are
+ * copied in leaf order so a traversal only touches the node and triangle arrays.
+ */
+class MeshBVH
+{
+public:
+    /**
+     * @struct Node
+     * @brief A BVH node. Interior nodes have a zero count and store the index of their
+     * first child; leaves store the index of their first triangle and the triangle count.
+     */
+    struct Node
+    {
+        DirectX::XMFLOAT3 bmin;
+        uint32_t leftOrFirst;
+        DirectX::XMFLOAT3 bmax;
+        uint32_t count;
+
+        bool IsLeaf() const { return count != 0; }
+    };
+
+    /**
+     * @brief Computes the reciprocal of a ray direction for the slab test.
+     * Components close to zero are nudged so axis-parallel rays never compute 0 * inf.
+     * @param dir The ray direction.
+     * @return The per-component reciprocal.
+     */
+    static DirectX::XMVECTOR InverseDirection(DirectX::FXMVECTOR dir) {
+        using namespace DirectX;
+        const XMVECTOR tiny = XMVectorReplicate(1e-20f);
+        return XMVectorReciprocal(XMVectorSelect(dir, tiny, XMVectorLess(XMVectorAbs(dir), tiny)));
+    }
+
+    /**
+     * @brief Intersects a ray with the box of a node.
+     * @param node The node.
+     * @param origin The ray origin.
+     * @param invDir The reciprocal ray direction from InverseDirection.
+     * @param maxT Boxes entered beyond this distance count as missed.
+     * @return The entry distance, or FLT_MAX if the box is missed.
+     */
+    static float IntersectBox(const Node& node, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR invDir, float maxT) {
+        using namespace DirectX;
+        const XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.bmin), origin), invDir);
+        const XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.bmax), origin), invDir);
+        const XMVECTOR tn = XMVectorMin(t1, t2);
+        const XMVECTOR tf = XMVectorMax(t1, t2);
+        const float tNear = XMVectorGetX(XMVectorMax(XMVectorMax(tn, XMVectorSplatY(tn)), XMVectorSplatZ(tn)));
+        const float tFar = XMVectorGetX(XMVectorMin(XMVectorMin(tf, XMVectorSplatY(tf)), XMVectorSplatZ(tf)));
+        return (tFar >= (tNear > 0.f ? tNear : 0.f) && tNear < maxT) ? tNear : FLT_MAX;
+    }
+
+    /**
+     * @brief Builds the tree from the geometry of a mesh asset.
+     * Uses the CPU vertices if present, the retained positions otherwise, and reads the
+     * geometry back from the GPU buffers as a last resort.
+     * @param asset The mesh asset.
+     */
+    void Build(const MeshAsset& asset);
+
+    /**
+     * @brief Builds the tree from raw positions and triangle indices.
+     * @param positions The vertex positions.
+     * @param indices The triangle list indices.
+     */
+    void Build(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices);
+
+    /**
+     * @brief Finds the closest triangle hit by a ray.
+     * @param origin The ray origin.
+     * @param dir The ray direction; it does not need to be normalized.
+     * @param maxT Hits farther than this distance along the ray are ignored.
+     * @param hit Receives the closest hit.
+     * @return True if a triangle was hit.
+     */
+    bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT, RayHit& hit) const;
+
+    /**
+     * @brief Checks whether a ray hits any triangle, stopping at the first hit found.
+     * Suited to line-of-sight and shadow checks.
+     * @param origin The ray origin.
+     * @param dir The ray direction; it does not need to be normalized.
+     * @param maxT Hits farther than this distance along the ray are ignored.
+     * @return True if any triangle was hit.
+     */
+    bool AnyHit(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT) const;
+
+    /**
+     * @brief Checks whether the tree contains no triangles.
+     * @return True if the tree is empty.
+     */
+    bool Empty() const { return m_triangleIds.empty(); }
+
+    /**
+     * @brief Gets the number of nodes.
+     * @return The node count.
+     */
+    size_t NodeCount() const { return m_nodes.size(); }
+
+    /**
+     * @brief Gets the number of triangles.
+     * @return The triangle count.
+     */
+    size_t TriangleCount() const { return m_triangleIds.size(); }
+
+    /**
+     * @brief Gets the memory used by the tree.
+     * @return The size in bytes.
+     */
+    size_t MemoryBytes() const {
+        return m_nodes.capacity() * sizeof(Node)
+            + m_triangles.capacity() * sizeof(DirectX::XMFLOAT3)
+            + m_triangleIds.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    template<bool AnyHitQuery>
+    bool Traverse(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT, RayHit* hit) const;
+
+    std::vector<Node> m_nodes;
+    /** First vertex and the two edges from it for every triangle, in leaf order. */
+    std::vector<DirectX::XMFLOAT3> m_triangles;
+    /** Original triangle index of every triangle, in leaf order. */
+    std::vector<uint32_t> m_triangleIds;
+};
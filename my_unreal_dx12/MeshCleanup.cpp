@@ -0,0 +1,148 @@
+#include "MeshCleanup.h"
+#include <unordered_map>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace {
+    constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    inline int64_t CellCoord(float v, double invCell) {
+        return static_cast<int64_t>(std::floor(double(v) * invCell));
+    }
+
+    // Far-apart cells may collide after packing; that only adds candidates, which are
+    // rejected by the distance test.
+    inline uint64_t CellKey(int64_t x, int64_t y, int64_t z) {
+        constexpr uint64_t mask = (1ull << 21) - 1;
+        return ((uint64_t(x) & mask) << 42) | ((uint64_t(y) & mask) << 21) | (uint64_t(z) & mask);
+    }
+
+    inline XMVECTOR Load3(const float* p) { return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(p)); }
+    inline XMVECTOR Load2(const float* p) { return XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(p)); }
+
+    bool CanWeld(const Vertex& a, const Vertex& b, FXMVECTOR posEps, FXMVECTOR attrEps) {
+        return XMVector3NearEqual(Load3(&a.px), Load3(&b.px), posEps)
+            && XMVector3NearEqual(Load3(&a.nx), Load3(&b.nx), attrEps)
+            && XMVector2NearEqual(Load2(&a.u), Load2(&b.u), attrEps)
+            && XMVector3NearEqual(Load3(&a.r), Load3(&b.r), attrEps);
+    }
+}
+
+MeshCleanupStats CleanupMesh(MeshAsset& asset, const MeshCleanupOptions& options)
+{
+    std::vector<Vertex>& verts = asset.vertices;
+    std::vector<uint32_t>& idx = asset.indices;
+
+    MeshCleanupStats stats;
+    stats.verticesBefore = uint32_t(verts.size());
+    stats.trianglesBefore = uint32_t(idx.size() / 3);
+    stats.verticesAfter = stats.verticesBefore;
+    stats.trianglesAfter = stats.trianglesBefore;
+    if (verts.empty() || idx.size() < 3) return stats;
+
+    const float eps = std::max(options.positionEpsilon, 1e-12f);
+    const double invCell = 1.0 / double(eps);
+    const XMVECTOR posEps = XMVectorReplicate(eps);
+    const XMVECTOR attrEps = XMVectorReplicate(options.attributeEpsilon);
+
+    // 1. Weld: each vertex maps to the first earlier vertex within tolerance found in
+    // its own or a neighbouring hash cell. Only representatives are inserted in the grid.
+    std::vector<uint32_t> remap(verts.size());
+    std::vector<uint32_t> next(verts.size(), kNone);
+    std::unordered_map<uint64_t, uint32_t> cellHead;
+    cellHead.reserve(verts.size());
+
+    for (uint32_t i = 0; i < uint32_t(verts.size()); ++i) {
+        const Vertex& v = verts[i];
+        const int64_t cx = CellCoord(v.px, invCell);
+        const int64_t cy = CellCoord(v.py, invCell);
+        const int64_t cz = CellCoord(v.pz, invCell);
+
+        uint32_t found = kNone;
+        for (int dz = -1; dz <= 1 && found == kNone; ++dz)
+            for (int dy = -1; dy <= 1 && found == kNone; ++dy)
+                for (int dx = -1; dx <= 1 && found == kNone; ++dx) {
+                    auto it = cellHead.find(CellKey(cx + dx, cy + dy, cz + dz));
+                    if (it == cellHead.end()) continue;
+                    for (uint32_t j = it->second; j != kNone; j = next[j]) {
+                        if (CanWeld(verts[j], v, posEps, attrEps)) { found = j; break; }
+                    }
+                }
+
+        if (found != kNone) {
+            remap[i] = found;
+            ++stats.weldedVertices;
+            continue;
+        }
+
+        remap[i] = i;
+        auto [it, inserted] = cellHead.try_emplace(CellKey(cx, cy, cz), i);
+        if (!inserted) {
+            next[i] = it->second;
+            it->second = i;
+        }
+    }
+
+    // 2. Rewrite indices per submesh and drop triangles that collapsed or have no area.
+    const float areaEps = eps * eps;
+    const XMVECTOR areaEpsSq = XMVectorReplicate(areaEps * areaEps);
+    std::vector<uint32_t> outIdx;
+    outIdx.reserve(idx.size());
+
+    auto emitRange = [&](uint32_t start, uint32_t count) {
+        const uint32_t end = std::min<uint32_t>(start + count, uint32_t(idx.size()));
+        for (uint32_t t = start; t + 2 < end; t += 3) {
+            const uint32_t a = remap[idx[t]];
+            const uint32_t b = remap[idx[t + 1]];
+            const uint32_t c = remap[idx[t + 2]];
+            if (a == b || b == c || a == c) { ++stats.degenerateTriangles; continue; }
+
+            const XMVECTOR pa = Load3(&verts[a].px);
+            const XMVECTOR n = XMVector3Cross(
+                XMVectorSubtract(Load3(&verts[b].px), pa),
+                XMVectorSubtract(Load3(&verts[c].px), pa));
+            if (XMVector3LessOrEqual(XMVector3LengthSq(n), areaEpsSq)) { ++stats.degenerateTriangles; continue; }
+
+            outIdx.push_back(a);
+            outIdx.push_back(b);
+            outIdx.push_back(c);
+        }
+    };
+
+    if (asset.submeshes.empty()) {
+        emitRange(0, uint32_t(idx.size()));
+    }
+    else {
+        for (auto& sm : asset.submeshes) {
+            const uint32_t start = uint32_t(outIdx.size());
+            emitRange(sm.indexStart, sm.indexCount);
+            sm.indexStart = start;
+            sm.indexCount = uint32_t(outIdx.size()) - start;
+        }
+    }
+
+    // 3. Compact: keep referenced vertices in their original order.
+    std::vector<uint32_t> newIndex(verts.size(), kNone);
+    for (uint32_t i : outIdx) newIndex[i] = 0;
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < uint32_t(verts.size()); ++i) {
+        if (newIndex[i] == kNone) continue;
+        newIndex[i] = kept;
+        if (kept != i) verts[kept] = verts[i];
+        ++kept;
+    }
+    verts.resize(kept);
+    verts.shrink_to_fit();
+
+    for (uint32_t& i : outIdx) i = newIndex[i];
+    idx = std::move(outIdx);
+
+    stats.verticesAfter = kept;
+    stats.trianglesAfter = uint32_t(idx.size() / 3);
+    stats.unusedVertices = stats.verticesBefore - stats.weldedVertices - kept;
+    return stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include "MeshAsset.h"
+
+/**
+ * @struct MeshCleanupOptions
+ * @brief Controls the optional cleanup pass run on imported meshes.
+ */
+struct MeshCleanupOptions
+{
+    bool enabled = false;
+
+    /** Vertices closer than this (per axis) are candidates for welding. */
+    float positionEpsilon = 1e-5f;
+
+    /** Maximum difference allowed on normals, UVs and colors for two vertices to be welded. */
+    float attributeEpsilon = 1e-3f;
+};
+
+/**
+ * @struct MeshCleanupStats
+ * @brief Reports what a cleanup pass removed.
+ */
+struct MeshCleanupStats
+{
+    uint32_t verticesBefore = 0;
+    uint32_t verticesAfter = 0;
+    uint32_t trianglesBefore = 0;
+    uint32_t trianglesAfter = 0;
+
+    uint32_t weldedVertices = 0;
+    uint32_t unusedVertices = 0;
+    uint32_t degenerateTriangles = 0;
+
+    MeshCleanupStats& operator+=(const MeshCleanupStats& o)
+    {
+        verticesBefore += o.verticesBefore;
+        verticesAfter += o.verticesAfter;
+        trianglesBefore += o.trianglesBefore;
+        trianglesAfter += o.trianglesAfter;
+        weldedVertices += o.weldedVertices;
+        unusedVertices += o.unusedVertices;
+        degenerateTriangles += o.degenerateTriangles;
+        return *this;
+    }
+};
+
+/**
+ * @brief Welds near-duplicate vertices, drops degenerate triangles and compacts the vertex array.
+ * Welding uses a spatial hash with cells of positionEpsilon, so it runs in roughly linear time.
+ * Submesh index ranges are rewritten to match the new index buffer. Bounds, normals and
+ * tangents are not recomputed; callers run this before those steps.
+ * @param asset The asset to clean up in place.
+ * @param options The cleanup tolerances.
+ * @return The number of vertices and triangles removed.
+ */
+MeshCleanupStats CleanupMesh(MeshAsset& asset, const MeshCleanupOptions& options);
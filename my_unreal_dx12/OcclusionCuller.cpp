@@ -0,0 +1,252 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace {
+    constexpr uint32_t kBandRows = 2 * OcclusionCuller::kTileHeight;
+
+    struct ClipVertex { float x, y, z, w; };
+
+    ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t) {
+        return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+    }
+}
+
+void OcclusionCuller::SetResolution(uint32_t width, uint32_t height) {
+    m_tilesX = std::max(1u, (width + kTileWidth - 1) / kTileWidth);
+    m_tilesY = std::max(1u, (height + kTileHeight - 1) / kTileHeight);
+    m_width = m_tilesX * kTileWidth;
+    m_height = m_tilesY * kTileHeight;
+}
+
+void OcclusionCuller::BeginFrame(FXMMATRIX viewProj) {
+    XMStoreFloat4x4(&m_viewProj, viewProj);
+    m_depth.assign(size_t(m_width) * m_height, 1.f);
+    m_tileMaxDepth.assign(size_t(m_tilesX) * m_tilesY, 1.f);
+    m_occluders.clear();
+    m_triangleCount = 0;
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, size_t stride,
+    const uint32_t* indices, size_t indexCount, FXMMATRIX world) {
+    if (!positions || !indices || indexCount < 3) return;
+    Occluder o{ positions, stride, indices, indexCount, {} };
+    XMStoreFloat4x4(&o.worldViewProj, XMMatrixMultiply(world, XMLoadFloat4x4(&m_viewProj)));
+    m_occluders.push_back(o);
+}
+
+void OcclusionCuller::SetupTriangles(const Occluder& occluder, std::vector<ScreenTri>& out) const {
+    out.clear();
+    const XMMATRIX wvp = XMLoadFloat4x4(&occluder.worldViewProj);
+    const auto* base = reinterpret_cast<const uint8_t*>(occluder.positions);
+    const float halfW = 0.5f * float(m_width), halfH = 0.5f * float(m_height);
+
+    auto emit = [&](const ClipVertex* v) {
+        ScreenTri t;
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+        for (int k = 0; k < 3; ++k) {
+            const float invW = 1.f / v[k].w;
+            t.x[k] = (v[k].x * invW + 1.f) * halfW;
+            t.y[k] = (1.f - v[k].y * invW) * halfH;
+            t.z[k] = v[k].z * invW;
+            minX = std::min(minX, t.x[k]); maxX = std::max(maxX, t.x[k]);
+            minY = std::min(minY, t.y[k]); maxY = std::max(maxY, t.y[k]);
+        }
+        if (maxX < 0.f || minX > float(m_width) || maxY < 0.f || minY > float(m_height)) return;
+        t.minY = std::max(0, int32_t(std::floor(minY)));
+        t.maxY = std::min(int32_t(m_height) - 1, int32_t(std::ceil(maxY)));
+        if (t.minY > t.maxY) return;
+        out.push_back(t);
+    };
+
+    for (size_t i = 0; i + 2 < occluder.indexCount; i += 3) {
+        ClipVertex v[3];
+        uint32_t behind = 0;
+        for (int k = 0; k < 3; ++k) {
+            const auto* p = reinterpret_cast<const XMFLOAT3*>(base + occluder.indices[i + k] * occluder.stride);
+            XMFLOAT4 c;
+            XMStoreFloat4(&c, XMVector3Transform(XMLoadFloat3(p), wvp));
+            v[k] = { c.x, c.y, c.z, c.w };
+            if (c.z < 0.f) behind |= 1u << k;
+        }
+        if (behind == 7u) continue;
+        if (behind == 0u) {
+            emit(v);
+            continue;
+        }
+
+        // Clip against the near plane (z >= 0), which leaves one or two triangles.
+        ClipVertex poly[4];
+        int n = 0;
+        for (int k = 0; k < 3; ++k) {
+            const ClipVertex& a = v[k];
+            const ClipVertex& b = v[(k + 1) % 3];
+            const bool aIn = !(behind & (1u << k));
+            const bool bIn = !(behind & (1u << ((k + 1) % 3)));
+            if (aIn) poly[n++] = a;
+            if (aIn != bIn) poly[n++] = Lerp(a, b, a.z / (a.z - b.z));
+        }
+        emit(poly);
+        if (n == 4) {
+            const ClipVertex second[3] = { poly[0], poly[2], poly[3] };
+            emit(second);
+        }
+    }
+}
+
+void OcclusionCuller::RasterizeBand(uint32_t rowBegin, uint32_t rowEnd) {
+    const XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+    const XMVECTOR zero = XMVectorZero();
+
+    for (const auto& list : m_triangles) {
+        for (const ScreenTri& t : list) {
+            if (t.maxY < int32_t(rowBegin) || t.minY >= int32_t(rowEnd)) continue;
+
+            float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+            if (std::fabs(area) < 1e-8f) continue;
+
+            // Edge k is opposite vertex k: E(x, y) = a * x + b * y + c, positive inside once
+            // the winding is made counter-clockwise.
+            const float sign = area > 0.f ? 1.f : -1.f;
+            float a[3], b[3], c[3];
+            for (int k = 0; k < 3; ++k) {
+                const int i0 = (k + 1) % 3, i1 = (k + 2) % 3;
+                a[k] = sign * (t.y[i0] - t.y[i1]);
+                b[k] = sign * (t.x[i1] - t.x[i0]);
+                c[k] = sign * (t.x[i0] * t.y[i1] - t.x[i1] * t.y[i0]);
+            }
+
+            // Depth is planar in screen space: z = z0 + dzdx * x + dzdy * y.
+            const float invArea = 1.f / std::fabs(area);
+            const float dzdx = (a[0] * t.z[0] + a[1] * t.z[1] + a[2] * t.z[2]) * invArea;
+            const float dzdy = (b[0] * t.z[0] + b[1] * t.z[1] + b[2] * t.z[2]) * invArea;
+            const float z0 = (c[0] * t.z[0] + c[1] * t.z[1] + c[2] * t.z[2]) * invArea;
+
+            const float minX = std::min({ t.x[0], t.x[1], t.x[2] });
+            const float maxX = std::max({ t.x[0], t.x[1], t.x[2] });
+            const uint32_t x0 = uint32_t(std::max(0.f, std::floor(minX))) & ~3u;
+            const uint32_t x1 = std::min(m_width, uint32_t(std::max(0.f, std::ceil(maxX))) + 1);
+            const uint32_t y0 = std::max<uint32_t>(rowBegin, uint32_t(t.minY));
+            const uint32_t y1 = std::min<uint32_t>(rowEnd, uint32_t(t.maxY) + 1);
+
+            const XMVECTOR ea = XMVectorSet(a[0], a[1], a[2], 0.f);
+            for (uint32_t y = y0; y < y1; ++y) {
+                const float py = float(y) + 0.5f;
+                const XMVECTOR e0Row = XMVectorReplicate(b[0] * py + c[0]);
+                const XMVECTOR e1Row = XMVectorReplicate(b[1] * py + c[1]);
+                const XMVECTOR e2Row = XMVectorReplicate(b[2] * py + c[2]);
+                const XMVECTOR zRow = XMVectorReplicate(z0 + dzdy * py);
+                float* row = m_depth.data() + size_t(y) * m_width;
+
+                for (uint32_t x = x0; x < x1; x += 4) {
+                    const XMVECTOR px = XMVectorAdd(XMVectorReplicate(float(x)), laneOffsets);
+                    const XMVECTOR e0 = XMVectorMultiplyAdd(px, XMVectorSplatX(ea), e0Row);
+                    const XMVECTOR e1 = XMVectorMultiplyAdd(px, XMVectorSplatY(ea), e1Row);
+                    const XMVECTOR e2 = XMVectorMultiplyAdd(px, XMVectorSplatZ(ea), e2Row);
+                    const XMVECTOR inside = XMVectorAndInt(XMVectorGreaterOrEqual(e0, zero),
+                        XMVectorAndInt(XMVectorGreaterOrEqual(e1, zero), XMVectorGreaterOrEqual(e2, zero)));
+                    if (XMVector4EqualInt(inside, XMVectorFalseInt())) continue;
+
+                    const XMVECTOR z = XMVectorMultiplyAdd(px, XMVectorReplicate(dzdx), zRow);
+                    const XMVECTOR old = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+                    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(row + x),
+                        XMVectorSelect(old, XMVectorMin(old, z), inside));
+                }
+            }
+        }
+    }
+
+    // Farthest depth of each tile in the band.
+    for (uint32_t ty = rowBegin / kTileHeight; ty < rowEnd / kTileHeight; ++ty) {
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx) {
+            XMVECTOR farthest = zero;
+            for (uint32_t y = ty * kTileHeight; y < (ty + 1) * kTileHeight; ++y) {
+                const float* p = m_depth.data() + size_t(y) * m_width + tx * kTileWidth;
+                for (uint32_t x = 0; x < kTileWidth; x += 4)
+                    farthest = XMVectorMax(farthest, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + x)));
+            }
+            XMFLOAT4 f;
+            XMStoreFloat4(&f, farthest);
+            m_tileMaxDepth[size_t(ty) * m_tilesX + tx] = std::max(std::max(f.x, f.y), std::max(f.z, f.w));
+        }
+    }
+}
+
+void OcclusionCuller::Rasterize() {
+    const auto start = std::chrono::steady_clock::now();
+
+    // Transform and clip each occluder on its own thread, then give each thread a band
+    // of rows so no two threads write the same pixels.
+    m_triangles.resize(m_occluders.size());
+    JobSystem::I().ParallelFor(uint32_t(m_occluders.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) SetupTriangles(m_occluders[i], m_triangles[i]);
+    });
+
+    m_triangleCount = 0;
+    for (size_t i = 0; i < m_occluders.size(); ++i) m_triangleCount += uint32_t(m_triangles[i].size());
+
+    const uint32_t bandCount = (m_height + kBandRows - 1) / kBandRows;
+    JobSystem::I().ParallelFor(bandCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t band = begin; band < end; ++band)
+            RasterizeBand(band * kBandRows, std::min(m_height, (band + 1) * kBandRows));
+    });
+
+    m_rasterMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& box) const {
+    const XMMATRIX vp = XMLoadFloat4x4(&m_viewProj);
+    XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+    box.GetCorners(corners);
+
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+    for (const XMFLOAT3& corner : corners) {
+        XMFLOAT4 c;
+        XMStoreFloat4(&c, XMVector3Transform(XMLoadFloat3(&corner), vp));
+        if (c.z < 0.f || c.w <= 1e-6f) return true;
+        const float invW = 1.f / c.w;
+        const float x = (c.x * invW + 1.f) * 0.5f * float(m_width);
+        const float y = (1.f - c.y * invW) * 0.5f * float(m_height);
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+        minZ = std::min(minZ, c.z * invW);
+    }
+
+    // Every pixel the box may touch, including partially covered ones.
+    const int32_t x0 = std::max(0, int32_t(std::floor(minX)));
+    const int32_t x1 = std::min(int32_t(m_width), int32_t(std::ceil(maxX)));
+    const int32_t y0 = std::max(0, int32_t(std::floor(minY)));
+    const int32_t y1 = std::min(int32_t(m_height), int32_t(std::ceil(maxY)));
+    if (x0 >= x1 || y0 >= y1) return true;
+
+    const int32_t tx0 = x0 / int32_t(kTileWidth), tx1 = (x1 - 1) / int32_t(kTileWidth);
+    const int32_t ty0 = y0 / int32_t(kTileHeight), ty1 = (y1 - 1) / int32_t(kTileHeight);
+    for (int32_t ty = ty0; ty <= ty1; ++ty) {
+        for (int32_t tx = tx0; tx <= tx1; ++tx) {
+            // The box is behind everything drawn in this tile.
+            if (m_tileMaxDepth[size_t(ty) * m_tilesX + tx] < minZ) continue;
+
+            const int32_t px0 = std::max(x0, tx * int32_t(kTileWidth));
+            const int32_t px1 = std::min(x1, (tx + 1) * int32_t(kTileWidth));
+            const int32_t py0 = std::max(y0, ty * int32_t(kTileHeight));
+            const int32_t py1 = std::min(y1, (ty + 1) * int32_t(kTileHeight));
+            for (int32_t y = py0; y < py1; ++y) {
+                const float* row = m_depth.data() + size_t(y) * m_width;
+                for (int32_t x = px0; x < px1; ++x)
+                    if (row[x] >= minZ) return true;
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionCuller::Test(const BoundingBox* boxes, size_t count, uint8_t* visible) const {
+    JobSystem::I().ParallelFor(uint32_t(count), 64, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) visible[i] = IsVisible(boxes[i]) ? 1 : 0;
+    });
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+/**
+ * @class OcclusionCuller
+ * @brief Low-resolution CPU depth buffer used to reject objects hidden behind occluders.
+ * Occluder triangles are rasterized four pixels at a time into a small depth buffer,
+ * split into horizontal bands shared between the job system threads. Each tile of
+ * kTileWidth x kTileHeight pixels then keeps its farthest depth, so testing a box
+ * usually only needs one comparison per tile it covers.
+ * Depth follows the D3D convention: 0 at the near plane, 1 at the far plane.
+ */
+class OcclusionCuller
+{
+public:
+    static constexpr uint32_t kTileWidth = 8;
+    static constexpr uint32_t kTileHeight = 4;
+
+    /**
+     * @brief Sets the size of the depth buffer.
+     * Sizes are rounded up to whole tiles.
+     * @param width The width in pixels.
+     * @param height The height in pixels.
+     */
+    void SetResolution(uint32_t width, uint32_t height);
+
+    /**
+     * @brief Clears the depth buffer and the occluder list for a new frame.
+     * @param viewProj The camera view-projection matrix, with row vectors as in DirectXMath.
+     */
+    void BeginFrame(DirectX::FXMMATRIX viewProj);
+
+    /**
+     * @brief Queues an occluder for rasterization.
+     * The geometry is only read by Rasterize, so it must stay alive until then.
+     * @param positions The first vertex position.
+     * @param stride The distance in bytes between two positions.
+     * @param indices The triangle list indices.
+     * @param indexCount The number of indices.
+     * @param world The object-to-world matrix.
+     */
+    void AddOccluder(const DirectX::XMFLOAT3* positions, size_t stride,
+        const uint32_t* indices, size_t indexCount, DirectX::FXMMATRIX world);
+
+    /**
+     * @brief Rasterizes the queued occluders and builds the per-tile depth.
+     */
+    void Rasterize();
+
+    /**
+     * @brief Tests whether a box may be visible past the occluders.
+     * Boxes crossing the near plane or outside the screen are reported visible; the
+     * frustum test is in charge of the latter.
+     * @param box The world-space box.
+     * @return False if the box is completely hidden.
+     */
+    bool IsVisible(const DirectX::BoundingBox& box) const;
+
+    /**
+     * @brief Tests an array of boxes on the job system threads.
+     * @param boxes The world-space boxes.
+     * @param count The number of boxes.
+     * @param visible Receives one result per box, 0 for hidden boxes.
+     */
+    void Test(const DirectX::BoundingBox* boxes, size_t count, uint8_t* visible) const;
+
+    /**
+     * @brief Gets the number of occluder triangles rasterized in the last frame.
+     * @return The triangle count, after clipping.
+     */
+    uint32_t TriangleCount() const { return m_triangleCount; }
+
+    /**
+     * @brief Gets the time spent in the last Rasterize call.
+     * @return The time in milliseconds.
+     */
+    float RasterMs() const { return m_rasterMs; }
+
+    /**
+     * @brief Gets the width of the depth buffer.
+     * @return The width in pixels.
+     */
+    uint32_t Width() const { return m_width; }
+
+    /**
+     * @brief Gets the height of the depth buffer.
+     * @return The height in pixels.
+     */
+    uint32_t Height() const { return m_height; }
+
+    /**
+     * @brief Gets the depth buffer, row by row, for debugging.
+     * @return The depths, Width() * Height() values.
+     */
+    const float* Depth() const { return m_depth.data(); }
+
+private:
+    struct Occluder {
+        const DirectX::XMFLOAT3* positions;
+        size_t stride;
+        const uint32_t* indices;
+        size_t indexCount;
+        DirectX::XMFLOAT4X4 worldViewProj;
+    };
+
+    /** Screen-space triangle, already clipped to the near plane. */
+    struct ScreenTri {
+        float x[3], y[3], z[3];
+        int32_t minY, maxY;
+    };
+
+    void SetupTriangles(const Occluder& occluder, std::vector<ScreenTri>& out) const;
+    void RasterizeBand(uint32_t rowBegin, uint32_t rowEnd);
+
+    uint32_t m_width = 256;
+    uint32_t m_height = 128;
+    uint32_t m_tilesX = 256 / kTileWidth;
+    uint32_t m_tilesY = 128 / kTileHeight;
+
+    DirectX::XMFLOAT4X4 m_viewProj{};
+    std::vector<float> m_depth;
+    std::vector<float> m_tileMaxDepth;
+
+    std::vector<Occluder> m_occluders;
+    std::vector<std::vector<ScreenTri>> m_triangles;
+    uint32_t m_triangleCount = 0;
+    float m_rasterMs = 0.f;
+};
@@ -17,6 +17,9 @@ cbuffer Scene : register(b0)
 
     float3 uKe;
     float _pad1;
+
+    float3 uTint;
+    float uFade;
 };
 
 Texture2D uTexture : register(t0);
@@ -87,6 +90,7 @@ struct VSOut
     float4 shadowPos : TEXCOORD3;
     float3 tangent : TEXCOORD4;
     float3 bitangent : TEXCOORD5;
+    nointerpolation float fade : TEXCOORD6;
 };
 
 float Hash12(float2 p)
@@ -164,8 +168,24 @@ float ComputeShadow(float4 shadowPos, float3 normal, float4 screenPos)
 
 #define DEBUG_MODE DEBUG_NODEBUG
 
+// 4x4 ordered dither, used to fade out objects about to be dropped for their screen size.
+static const float kBayer4x4[16] =
+{
+    0.0f, 8.0f, 2.0f, 10.0f,
+    12.0f, 4.0f, 14.0f, 6.0f,
+    3.0f, 11.0f, 1.0f, 9.0f,
+    15.0f, 7.0f, 13.0f, 5.0f
+};
+
 float4 main(VSOut i) : SV_Target
 {
+    if (i.fade < 1.0f)
+    {
+        uint2 p = uint2(i.pos.xy) & 3;
+        if ((kBayer4x4[p.y * 4 + p.x] + 0.5f) / 16.0f >= i.fade)
+            discard;
+    }
+
     float3 Ng = normalize(i.nrm);
     float3 N = Ng;
 
@@ -0,0 +1,235 @@
+#include "RenderScene.h"
+#include "Mesh.h"
+
+using namespace DirectX;
+
+namespace {
+    inline uint64_t PointerKey(const void* p) {
+        uint64_t x = uint64_t(reinterpret_cast<uintptr_t>(p));
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        return x;
+    }
+}
+
+SceneLink::~SceneLink() {
+    if (m_scene) m_scene->RemoveById(m_id);
+}
+
+void SceneLink::MarkDirty() {
+    if (m_scene) m_scene->MarkDirty(m_id);
+}
+
+RenderScene::~RenderScene() {
+    for (RenderProxy& proxy : m_proxies) {
+        if (proxy.alive && proxy.retained) proxy.mesh->m_sceneLink.m_scene = nullptr;
+    }
+}
+
+uint32_t RenderScene::AllocateProxy(Mesh& mesh, bool retained) {
+    uint32_t id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else {
+        id = uint32_t(m_proxies.size());
+        m_proxies.emplace_back();
+    }
+    RenderProxy& proxy = m_proxies[id];
+    proxy = RenderProxy{};
+    proxy.mesh = &mesh;
+    proxy.alive = true;
+    proxy.retained = retained;
+    ++m_layoutVersion;
+    MarkDirty(id);
+    return id;
+}
+
+void RenderScene::FreeProxy(uint32_t id) {
+    RenderProxy& proxy = m_proxies[id];
+    if (proxy.treeId != DynamicAABBTree::kNullNode) m_tree.DestroyProxy(proxy.treeId);
+    proxy = RenderProxy{};
+    m_freeIds.push_back(id);
+    ++m_layoutVersion;
+}
+
+void RenderScene::Add(Mesh& mesh) {
+    if (mesh.m_sceneLink.m_scene) return;
+
+    // A mesh already drawn in immediate mode takes over its transient proxy.
+    uint32_t id;
+    auto it = m_transient.find(&mesh);
+    if (it != m_transient.end()) {
+        id = it->second;
+        m_transient.erase(it);
+        m_proxies[id].retained = true;
+        MarkDirty(id);
+    }
+    else {
+        id = AllocateProxy(mesh, true);
+    }
+    mesh.m_sceneLink.m_scene = this;
+    mesh.m_sceneLink.m_id = id;
+
+    RenderProxy& proxy = m_proxies[id];
+    proxy.isStatic = mesh.IsBatched();
+    AddToList(proxy, id);
+}
+
+void RenderScene::Remove(Mesh& mesh) {
+    if (mesh.m_sceneLink.m_scene != this) return;
+    RemoveById(mesh.m_sceneLink.m_id);
+}
+
+void RenderScene::RemoveById(uint32_t id) {
+    RenderProxy& proxy = m_proxies[id];
+    if (!proxy.alive) return;
+    if (proxy.mesh) {
+        proxy.mesh->m_sceneLink.m_scene = nullptr;
+        proxy.mesh->m_sceneLink.m_id = 0;
+    }
+    RemoveFromList(proxy);
+    FreeProxy(id);
+}
+
+uint32_t RenderScene::IdOf(const Mesh& mesh) const {
+    return mesh.m_sceneLink.m_id;
+}
+
+uint32_t RenderScene::Track(Mesh& mesh, uint64_t frame, bool& first, bool batch) {
+    auto [it, inserted] = m_transient.try_emplace(&mesh, 0u);
+    if (inserted) it->second = AllocateProxy(mesh, false);
+
+    RenderProxy& proxy = m_proxies[it->second];
+    if (proxy.batch != batch) {
+        proxy.batch = batch;
+        ++m_layoutVersion;
+    }
+    first = proxy.frame != frame;
+    if (first) {
+        proxy.frame = frame;
+        ++m_trackedThisFrame;
+        // Becoming static does not change the version, but moves the proxy out of the tree.
+        if (proxy.version != mesh.Version() || proxy.isStatic != mesh.IsBatched()) MarkDirty(it->second);
+    }
+    return it->second;
+}
+
+void RenderScene::MarkDirty(uint32_t id) {
+    RenderProxy& proxy = m_proxies[id];
+    if (proxy.dirty || !proxy.alive) return;
+    proxy.dirty = true;
+    m_dirty.push_back(id);
+}
+
+void RenderScene::Update(uint64_t frame) {
+    // Transient proxies are matched by address, so one that was not drawn this frame may
+    // belong to a mesh that no longer exists.
+    if (m_transient.size() > m_trackedThisFrame) {
+        for (auto it = m_transient.begin(); it != m_transient.end();) {
+            if (m_proxies[it->second].frame != frame) {
+                FreeProxy(it->second);
+                it = m_transient.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    m_trackedThisFrame = 0;
+
+    Flush();
+    m_frameUpdated = m_updatedCount;
+    m_updatedCount = 0;
+    m_frameRefreshed.swap(m_refreshed);
+    m_refreshed.clear();
+}
+
+void RenderScene::Flush() {
+    // Build every pending transform first, so several changes to a mesh during the frame
+    // cost a single rebuild and the loop below only copies the results.
+    m_resolve.clear();
+    for (uint32_t id : m_dirty) {
+        if (m_proxies[id].alive) m_resolve.push_back(m_proxies[id].mesh);
+    }
+    Mesh::ResolveTransforms(m_resolve.data(), m_resolve.size());
+
+    for (uint32_t id : m_dirty) {
+        if (!m_proxies[id].alive || !m_proxies[id].dirty) continue;
+        Refresh(id);
+        ++m_updatedCount;
+    }
+    m_dirty.clear();
+}
+
+void RenderScene::Refresh(uint32_t id) {
+    RenderProxy& proxy = m_proxies[id];
+    const Mesh& mesh = *proxy.mesh;
+    proxy.dirty = false;
+
+    const XMVECTOR oldCenter = XMLoadFloat3(&proxy.bounds.Center);
+    proxy.bounds = mesh.WorldBounds();
+    proxy.sphere = mesh.WorldSphere();
+
+    XMStoreFloat4x4(&proxy.model, XMMatrixTranspose(mesh.Transform()));
+    XMStoreFloat4x4(&proxy.normalMatrix, mesh.InverseTransform());
+    proxy.tint = mesh.Tint();
+    proxy.shininess = mesh.ShininessOverride();
+    proxy.materialKey = PointerKey(mesh.GetAsset()) ^ (PointerKey(mesh.GetTexture()) << 1);
+    proxy.version = mesh.Version();
+    proxy.cull[0].valid = proxy.cull[1].valid = false;
+    m_refreshed.push_back(id);
+
+    if (proxy.isStatic != mesh.IsBatched()) {
+        RemoveFromList(proxy);
+        proxy.isStatic = mesh.IsBatched();
+        if (proxy.retained) AddToList(proxy, id);
+    }
+
+    // Batched meshes are drawn through their batches, which have their own proxies.
+    const bool inTree = !proxy.isStatic;
+    if (!inTree) {
+        if (proxy.treeId != DynamicAABBTree::kNullNode) {
+            m_tree.DestroyProxy(proxy.treeId);
+            proxy.treeId = DynamicAABBTree::kNullNode;
+        }
+    }
+    else if (proxy.treeId == DynamicAABBTree::kNullNode) {
+        proxy.treeId = m_tree.CreateProxy(proxy.bounds, reinterpret_cast<void*>(uintptr_t(id)));
+    }
+    else {
+        m_tree.MoveProxy(proxy.treeId, proxy.bounds, XMVectorSubtract(XMLoadFloat3(&proxy.bounds.Center), oldCenter));
+    }
+}
+
+void RenderScene::AddToList(RenderProxy& proxy, uint32_t id) {
+    if (proxy.isStatic) {
+        proxy.listIndex = uint32_t(m_static.size());
+        m_static.push_back(proxy.mesh);
+        m_staticIds.push_back(id);
+    }
+    else {
+        proxy.listIndex = uint32_t(m_dynamic.size());
+        m_dynamic.push_back(proxy.mesh);
+        m_dynamicIds.push_back(id);
+    }
+}
+
+void RenderScene::RemoveFromList(RenderProxy& proxy) {
+    if (!proxy.retained || proxy.listIndex == UINT32_MAX) return;
+
+    // Swap with the last entry so removal does not shift the list.
+    auto removeAt = [&](auto& meshes, std::vector<uint32_t>& ids) {
+        const uint32_t index = proxy.listIndex;
+        meshes[index] = meshes.back();
+        ids[index] = ids.back();
+        m_proxies[ids[index]].listIndex = index;
+        meshes.pop_back();
+        ids.pop_back();
+    };
+    if (proxy.isStatic) removeAt(m_static, m_staticIds);
+    else removeAt(m_dynamic, m_dynamicIds);
+    proxy.listIndex = UINT32_MAX;
+}
@@ -0,0 +1,259 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "DynamicAABBTree.h"
+
+class Mesh;
+class RenderScene;
+
+/**
+ * @struct RenderProxy
+ * @brief What the renderer keeps about a mesh between frames.
+ * Everything here is derived from the mesh and only recomputed when the mesh changes.
+ */
+struct RenderProxy
+{
+    Mesh* mesh = nullptr;
+
+    DirectX::BoundingBox bounds{};
+    DirectX::BoundingSphere sphere{};
+
+    /** Model matrix and inverse model matrix, transposed for the constant buffer. */
+    DirectX::XMFLOAT4X4 model{};
+    DirectX::XMFLOAT4X4 normalMatrix{};
+    DirectX::XMFLOAT3 tint{ 1.f, 1.f, 1.f };
+    /** Shininess of the mesh, or a negative value to use the materials' own. */
+    float shininess = -1.f;
+
+    /** Equal for proxies sharing the same geometry and texture. */
+    uint64_t materialKey = 0;
+
+    /** Mesh::Version() when the proxy was last refreshed. */
+    uint64_t version = 0;
+    /** Last frame a transient proxy was drawn. */
+    uint64_t frame = 0;
+
+    int32_t treeId = DynamicAABBTree::kNullNode;
+    /** Position in the draw list of the current frame. */
+    uint32_t drawIndex = 0;
+    /** Position in the retained static or dynamic list. */
+    uint32_t listIndex = UINT32_MAX;
+
+    bool alive = false;
+    bool retained = false;
+    /** A merged static batch; scene queries use its source meshes instead. */
+    bool batch = false;
+    /** Drawn through the static batches; see Mesh::IsBatched. */
+    bool isStatic = false;
+    bool dirty = false;
+    bool droppedInMain = false;
+    bool droppedInShadow = false;
+
+    /** Level of detail drawn in the previous frame, per pass. */
+    uint8_t lod = 0;
+    uint8_t shadowLod = 0;
+
+    /** Last frustum test, for the main pass and the shadow pass; dropped on refresh. */
+    CullCache cull[2];
+};
+
+/**
+ * @class SceneLink
+ * @brief Registration of a mesh in a RenderScene, held by the mesh.
+ * A copy of a mesh is a new object and starts unregistered; assigning to a registered mesh
+ * keeps its registration and flags it as changed. Destroying the mesh unregisters it.
+ */
+class SceneLink
+{
+public:
+    SceneLink() = default;
+    SceneLink(const SceneLink&) {}
+    SceneLink(SceneLink&&) noexcept {}
+    SceneLink& operator=(const SceneLink&) { MarkDirty(); return *this; }
+    SceneLink& operator=(SceneLink&&) noexcept { MarkDirty(); return *this; }
+    ~SceneLink();
+
+    /**
+     * @brief Tells the scene the mesh changed.
+     */
+    void MarkDirty();
+
+    /**
+     * @brief Checks whether the mesh is registered in a scene.
+     * @return True if registered.
+     */
+    bool IsLinked() const { return m_scene != nullptr; }
+
+    /**
+     * @brief Gets the proxy id of the mesh in its scene.
+     * @return The proxy id, only meaningful while linked.
+     */
+    uint32_t Id() const { return m_id; }
+
+private:
+    friend class RenderScene;
+    RenderScene* m_scene = nullptr;
+    uint32_t m_id = 0;
+};
+
+/**
+ * @class RenderScene
+ * @brief Persistent set of render proxies.
+ * Retained meshes are added once and drawn every frame until removed; a mesh flags its
+ * proxy as dirty whenever it changes, and only dirty proxies are refreshed. Meshes
+ * submitted with WindowDX12::Draw get transient proxies, matched by address and dropped
+ * after a frame without a Draw call.
+ * Batched meshes are handed to the static batcher and are not in the tree.
+ */
+class RenderScene
+{
+public:
+    RenderScene() = default;
+    RenderScene(const RenderScene&) = delete;
+    RenderScene& operator=(const RenderScene&) = delete;
+    ~RenderScene();
+
+    /**
+     * @brief Adds a mesh to the scene. The mesh must keep its address while registered.
+     * @param mesh The mesh to add; does nothing if it is already in a scene.
+     */
+    void Add(Mesh& mesh);
+
+    /**
+     * @brief Removes a mesh from the scene.
+     * @param mesh The mesh to remove; does nothing if it is not in this scene.
+     */
+    void Remove(Mesh& mesh);
+
+    /**
+     * @brief Gets the proxy id of a mesh added with Add.
+     * @param mesh A mesh in this scene.
+     * @return The proxy id.
+     */
+    uint32_t IdOf(const Mesh& mesh) const;
+
+    /**
+     * @brief Gets the proxy of a mesh drawn in immediate mode this frame, creating it if needed.
+     * @param mesh The mesh.
+     * @param frame The current frame number.
+     * @param first Receives false if the mesh was already tracked this frame.
+     * @param batch True if the mesh is a static batch built by the renderer.
+     * @return The proxy id.
+     */
+    uint32_t Track(Mesh& mesh, uint64_t frame, bool& first, bool batch = false);
+
+    /**
+     * @brief Flags a proxy for refresh at the next Update.
+     * @param id The proxy id.
+     */
+    void MarkDirty(uint32_t id);
+
+    /**
+     * @brief Refreshes the dirty proxies.
+     * Call it before reading the retained lists, so meshes that became static or dynamic
+     * are already in the right one.
+     */
+    void Flush();
+
+    /**
+     * @brief Drops the transient proxies not tracked this frame and refreshes the dirty ones.
+     * @param frame The current frame number.
+     */
+    void Update(uint64_t frame);
+
+    /**
+     * @brief Gets a proxy.
+     * @param id The proxy id.
+     * @return The proxy.
+     */
+    RenderProxy& Proxy(uint32_t id) { return m_proxies[id]; }
+    const RenderProxy& Proxy(uint32_t id) const { return m_proxies[id]; }
+
+    /**
+     * @brief Gets the proxy id stored in a tree leaf.
+     * @param leaf The tree proxy id.
+     * @return The render proxy id.
+     */
+    uint32_t FromTree(int32_t leaf) const { return uint32_t(reinterpret_cast<uintptr_t>(m_tree.GetUserData(leaf))); }
+
+    /**
+     * @brief Gets the bounding volume tree over the non-static proxies.
+     * @return The tree.
+     */
+    const DynamicAABBTree& Tree() const { return m_tree; }
+
+    /**
+     * @brief Gets the retained meshes that are not static.
+     * @return The meshes.
+     */
+    const std::vector<Mesh*>& RetainedDynamic() const { return m_dynamic; }
+
+    /**
+     * @brief Gets the retained static meshes.
+     * @return The meshes.
+     */
+    const std::vector<const Mesh*>& RetainedStatic() const { return m_static; }
+
+    /**
+     * @brief Gets the bound of the proxy ids; ids of live proxies are below it.
+     * @return One past the largest id handed out.
+     */
+    uint32_t IdCount() const { return uint32_t(m_proxies.size()); }
+
+    /**
+     * @brief Gets a counter that changes whenever a proxy is created or removed.
+     * @return The layout version.
+     */
+    uint64_t LayoutVersion() const { return m_layoutVersion; }
+
+    /**
+     * @brief Gets the proxies refreshed during the last frame, in the order they were refreshed.
+     * Structures built over the proxies only need to revisit these.
+     * @return The proxy ids; an id may appear twice.
+     */
+    const std::vector<uint32_t>& RefreshedIds() const { return m_frameRefreshed; }
+
+    /**
+     * @brief Gets the number of live proxies.
+     * @return The proxy count.
+     */
+    uint32_t ProxyCount() const { return uint32_t(m_proxies.size() - m_freeIds.size()); }
+
+    /**
+     * @brief Gets the number of proxies refreshed during the last frame.
+     * @return The refreshed count.
+     */
+    uint32_t UpdatedCount() const { return m_frameUpdated; }
+
+private:
+    friend class SceneLink;
+
+    uint32_t AllocateProxy(Mesh& mesh, bool retained);
+    void FreeProxy(uint32_t id);
+    void RemoveById(uint32_t id);
+    void Refresh(uint32_t id);
+    void AddToList(RenderProxy& proxy, uint32_t id);
+    void RemoveFromList(RenderProxy& proxy);
+
+    std::vector<RenderProxy> m_proxies;
+    std::vector<uint32_t> m_freeIds;
+    std::vector<uint32_t> m_dirty;
+    std::vector<const Mesh*> m_resolve;
+    std::unordered_map<const Mesh*, uint32_t> m_transient;
+    uint32_t m_trackedThisFrame = 0;
+    uint32_t m_updatedCount = 0;
+    uint32_t m_frameUpdated = 0;
+    std::vector<uint32_t> m_refreshed;
+    std::vector<uint32_t> m_frameRefreshed;
+    uint64_t m_layoutVersion = 0;
+
+    std::vector<Mesh*> m_dynamic;
+    std::vector<uint32_t> m_dynamicIds;
+    std::vector<const Mesh*> m_static;
+    std::vector<uint32_t> m_staticIds;
+
+    DynamicAABBTree m_tree;
+};
@@ -1,7 +1,8 @@
 #include "Renderer.h"
 #include "WindowDX12.h"
 
-void Renderer::DrawMesh(const Mesh& mesh,
+void Renderer::DrawMesh(CommandContext& ctx,
+    const MeshAsset& mesh,
     D3D12_GPU_VIRTUAL_ADDRESS cbAddr,
     D3D12_GPU_DESCRIPTOR_HANDLE texHandle,
     D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle,
@@ -9,22 +10,26 @@ void Renderer::DrawMesh(const Mesh& mesh,
     D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle
 )
 {
-    ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+    ID3D12GraphicsCommandList* cmd = ctx.Get();
+    auto& state = ctx.State();
 
-    cmd->SetGraphicsRootConstantBufferView(0, cbAddr);
-    cmd->SetGraphicsRootDescriptorTable(1, texHandle);
-    cmd->SetGraphicsRootDescriptorTable(2, shadowHandle);
-    cmd->SetGraphicsRootDescriptorTable(3, normalHandle);
-    cmd->SetGraphicsRootDescriptorTable(4, metalRoughHandle);
+    state.SetRootConstantBufferView(cmd, 0, cbAddr);
+    state.SetRootDescriptorTable(cmd, 1, texHandle);
+    state.SetRootDescriptorTable(cmd, 2, shadowHandle);
+    state.SetRootDescriptorTable(cmd, 3, normalHandle);
+    state.SetRootDescriptorTable(cmd, 4, metalRoughHandle);
 
-    cmd->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    cmd->IASetVertexBuffers(0, 1, &mesh.VBV());
-    cmd->IASetIndexBuffer(&mesh.IBV());
-    cmd->DrawIndexedInstanced(mesh.IndexCount(), 1, 0, 0, 0);
+    state.SetPrimitiveTopology(cmd, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (state.SetVertexBuffer(cmd, mesh.vbv)) ctx.KeepAlive(mesh.vb.Get());
+    if (state.SetIndexBuffer(cmd, mesh.ibv)) ctx.KeepAlive(mesh.ib.Get());
+    cmd->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0, 0);
 }
 
-void Renderer::DrawMeshRange(const Mesh& mesh,
+void Renderer::DrawMeshInstanced(CommandContext& ctx,
+    const MeshAsset& mesh,
     D3D12_GPU_VIRTUAL_ADDRESS cbAddr,
+    D3D12_GPU_VIRTUAL_ADDRESS instanceAddr,
+    UINT instanceCount,
     D3D12_GPU_DESCRIPTOR_HANDLE texHandle,
     D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle,
 	D3D12_GPU_DESCRIPTOR_HANDLE normalHandle,
@@ -32,16 +37,18 @@ void Renderer::DrawMeshRange(const Mesh& mesh,
     UINT indexStart,
     UINT indexCount)
 {
-    ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+    ID3D12GraphicsCommandList* cmd = ctx.Get();
+    auto& state = ctx.State();
 
-    cmd->SetGraphicsRootConstantBufferView(0, cbAddr);
-    cmd->SetGraphicsRootDescriptorTable(1, texHandle);
-    cmd->SetGraphicsRootDescriptorTable(2, shadowHandle);
-    cmd->SetGraphicsRootDescriptorTable(3, normalHandle);
-    cmd->SetGraphicsRootDescriptorTable(4, metalRoughHandle);
+    state.SetRootConstantBufferView(cmd, 0, cbAddr);
+    state.SetRootDescriptorTable(cmd, 1, texHandle);
+    state.SetRootDescriptorTable(cmd, 2, shadowHandle);
+    state.SetRootDescriptorTable(cmd, 3, normalHandle);
+    state.SetRootDescriptorTable(cmd, 4, metalRoughHandle);
+    state.SetRootShaderResourceView(cmd, 5, instanceAddr);
 
-    cmd->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    cmd->IASetVertexBuffers(0, 1, &mesh.VBV());
-    cmd->IASetIndexBuffer(&mesh.IBV());
-    cmd->DrawIndexedInstanced(indexCount, 1, indexStart, 0, 0);
+    state.SetPrimitiveTopology(cmd, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (state.SetVertexBuffer(cmd, mesh.vbv)) ctx.KeepAlive(mesh.vb.Get());
+    if (state.SetIndexBuffer(cmd, mesh.ibv)) ctx.KeepAlive(mesh.ib.Get());
+    cmd->DrawIndexedInstanced(indexCount, instanceCount, indexStart, 0, 0);
 }
@@ -1,9 +1,13 @@
 ﻿#pragma once
 #include <d3d12.h>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include "GraphicsDevice.h"
 #include "SwapChain.h"
 #include "DepthBuffer.h"
 #include "CommandContext.h"
+#include "FrameFenceRing.h"
 #include "ShaderPipeline.h"
 #include "ConstantBuffer.h"
 #include "Mesh.h"
@@ -13,9 +17,18 @@
  * @class Renderer
  * @brief Manages the rendering process.
  * This class handles the setup of rendering passes, drawing meshes, and managing the frame.
+ * A frame is recorded on several command contexts, submitted in the order they are opened:
+ * serial commands go to the current context, while a pass recorded in parallel gets one
+ * context per chunk between BeginParallel and EndParallel.
+ * Up to FramesInFlight() frames are recorded ahead of the GPU: every frame uses the command
+ * allocators and per-frame buffer regions of its FrameSlot(), and the CPU only waits when the
+ * GPU has not finished the previous frame recorded in that slot.
  */
 class Renderer
 {
+    static_assert(FrameFenceRing<GraphicsDevice>::kMaxFrames >= kMaxFramesInFlight,
+        "the frame ring must cover every frame slot");
+
 public:
     /**
      * @brief Initializes the renderer.
@@ -26,7 +39,7 @@ public:
     void Initialize(GraphicsDevice& gd, SwapChain& sc, DepthBuffer& db)
     {
         m_gd = &gd; m_sc = &sc; m_db = &db;
-        m_cmd.Initialize(gd.Device());
+        m_frames.Initialize(&gd, kDefaultFramesInFlight);
         m_viewport = { 0, 0, static_cast<float>(sc.Width()), static_cast<float>(sc.Height()), 0.0f, 1.0f };
         m_scissor = { 0, 0, static_cast<LONG>(sc.Width()), static_cast<LONG>(sc.Height()) };
     }
@@ -41,13 +54,50 @@ public:
     }
 
     /**
-     * @brief Begins the shadow rendering pass.
+     * @brief Sets the number of frames the CPU may record ahead of the GPU.
+     * @param count The frame count, clamped to [1, kMaxFramesInFlight].
+     */
+    void SetFramesInFlight(UINT count)
+    {
+        m_frames.SetFrameCount(count);
+    }
+
+    /**
+     * @brief Gets the number of frames the CPU may record ahead of the GPU.
+     * @return The frame count.
+     */
+    UINT FramesInFlight() const { return m_frames.FrameCount(); }
+
+    /**
+     * @brief Gets the slot of the frame being recorded. Per-frame regions of upload buffers
+     * are indexed by it, not by the back buffer.
+     * @return The slot, under kMaxFramesInFlight.
+     */
+    UINT FrameSlot() const { return m_frames.Slot(); }
+
+    /**
+     * @brief Gets the time BeginFrame spent waiting for the GPU.
+     * @return The time in milliseconds.
+     */
+    float GpuWaitMs() const { return m_gpuWaitMs; }
+
+    /**
+     * @brief Sets the descriptor heap bound on every command context opened afterwards.
+     * @param heap The shader-visible CBV/SRV/UAV heap.
+     */
+    void SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+    {
+        m_heap = heap;
+    }
+
+    /**
+     * @brief Begins the shadow rendering pass: moves the shadow map to depth writes and clears it.
+     * Shadow casters are drawn on contexts bound with BindShadowTargets.
      * @param sm The shadow map to render to.
-     * @param pipe The shader pipeline for the shadow pass.
      */
-    void BeginShadowPass(ShadowMap& sm, const ShaderPipeline& pipe)
+    void BeginShadowPass(ShadowMap& sm)
     {
-        ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+        ID3D12GraphicsCommandList* cmd = m_cmd->Get();
 
         D3D12_RESOURCE_BARRIER b{};
         b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -58,15 +108,26 @@ public:
         b.Transition.StateAfter = D3D12_RESOURCE_STATE_DEPTH_WRITE;
         cmd->ResourceBarrier(1, &b);
 
+        cmd->ClearDepthStencilView(sm.DSV(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+    }
+
+    /**
+     * @brief Binds the shadow map and the shadow pipeline on a context.
+     * @param ctx The command context.
+     * @param sm The shadow map to render to.
+     * @param pipe The shader pipeline for the shadow pass.
+     */
+    void BindShadowTargets(CommandContext& ctx, ShadowMap& sm, const ShaderPipeline& pipe)
+    {
+        ID3D12GraphicsCommandList* cmd = ctx.Get();
+
         auto dsv = sm.DSV();
         cmd->OMSetRenderTargets(0, nullptr, FALSE, &dsv);
         cmd->RSSetViewports(1, &sm.Viewport());
         cmd->RSSetScissorRects(1, &sm.Scissor());
 
-        cmd->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-
-        cmd->SetGraphicsRootSignature(pipe.Root());
-        cmd->SetPipelineState(pipe.PSO());
+        ctx.State().SetRootSignature(cmd, pipe.Root());
+        ctx.State().SetPipelineState(cmd, pipe.PSO());
     }
 
     /**
@@ -75,7 +136,7 @@ public:
      */
     void EndShadowPass(ShadowMap& sm)
     {
-        ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+        ID3D12GraphicsCommandList* cmd = m_cmd->Get();
 
         D3D12_RESOURCE_BARRIER b{};
         b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -88,45 +149,81 @@ public:
     }
 
     /**
-     * @brief Begins a new frame.
-     * @param frameIndex The current frame index.
+     * @brief Begins a new frame, waiting for the GPU to release the resources of its slot.
      */
-    void BeginFrame(UINT frameIndex)
+    void BeginFrame()
     {
-        m_cmd.Begin(frameIndex);
+        const auto waitStart = std::chrono::steady_clock::now();
+        m_frameIndex = m_frames.BeginFrame();
+        m_gpuWaitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+        m_openCount = 0;
+        m_cmd = &OpenContext();
 
         D3D12_RESOURCE_BARRIER b{};
         b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        b.Transition.pResource = m_sc->BackBuffer(frameIndex);
+        b.Transition.pResource = m_sc->BackBuffer(m_sc->FrameIndex());
         b.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
         b.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
         b.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-        m_cmd.Get()->ResourceBarrier(1, &b);
+        m_cmd->Get()->ResourceBarrier(1, &b);
 
         auto rtv = m_sc->CurrentRTV();
         auto dsv = m_db->DSV();
-        m_cmd.Get()->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
-        m_cmd.Get()->RSSetViewports(1, &m_viewport);
-        m_cmd.Get()->RSSetScissorRects(1, &m_scissor);
+        m_cmd->Get()->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+        m_cmd->Get()->RSSetViewports(1, &m_viewport);
+        m_cmd->Get()->RSSetScissorRects(1, &m_scissor);
 
         const float clear[4]{ 0.02f, 0.1f, 0.2f, 1.0f };
-        m_cmd.Get()->ClearRenderTargetView(rtv, clear, 0, nullptr);
-        m_cmd.Get()->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+        m_cmd->Get()->ClearRenderTargetView(rtv, clear, 0, nullptr);
+        m_cmd->Get()->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-        m_cmd.Get()->SetGraphicsRootSignature(m_pipe->Root());
-        m_cmd.Get()->SetPipelineState(m_pipe->PSO());
+        m_cmd->State().SetRootSignature(m_cmd->Get(), m_pipe->Root());
+        m_cmd->State().SetPipelineState(m_cmd->Get(), m_pipe->PSO());
+    }
+
+    /**
+     * @brief Opens the contexts of a pass recorded in parallel, one per chunk.
+     * They are submitted in order, after the commands recorded so far and before the ones
+     * recorded after EndParallel. Call it from the thread driving the frame; each context
+     * can then be recorded by a different thread.
+     * @param count The number of contexts.
+     */
+    void BeginParallel(UINT count)
+    {
+        m_parallelBegin = m_openCount;
+        for (UINT i = 0; i < count; ++i)
+            OpenContext();
     }
 
     /**
-     * @brief Draws a mesh.
-     * @param mesh The mesh to draw.
+     * @brief Gets a context opened by BeginParallel.
+     * @param chunk The index of the chunk.
+     * @return The command context, with nothing bound but the descriptor heap.
+     */
+    CommandContext& ParallelContext(UINT chunk) { return *m_contexts[m_parallelBegin + chunk]; }
+
+    /**
+     * @brief Ends parallel recording. The commands that follow go to a new context,
+     * submitted after the parallel ones, with no target bound.
+     */
+    void EndParallel()
+    {
+        m_cmd = &OpenContext();
+    }
+
+    /**
+     * @brief Draws the geometry of a mesh.
+     * @param ctx The command context to record on.
+     * @param mesh The geometry to draw, e.g. the asset of the chosen level of detail.
      * @param cbAddr The GPU virtual address of the constant buffer.
      * @param texHandle The GPU descriptor handle for the texture.
      * @param shadowHandle The GPU descriptor handle for the shadow map.
      * @param normalHandle The GPU descriptor handle for the normal map.
      * @param metalRoughHandle The GPU descriptor handle for the metallic-roughness map.
      */
-    void DrawMesh(const Mesh& mesh,
+    void DrawMesh(CommandContext& ctx,
+        const MeshAsset& mesh,
         D3D12_GPU_VIRTUAL_ADDRESS cbAddr,
         D3D12_GPU_DESCRIPTOR_HANDLE texHandle,
         D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle,
@@ -135,9 +232,12 @@ public:
     );
 
     /**
-     * @brief Draws a range of indices from a mesh.
-     * @param mesh The mesh to draw.
+     * @brief Draws a range of indices from the geometry of a mesh once per instance.
+     * @param ctx The command context to record on.
+     * @param mesh The geometry to draw.
      * @param cbAddr The GPU virtual address of the constant buffer.
+     * @param instanceAddr The GPU virtual address of the first instance; see InstanceBuffer.
+     * @param instanceCount The number of instances.
      * @param texHandle The GPU descriptor handle for the texture.
      * @param shadowHandle The GPU descriptor handle for the shadow map.
      * @param normalHandle The GPU descriptor handle for the normal map.
@@ -145,8 +245,11 @@ public:
      * @param indexStart The starting index.
      * @param indexCount The number of indices to draw.
      */
-    void DrawMeshRange(const Mesh& mesh,
+    void DrawMeshInstanced(CommandContext& ctx,
+        const MeshAsset& mesh,
         D3D12_GPU_VIRTUAL_ADDRESS cbAddr,
+        D3D12_GPU_VIRTUAL_ADDRESS instanceAddr,
+        UINT instanceCount,
         D3D12_GPU_DESCRIPTOR_HANDLE texHandle,
         D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle,
         D3D12_GPU_DESCRIPTOR_HANDLE normalHandle,
@@ -156,50 +259,66 @@ public:
     );
 
     /**
-     * @brief Draws a mesh to the shadow map.
-     * @param mesh The mesh to draw.
+     * @brief Draws the geometry of a mesh to the shadow map.
+     * @param ctx The command context to record on, bound with BindShadowTargets.
+     * @param mesh The geometry to draw.
      * @param cbAddr The GPU virtual address of the constant buffer.
      */
-    void DrawMeshShadow(const Mesh& mesh, D3D12_GPU_VIRTUAL_ADDRESS cbAddr)
+    void DrawMeshShadow(CommandContext& ctx, const MeshAsset& mesh, D3D12_GPU_VIRTUAL_ADDRESS cbAddr)
     {
-        ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+        ID3D12GraphicsCommandList* cmd = ctx.Get();
+        auto& state = ctx.State();
 
-        cmd->SetGraphicsRootConstantBufferView(0, cbAddr); // b0
+        state.SetRootConstantBufferView(cmd, 0, cbAddr); // b0
 
-        cmd->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        cmd->IASetVertexBuffers(0, 1, &mesh.VBV());
-        cmd->IASetIndexBuffer(&mesh.IBV());
-        cmd->DrawIndexedInstanced(mesh.IndexCount(), 1, 0, 0, 0);
+        state.SetPrimitiveTopology(cmd, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        if (state.SetVertexBuffer(cmd, mesh.vbv)) ctx.KeepAlive(mesh.vb.Get());
+        if (state.SetIndexBuffer(cmd, mesh.ibv)) ctx.KeepAlive(mesh.ib.Get());
+        cmd->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0, 0);
     }
 
     /**
-     * @brief Ends the current frame.
-     * @param frameIndex The current frame index.
+     * @brief Ends the current frame: submits and presents it without waiting for the GPU.
      */
-    void EndFrame(UINT frameIndex)
+    void EndFrame()
     {
         D3D12_RESOURCE_BARRIER b{};
         b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        b.Transition.pResource = m_sc->BackBuffer(frameIndex);
+        b.Transition.pResource = m_sc->BackBuffer(m_sc->FrameIndex());
         b.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
         b.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
         b.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-        m_cmd.Get()->ResourceBarrier(1, &b);
+        m_cmd->Get()->ResourceBarrier(1, &b);
 
-        m_cmd.End();
-        ID3D12CommandList* lists[]{ m_cmd.Get() };
-        m_gd->Queue()->ExecuteCommandLists(1, lists);
+        // A single submission runs the lists in the order their contexts were opened.
+        m_submit.clear();
+        for (UINT i = 0; i < m_openCount; ++i)
+        {
+            m_contexts[i]->End();
+            m_submit.push_back(m_contexts[i]->Get());
+        }
+        m_gd->Queue()->ExecuteCommandLists(static_cast<UINT>(m_submit.size()), m_submit.data());
         DXThrow(m_sc->Swap()->Present(1, 0));
-        m_gd->WaitGPU();
+        m_frames.EndFrame();
         m_sc->UpdateFrameIndex();
     }
 
     /**
-     * @brief Binds the main render targets.
+     * @brief Binds the main render targets and the current pipeline on the current context.
      */
     void BindMainRenderTargets()
     {
-        ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+        BindMainRenderTargets(*m_cmd, m_pipe);
+    }
+
+    /**
+     * @brief Binds the main render targets and a pipeline on a context.
+     * @param ctx The command context.
+     * @param pipe The shader pipeline, or nullptr to bind the targets only.
+     */
+    void BindMainRenderTargets(CommandContext& ctx, const ShaderPipeline* pipe)
+    {
+        ID3D12GraphicsCommandList* cmd = ctx.Get();
 
         auto rtv = m_sc->CurrentRTV();
         auto dsv = m_db->DSV();
@@ -208,10 +327,10 @@ public:
         cmd->RSSetViewports(1, &m_viewport);
         cmd->RSSetScissorRects(1, &m_scissor);
 
-        if (m_pipe)
+        if (pipe)
         {
-            cmd->SetGraphicsRootSignature(m_pipe->Root());
-            cmd->SetPipelineState(m_pipe->PSO());
+            ctx.State().SetRootSignature(cmd, pipe->Root());
+            ctx.State().SetPipelineState(cmd, pipe->PSO());
         }
     }
 
@@ -227,18 +346,73 @@ public:
     }
 
     /**
-     * @brief Gets the command list.
+     * @brief Gets the command list of the current context.
      * @return A pointer to the ID3D12GraphicsCommandList.
      */
-    ID3D12GraphicsCommandList* GetCommandList() { return m_cmd.Get(); }
+    ID3D12GraphicsCommandList* GetCommandList() { return m_cmd->Get(); }
+
+    /**
+     * @brief Tells the renderer that state was bound on the current command list without it,
+     * e.g. by ImGui, so the next bindings are all issued.
+     */
+    void InvalidateState() { m_cmd->State().Invalidate(); }
+
+    /**
+     * @brief Gets the state changes issued and skipped since the frame began, over all contexts.
+     * @return The statistics.
+     */
+    CommandStateCache<ID3D12GraphicsCommandList>::Stats StateStats() const
+    {
+        CommandStateCache<ID3D12GraphicsCommandList>::Stats total;
+        for (UINT i = 0; i < m_openCount; ++i)
+        {
+            total.issued += m_contexts[i]->State().GetStats().issued;
+            total.elided += m_contexts[i]->State().GetStats().elided;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Gets the number of command lists recorded since the frame began.
+     * @return The context count.
+     */
+    UINT ContextCount() const { return m_openCount; }
 
 private:
+    /**
+     * @brief Opens the next context of the frame, creating it the first time.
+     * @return The context, reset, with the descriptor heap bound.
+     */
+    CommandContext& OpenContext()
+    {
+        if (m_openCount == m_contexts.size())
+        {
+            m_contexts.push_back(std::make_unique<CommandContext>());
+            m_contexts.back()->Initialize(m_gd->Device());
+        }
+        CommandContext& ctx = *m_contexts[m_openCount++];
+        ctx.Begin(m_frameIndex);
+        if (m_heap) ctx.Get()->SetDescriptorHeaps(1, &m_heap);
+        return ctx;
+    }
+
     GraphicsDevice* m_gd = nullptr;
     SwapChain* m_sc = nullptr;
     DepthBuffer* m_db = nullptr;
     const ShaderPipeline* m_pipe = nullptr;
+    ID3D12DescriptorHeap* m_heap = nullptr;
 
-    CommandContext   m_cmd;
+    /** Contexts in submission order; the first m_openCount are recorded this frame. */
+    std::vector<std::unique_ptr<CommandContext>> m_contexts;
+    std::vector<ID3D12CommandList*> m_submit;
+    UINT             m_openCount = 0;
+    UINT             m_parallelBegin = 0;
+    /** The slot of the frame in flight being recorded. */
+    UINT             m_frameIndex = 0;
+    FrameFenceRing<GraphicsDevice> m_frames;
+    float            m_gpuWaitMs = 0.0f;
+    /** The context serial commands go to. */
+    CommandContext*  m_cmd = nullptr;
     D3D12_VIEWPORT   m_viewport{};
     D3D12_RECT       m_scissor{};
 
@@ -253,7 +253,8 @@ static void ComputeTangents(std::vector<Vertex>& verts, const std::vector<uint32
     }
 }
 
-static void LoadOBJIntoAsset(const std::string& filename, MeshAsset& out, std::shared_ptr<Texture> defaultWhite)
+static void LoadOBJIntoAsset(const std::string& filename, MeshAsset& out, std::shared_ptr<Texture> defaultWhite,
+    const MeshCleanupOptions& cleanup, MeshCleanupStats& cleanupStats)
 {
     std::ifstream file(filename);
     if (!file.is_open()) {
@@ -524,6 +525,16 @@ static void LoadOBJIntoAsset(const std::string& filename, MeshAsset& out, std::s
     if (!out.texture)
         out.texture = defaultWhite;
 
+    if (cleanup.enabled) {
+        cleanupStats = CleanupMesh(out, cleanup);
+        std::cout << "[MeshCleanup]: " << filename
+            << " welded " << cleanupStats.weldedVertices
+            << ", unused " << cleanupStats.unusedVertices
+            << ", degenerate triangles " << cleanupStats.degenerateTriangles
+            << " (" << cleanupStats.verticesBefore << " -> " << cleanupStats.verticesAfter << " vertices, "
+            << cleanupStats.trianglesBefore << " -> " << cleanupStats.trianglesAfter << " triangles)" << std::endl;
+    }
+
     const bool hasNormals = !normals.empty();
     if (!hasNormals) {
         RecomputeSmoothNormals(out.vertices, out.indices);
@@ -531,11 +542,14 @@ static void LoadOBJIntoAsset(const std::string& filename, MeshAsset& out, std::s
 
 
     ComputeTangents(out.vertices, out.indices);
-
+    out.ComputeBounds();
 }
 
 std::shared_ptr<MeshAsset> ResourceCache::getMeshFromOBJ(const std::string& path) {
     std::shared_ptr<Texture> defaultWhiteCopy;
+    MeshCleanupOptions cleanup;
+    CpuRetention retention;
+    bool buildBVH;
     {
         std::lock_guard<std::mutex> lk(mu_);
         auto it = meshCache_.find(path);
@@ -544,13 +558,20 @@ std::shared_ptr<MeshAsset> ResourceCache::getMeshFromOBJ(const std::string& path
                 return sp;
         }
         defaultWhiteCopy = defaultWhite_;
+        cleanup = cleanupOptions_;
+        retention = defaultRetention_;
+        buildBVH = buildBVHOnLoad_;
     }
 
     auto asset = std::make_shared<MeshAsset>();
-    LoadOBJIntoAsset(path, *asset, defaultWhiteCopy);
+    MeshCleanupStats stats;
+    LoadOBJIntoAsset(path, *asset, defaultWhiteCopy, cleanup, stats);
     asset->Upload(WindowDX12::Get().GetDevice());
+    if (buildBVH) asset->BuildBVH();
+    asset->ReleaseCpuGeometry(retention);
 
     std::lock_guard<std::mutex> lk(mu_);
+    cleanupTotals_ += stats;
     auto it = meshCache_.find(path);
     if (it != meshCache_.end()) {
         if (auto sp = it->second.lock())
@@ -562,3 +583,40 @@ std::shared_ptr<MeshAsset> ResourceCache::getMeshFromOBJ(const std::string& path
     }
     return asset;
 }
+
+std::shared_ptr<MeshAsset> ResourceCache::getProceduralMesh(const std::string& key, const std::function<void(MeshAsset&)>& build) {
+    std::shared_ptr<Texture> defaultWhiteCopy;
+    CpuRetention retention;
+    bool buildBVH;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        auto it = proceduralCache_.find(key);
+        if (it != proceduralCache_.end()) {
+            if (auto sp = it->second.lock())
+                return sp;
+        }
+        defaultWhiteCopy = defaultWhite_;
+        retention = defaultRetention_;
+        buildBVH = buildBVHOnLoad_;
+    }
+
+    auto asset = std::make_shared<MeshAsset>();
+    build(*asset);
+    asset->texture = defaultWhiteCopy;
+    asset->ComputeBounds();
+    asset->Upload(WindowDX12::Get().GetDevice());
+    if (buildBVH) asset->BuildBVH();
+    asset->ReleaseCpuGeometry(retention);
+
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = proceduralCache_.find(key);
+    if (it != proceduralCache_.end()) {
+        if (auto sp = it->second.lock())
+            return sp;
+        it->second = asset;
+    }
+    else {
+        proceduralCache_.emplace(key, asset);
+    }
+    return asset;
+}
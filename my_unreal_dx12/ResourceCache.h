@@ -1,9 +1,11 @@
 #pragma once
 #include <unordered_map>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
 #include "MeshAsset.h"
+#include "MeshCleanup.h"
 
 /**
  * @struct Material
@@ -41,6 +43,70 @@ public:
      */
     std::shared_ptr<MeshAsset> getMeshFromOBJ(const std::string& path);
 
+    /**
+     * @brief Gets a procedurally generated mesh.
+     * Meshes are cached by key, so identical generation parameters share one asset and one GPU upload.
+     * @param key A key that uniquely identifies the generator and its parameters.
+     * @param build Fills the vertices and indices of a new asset on a cache miss.
+     * @return A shared pointer to the uploaded mesh asset.
+     */
+    std::shared_ptr<MeshAsset> getProceduralMesh(const std::string& key, const std::function<void(MeshAsset&)>& build);
+
+    /**
+     * @brief Sets the cleanup pass applied to meshes imported from now on.
+     * @param options The cleanup options; cleanup is disabled by default.
+     */
+    void setMeshCleanup(const MeshCleanupOptions& options) {
+        std::lock_guard<std::mutex> lk(mu_);
+        cleanupOptions_ = options;
+    }
+
+    /**
+     * @brief Gets the accumulated results of every cleanup pass run so far.
+     * @return The total cleanup statistics.
+     */
+    MeshCleanupStats cleanupStats() {
+        std::lock_guard<std::mutex> lk(mu_);
+        return cleanupTotals_;
+    }
+
+    /**
+     * @brief Sets what happens to the CPU copy of meshes loaded from now on, once they are on the GPU.
+     * @param policy The retention policy; meshes keep their CPU geometry by default.
+     */
+    void setDefaultRetention(CpuRetention policy) {
+        std::lock_guard<std::mutex> lk(mu_);
+        defaultRetention_ = policy;
+    }
+
+    /**
+     * @brief Sets whether meshes loaded from now on build their ray query BVH at load time.
+     * @param enabled True to build at load; otherwise the BVH is built on the first ray query.
+     */
+    void setBuildBVHOnLoad(bool enabled) {
+        std::lock_guard<std::mutex> lk(mu_);
+        buildBVHOnLoad_ = enabled;
+    }
+
+    /**
+     * @brief Applies a retention policy to an already uploaded mesh.
+     * Must not be called while another thread reads the asset's vertices or indices.
+     * @param asset The mesh asset.
+     * @param policy The retention policy; Keep re-materializes a released CPU copy.
+     * @return The number of bytes released, or restored for Keep.
+     */
+    size_t setRetention(MeshAsset& asset, CpuRetention policy) {
+        if (policy == CpuRetention::Keep) return asset.RematerializeCpuGeometry();
+        if (asset.Retention() != policy) asset.RematerializeCpuGeometry();
+        return asset.ReleaseCpuGeometry(policy);
+    }
+
+    /**
+     * @brief Gets the system memory saved by releasing CPU geometry of meshes still alive.
+     * @return The number of bytes saved.
+     */
+    size_t cpuBytesSaved() const { return MeshAsset::CpuBytesReleased(); }
+
     /**
      * @brief Sets the default white texture.
      * @param t A shared pointer to the new default white texture.
@@ -63,5 +129,10 @@ private:
     ResourceCache() = default;
     std::mutex mu_;
     std::unordered_map<std::string, std::weak_ptr<MeshAsset>> meshCache_;
+    std::unordered_map<std::string, std::weak_ptr<MeshAsset>> proceduralCache_;
     std::shared_ptr<Texture> defaultWhite_;
+    MeshCleanupOptions cleanupOptions_;
+    MeshCleanupStats cleanupTotals_;
+    CpuRetention defaultRetention_ = CpuRetention::Keep;
+    bool buildBVHOnLoad_ = false;
 };
@@ -0,0 +1,310 @@
+#include "SceneAccel.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace {
+    constexpr int kStackSize = 64;
+
+    struct Entry { uint32_t node; float t; };
+
+    inline float DistanceToBox(FXMVECTOR p, FXMVECTOR bmin, FXMVECTOR bmax) {
+        const XMVECTOR d = XMVectorMax(XMVectorMax(XMVectorSubtract(bmin, p), XMVectorSubtract(p, bmax)), XMVectorZero());
+        return XMVectorGetX(XMVector3Length(d));
+    }
+
+    inline bool Overlaps(const XMFLOAT3& amin, const XMFLOAT3& amax, FXMVECTOR bmin, FXMVECTOR bmax) {
+        return XMVector3LessOrEqual(XMLoadFloat3(&amin), bmax) && XMVector3LessOrEqual(bmin, XMLoadFloat3(&amax));
+    }
+
+    inline void ToMinMax(const BoundingBox& b, XMFLOAT3& bmin, XMFLOAT3& bmax) {
+        const XMVECTOR c = XMLoadFloat3(&b.Center), e = XMLoadFloat3(&b.Extents);
+        XMStoreFloat3(&bmin, XMVectorSubtract(c, e));
+        XMStoreFloat3(&bmax, XMVectorAdd(c, e));
+    }
+
+    inline MeshBVH::Node InstanceNode(const XMFLOAT3& bmin, const XMFLOAT3& bmax) {
+        return { bmin, 0, bmax, 1 };
+    }
+}
+
+void SceneAccel::Update(const RenderScene& scene) {
+    m_lastRefits = 0;
+    if (scene.LayoutVersion() != m_layoutVersion) {
+        Rebuild(scene);
+        return;
+    }
+
+    // Only the proxies refreshed this frame can have moved.
+    m_changed.clear();
+    for (uint32_t id : scene.RefreshedIds()) {
+        if (id >= m_instanceOf.size() || m_instanceOf[id] == kNoInstance) continue;
+        Instance& inst = m_instances[m_instanceOf[id]];
+        ToMinMax(scene.Proxy(id).bounds, inst.bmin, inst.bmax);
+        m_changed.push_back(m_instanceOf[id]);
+    }
+    if (m_changed.empty()) return;
+
+    // Refitting keeps the topology, which degrades as objects drift apart; when most of the
+    // scene moved a rebuild costs about the same and restores the tree quality.
+    if (m_changed.size() * 2 > m_instances.size()) {
+        Rebuild(scene);
+        return;
+    }
+    Refit(m_changed);
+    m_lastRefits = m_changed.size();
+}
+
+void SceneAccel::ComputeLeafBounds(uint32_t node) {
+    MeshBVH::Node& n = m_nodes[node];
+    XMVECTOR mn = XMVectorReplicate(FLT_MAX), mx = XMVectorReplicate(-FLT_MAX);
+    for (uint32_t i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i) {
+        mn = XMVectorMin(mn, XMLoadFloat3(&m_instances[m_order[i]].bmin));
+        mx = XMVectorMax(mx, XMLoadFloat3(&m_instances[m_order[i]].bmax));
+    }
+    XMStoreFloat3(&n.bmin, mn);
+    XMStoreFloat3(&n.bmax, mx);
+}
+
+void SceneAccel::Rebuild(const RenderScene& scene) {
+    ++m_rebuilds;
+    m_layoutVersion = scene.LayoutVersion();
+    m_instances.clear();
+    m_nodes.clear();
+    m_parents.clear();
+    m_order.clear();
+    m_instanceOf.assign(scene.IdCount(), kNoInstance);
+
+    // Batches are made of meshes that have their own proxies, which is what queries report.
+    std::vector<XMFLOAT3> centroid;
+    for (uint32_t id = 0; id < scene.IdCount(); ++id) {
+        const RenderProxy& proxy = scene.Proxy(id);
+        if (!proxy.alive || proxy.batch) continue;
+        Instance inst{ proxy.mesh, {}, {}, 0 };
+        ToMinMax(proxy.bounds, inst.bmin, inst.bmax);
+        m_instanceOf[id] = uint32_t(m_instances.size());
+        centroid.push_back(proxy.bounds.Center);
+        m_instances.push_back(inst);
+    }
+    if (m_instances.empty()) return;
+
+    m_order.resize(m_instances.size());
+    for (uint32_t i = 0; i < uint32_t(m_order.size()); ++i) m_order[i] = i;
+
+    // Median split on the widest centroid axis: cheap enough to rebuild tens of thousands of
+    // instances per frame, and balanced, so queries stay logarithmic.
+    m_nodes.reserve(2 * m_instances.size());
+    m_parents.reserve(2 * m_instances.size());
+    m_nodes.push_back({ {}, 0, {}, uint32_t(m_order.size()) });
+    m_parents.push_back(kNoParent);
+
+    std::vector<uint32_t> pending{ 0 };
+    while (!pending.empty()) {
+        const uint32_t node = pending.back();
+        pending.pop_back();
+
+        const uint32_t first = m_nodes[node].leftOrFirst;
+        const uint32_t count = m_nodes[node].count;
+        if (count <= kMaxLeafSize) {
+            for (uint32_t i = first; i < first + count; ++i) m_instances[m_order[i]].leaf = node;
+            continue;
+        }
+
+        XMVECTOR cMin = XMVectorReplicate(FLT_MAX), cMax = XMVectorReplicate(-FLT_MAX);
+        for (uint32_t i = first; i < first + count; ++i) {
+            const XMVECTOR c = XMLoadFloat3(&centroid[m_order[i]]);
+            cMin = XMVectorMin(cMin, c);
+            cMax = XMVectorMax(cMax, c);
+        }
+        XMFLOAT3 extent;
+        XMStoreFloat3(&extent, XMVectorSubtract(cMax, cMin));
+        const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+        const uint32_t half = count / 2;
+        std::nth_element(m_order.begin() + first, m_order.begin() + first + half, m_order.begin() + first + count,
+            [&](uint32_t a, uint32_t b) { return (&centroid[a].x)[axis] < (&centroid[b].x)[axis]; });
+
+        const uint32_t left = uint32_t(m_nodes.size());
+        m_nodes.push_back({ {}, first, {}, half });
+        m_nodes.push_back({ {}, first + half, {}, count - half });
+        m_parents.push_back(node);
+        m_parents.push_back(node);
+        m_nodes[node].leftOrFirst = left;
+        m_nodes[node].count = 0;
+
+        pending.push_back(left);
+        pending.push_back(left + 1);
+    }
+
+    // Children always come after their parent, so a reverse sweep computes the bounds bottom-up.
+    for (uint32_t i = uint32_t(m_nodes.size()); i-- > 0;) {
+        MeshBVH::Node& n = m_nodes[i];
+        if (n.IsLeaf()) {
+            ComputeLeafBounds(i);
+            continue;
+        }
+        const MeshBVH::Node& a = m_nodes[n.leftOrFirst];
+        const MeshBVH::Node& b = m_nodes[n.leftOrFirst + 1];
+        XMStoreFloat3(&n.bmin, XMVectorMin(XMLoadFloat3(&a.bmin), XMLoadFloat3(&b.bmin)));
+        XMStoreFloat3(&n.bmax, XMVectorMax(XMLoadFloat3(&a.bmax), XMLoadFloat3(&b.bmax)));
+    }
+}
+
+void SceneAccel::Refit(const std::vector<uint32_t>& changed) {
+    for (uint32_t index : changed) {
+        const uint32_t leaf = m_instances[index].leaf;
+        ComputeLeafBounds(leaf);
+
+        for (uint32_t p = m_parents[leaf]; p != kNoParent; p = m_parents[p]) {
+            MeshBVH::Node& n = m_nodes[p];
+            const MeshBVH::Node& a = m_nodes[n.leftOrFirst];
+            const MeshBVH::Node& b = m_nodes[n.leftOrFirst + 1];
+            const XMVECTOR mn = XMVectorMin(XMLoadFloat3(&a.bmin), XMLoadFloat3(&b.bmin));
+            const XMVECTOR mx = XMVectorMax(XMLoadFloat3(&a.bmax), XMLoadFloat3(&b.bmax));
+            if (XMVector3Equal(mn, XMLoadFloat3(&n.bmin)) && XMVector3Equal(mx, XMLoadFloat3(&n.bmax)))
+                break;
+            XMStoreFloat3(&n.bmin, mn);
+            XMStoreFloat3(&n.bmax, mx);
+        }
+    }
+}
+
+bool SceneAccel::Raycast(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, SceneRayHit& hit) const {
+    if (m_nodes.empty()) return false;
+
+    const XMVECTOR invDir = MeshBVH::InverseDirection(dir);
+    float closest = maxDistance;
+    bool found = false;
+
+    Entry stack[kStackSize];
+    int sp = 0;
+    const float rootT = MeshBVH::IntersectBox(m_nodes[0], origin, invDir, closest);
+    if (rootT == FLT_MAX) return false;
+    stack[sp++] = { 0, rootT };
+
+    while (sp > 0) {
+        const Entry e = stack[--sp];
+        if (e.t >= closest) continue;
+
+        const MeshBVH::Node& n = m_nodes[e.node];
+        if (n.IsLeaf()) {
+            for (uint32_t i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i) {
+                const Instance& inst = m_instances[m_order[i]];
+                if (MeshBVH::IntersectBox(InstanceNode(inst.bmin, inst.bmax), origin, invDir, closest) == FLT_MAX) continue;
+
+                MeshRayHit meshHit;
+                if (inst.mesh->Raycast(origin, dir, closest, meshHit)) {
+                    closest = meshHit.distance;
+                    hit.mesh = inst.mesh;
+                    hit.hit = meshHit;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        uint32_t c0 = n.leftOrFirst, c1 = c0 + 1;
+        float t0 = MeshBVH::IntersectBox(m_nodes[c0], origin, invDir, closest);
+        float t1 = MeshBVH::IntersectBox(m_nodes[c1], origin, invDir, closest);
+        if (t0 > t1) { std::swap(c0, c1); std::swap(t0, t1); }
+        // The nearer child is pushed last so it is visited first.
+        if (t1 != FLT_MAX && sp < kStackSize) stack[sp++] = { c1, t1 };
+        if (t0 != FLT_MAX && sp < kStackSize) stack[sp++] = { c0, t0 };
+    }
+    return found;
+}
+
+bool SceneAccel::IsRayBlocked(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, const Mesh* ignore) const {
+    if (m_nodes.empty()) return false;
+
+    const XMVECTOR invDir = MeshBVH::InverseDirection(dir);
+    uint32_t stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        const MeshBVH::Node& n = m_nodes[stack[--sp]];
+        if (MeshBVH::IntersectBox(n, origin, invDir, maxDistance) == FLT_MAX) continue;
+
+        if (n.IsLeaf()) {
+            for (uint32_t i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i) {
+                const Instance& inst = m_instances[m_order[i]];
+                if (inst.mesh != ignore && inst.mesh->IsRayBlocked(origin, dir, maxDistance)) return true;
+            }
+            continue;
+        }
+        if (sp + 2 <= kStackSize) {
+            stack[sp++] = n.leftOrFirst + 1;
+            stack[sp++] = n.leftOrFirst;
+        }
+    }
+    return false;
+}
+
+void SceneAccel::QueryBox(const BoundingBox& box, std::vector<const Mesh*>& out) const {
+    if (m_nodes.empty()) return;
+
+    const XMVECTOR c = XMLoadFloat3(&box.Center), e = XMLoadFloat3(&box.Extents);
+    const XMVECTOR bmin = XMVectorSubtract(c, e), bmax = XMVectorAdd(c, e);
+
+    uint32_t stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        const MeshBVH::Node& n = m_nodes[stack[--sp]];
+        if (!Overlaps(n.bmin, n.bmax, bmin, bmax)) continue;
+
+        if (n.IsLeaf()) {
+            for (uint32_t i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i) {
+                const Instance& inst = m_instances[m_order[i]];
+                if (Overlaps(inst.bmin, inst.bmax, bmin, bmax)) out.push_back(inst.mesh);
+            }
+            continue;
+        }
+        if (sp + 2 <= kStackSize) {
+            stack[sp++] = n.leftOrFirst + 1;
+            stack[sp++] = n.leftOrFirst;
+        }
+    }
+}
+
+const Mesh* SceneAccel::Nearest(FXMVECTOR point, float maxDistance, float* outDistance) const {
+    if (m_nodes.empty()) return nullptr;
+
+    float best = maxDistance;
+    const Mesh* nearest = nullptr;
+
+    Entry stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = { 0, DistanceToBox(point, XMLoadFloat3(&m_nodes[0].bmin), XMLoadFloat3(&m_nodes[0].bmax)) };
+
+    while (sp > 0) {
+        const Entry e = stack[--sp];
+        if (e.t > best) continue;
+
+        const MeshBVH::Node& n = m_nodes[e.node];
+        if (n.IsLeaf()) {
+            for (uint32_t i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i) {
+                const Instance& inst = m_instances[m_order[i]];
+                const float d = DistanceToBox(point, XMLoadFloat3(&inst.bmin), XMLoadFloat3(&inst.bmax));
+                if (d <= best) {
+                    best = d;
+                    nearest = inst.mesh;
+                }
+            }
+            continue;
+        }
+
+        uint32_t c0 = n.leftOrFirst, c1 = c0 + 1;
+        float d0 = DistanceToBox(point, XMLoadFloat3(&m_nodes[c0].bmin), XMLoadFloat3(&m_nodes[c0].bmax));
+        float d1 = DistanceToBox(point, XMLoadFloat3(&m_nodes[c1].bmin), XMLoadFloat3(&m_nodes[c1].bmax));
+        if (d0 > d1) { std::swap(c0, c1); std::swap(d0, d1); }
+        if (d1 <= best && sp < kStackSize) stack[sp++] = { c1, d1 };
+        if (d0 <= best && sp < kStackSize) stack[sp++] = { c0, d0 };
+    }
+
+    if (nearest && outDistance) *outDistance = best;
+    return nearest;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "Mesh.h"
+#include "MeshBVH.h"
+#include "RenderScene.h"
+
+/**
+ * @struct SceneRayHit
+ * @brief Describes the closest mesh instance hit by a scene ray query.
+ */
+struct SceneRayHit
+{
+    const Mesh* mesh = nullptr;
+    MeshRayHit hit;
+};
+
+/**
+ * @class SceneAccel
+ * @brief Two-level acceleration structure over the mesh instances of a scene.
+ * The top level is a BVH over the world bounds of the instances; its leaves point to the
+ * meshes, whose asset BVH answers the triangle-level part of a query. The instances are the
+ * proxies of a RenderScene, static batches excepted: only the proxies the scene refreshed are
+ * refitted, with their ancestors, so a still scene costs nothing. The tree is rebuilt when
+ * proxies are added or removed, or when most of them moved.
+ */
+class SceneAccel
+{
+public:
+    /**
+     * @brief Synchronizes the structure with a render scene, after its Update.
+     * @param scene The render scene.
+     */
+    void Update(const RenderScene& scene);
+
+    /**
+     * @brief Finds the closest instance hit by a world-space ray.
+     * @param origin The ray origin.
+     * @param dir The normalized ray direction.
+     * @param maxDistance Hits farther than this are ignored.
+     * @param hit Receives the closest hit.
+     * @return True if an instance was hit.
+     */
+    bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance, SceneRayHit& hit) const;
+
+    /**
+     * @brief Checks whether any instance blocks a world-space ray.
+     * @param origin The ray origin.
+     * @param dir The normalized ray direction.
+     * @param maxDistance Only hits closer than this block the ray.
+     * @param ignore An instance to skip, typically the one casting the ray.
+     * @return True if the ray is blocked.
+     */
+    bool IsRayBlocked(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance, const Mesh* ignore = nullptr) const;
+
+    /**
+     * @brief Collects the instances whose world bounds overlap a box.
+     * @param box The world-space box.
+     * @param out Receives the overlapping instances; it is not cleared first.
+     */
+    void QueryBox(const DirectX::BoundingBox& box, std::vector<const Mesh*>& out) const;
+
+    /**
+     * @brief Finds the instance whose world bounds are closest to a point.
+     * @param point The world-space point.
+     * @param maxDistance Instances farther than this are ignored.
+     * @param outDistance Receives the distance to the bounds, zero if the point is inside.
+     * @return The closest instance, or nullptr if none is within maxDistance.
+     */
+    const Mesh* Nearest(DirectX::FXMVECTOR point, float maxDistance, float* outDistance = nullptr) const;
+
+    /**
+     * @brief Gets the number of instances.
+     * @return The instance count.
+     */
+    size_t InstanceCount() const { return m_instances.size(); }
+
+    /**
+     * @brief Gets the number of full rebuilds done so far.
+     * @return The rebuild count.
+     */
+    uint64_t RebuildCount() const { return m_rebuilds; }
+
+    /**
+     * @brief Gets the number of instances refitted during the last update.
+     * @return The refit count.
+     */
+    size_t LastRefitCount() const { return m_lastRefits; }
+
+private:
+    static constexpr uint32_t kNoParent = UINT32_MAX;
+    static constexpr uint32_t kMaxLeafSize = 2;
+    static constexpr uint32_t kNoInstance = UINT32_MAX;
+
+    struct Instance {
+        const Mesh* mesh;
+        DirectX::XMFLOAT3 bmin;
+        DirectX::XMFLOAT3 bmax;
+        uint32_t leaf;
+    };
+
+    void Rebuild(const RenderScene& scene);
+    void Refit(const std::vector<uint32_t>& changed);
+    void ComputeLeafBounds(uint32_t node);
+
+    std::vector<Instance> m_instances;
+    std::vector<MeshBVH::Node> m_nodes;
+    std::vector<uint32_t> m_parents;
+    /** Instance indices in leaf order. */
+    std::vector<uint32_t> m_order;
+    /** Instance index of each proxy id, or kNoInstance. */
+    std::vector<uint32_t> m_instanceOf;
+    std::vector<uint32_t> m_changed;
+    uint64_t m_layoutVersion = UINT64_MAX;
+
+    uint64_t m_rebuilds = 0;
+    size_t m_lastRefits = 0;
+};
@@ -64,7 +64,7 @@ public:
         ranges[3].BaseShaderRegister = 3;
         ranges[3].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
-        D3D12_ROOT_PARAMETER params[5]{};
+        D3D12_ROOT_PARAMETER params[6]{};
 
         params[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
         params[0].Descriptor.ShaderRegister = 0; // b0
@@ -91,6 +91,12 @@ public:
         params[4].DescriptorTable.pDescriptorRanges = &ranges[3];
         params[4].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+        // Instances of the draw, bound by address; see InstanceBuffer.
+        params[5].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+        params[5].Descriptor.ShaderRegister = 4; // t4
+        params[5].Descriptor.RegisterSpace = 0;
+        params[5].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
         D3D12_STATIC_SAMPLER_DESC samplers[2]{};
 
         samplers[0].Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
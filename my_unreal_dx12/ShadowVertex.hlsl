@@ -17,6 +17,9 @@ cbuffer Scene : register(b0)
 
     float3 uKe;
     float _pad1;
+
+    float3 uTint;
+    float uFade;
 };
 
 
@@ -0,0 +1,191 @@
+#pragma once
+#include <d3d12.h>
+#include <cstdint>
+
+/**
+ * @class CommandStateCache
+ * @brief Remembers the state bound on a command list and drops the calls that would bind
+ * it again.
+ * The command list type is a template parameter so the filtering can be exercised with any
+ * type exposing the same Set and IASet methods, such as a mock recording the calls.
+ * Anything binding state behind the cache's back, like ImGui or a reset of the command list,
+ * must be followed by Invalidate.
+ */
+template <typename CommandList>
+class CommandStateCache
+{
+public:
+    static constexpr UINT kMaxRootParameters = 8;
+
+    /**
+     * @struct Stats
+     * @brief Counts the state changes sent to the command list and those skipped.
+     */
+    struct Stats {
+        uint32_t issued = 0;
+        uint32_t elided = 0;
+    };
+
+    /**
+     * @brief Forgets the bound state, so every next call is issued.
+     */
+    void Invalidate()
+    {
+        m_rootSignature = nullptr;
+        m_pipelineState = nullptr;
+        m_topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+        m_vertexBuffer = {};
+        m_indexBuffer = {};
+        InvalidateRootArguments();
+    }
+
+    /**
+     * @brief Sets the graphics root signature. A new signature drops the root arguments.
+     * @param cmd The command list.
+     * @param rootSignature The root signature.
+     */
+    void SetRootSignature(CommandList* cmd, ID3D12RootSignature* rootSignature)
+    {
+        if (!Changed(m_rootSignature == rootSignature)) return;
+        m_rootSignature = rootSignature;
+        InvalidateRootArguments();
+        cmd->SetGraphicsRootSignature(rootSignature);
+    }
+
+    /**
+     * @brief Sets the pipeline state object.
+     * @param cmd The command list.
+     * @param pipelineState The pipeline state.
+     */
+    void SetPipelineState(CommandList* cmd, ID3D12PipelineState* pipelineState)
+    {
+        if (!Changed(m_pipelineState == pipelineState)) return;
+        m_pipelineState = pipelineState;
+        cmd->SetPipelineState(pipelineState);
+    }
+
+    /**
+     * @brief Sets a root constant buffer view.
+     * @param cmd The command list.
+     * @param index The root parameter index.
+     * @param address The GPU virtual address of the constants.
+     */
+    void SetRootConstantBufferView(CommandList* cmd, UINT index, D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        if (!ChangedRoot(index, address)) return;
+        cmd->SetGraphicsRootConstantBufferView(index, address);
+    }
+
+    /**
+     * @brief Sets a root shader resource view.
+     * @param cmd The command list.
+     * @param index The root parameter index.
+     * @param address The GPU virtual address of the buffer.
+     */
+    void SetRootShaderResourceView(CommandList* cmd, UINT index, D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        if (!ChangedRoot(index, address)) return;
+        cmd->SetGraphicsRootShaderResourceView(index, address);
+    }
+
+    /**
+     * @brief Sets a root descriptor table.
+     * @param cmd The command list.
+     * @param index The root parameter index.
+     * @param handle The GPU handle of the first descriptor.
+     */
+    void SetRootDescriptorTable(CommandList* cmd, UINT index, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+    {
+        if (!ChangedRoot(index, handle.ptr)) return;
+        cmd->SetGraphicsRootDescriptorTable(index, handle);
+    }
+
+    /**
+     * @brief Sets the primitive topology.
+     * @param cmd The command list.
+     * @param topology The topology.
+     */
+    void SetPrimitiveTopology(CommandList* cmd, D3D12_PRIMITIVE_TOPOLOGY topology)
+    {
+        if (!Changed(m_topology == topology)) return;
+        m_topology = topology;
+        cmd->IASetPrimitiveTopology(topology);
+    }
+
+    /**
+     * @brief Sets the vertex buffer of slot 0.
+     * @param cmd The command list.
+     * @param view The vertex buffer view.
+     * @return True if the call was issued.
+     */
+    bool SetVertexBuffer(CommandList* cmd, const D3D12_VERTEX_BUFFER_VIEW& view)
+    {
+        const bool same = m_vertexBuffer.BufferLocation == view.BufferLocation
+            && m_vertexBuffer.SizeInBytes == view.SizeInBytes
+            && m_vertexBuffer.StrideInBytes == view.StrideInBytes;
+        if (!Changed(same)) return false;
+        m_vertexBuffer = view;
+        cmd->IASetVertexBuffers(0, 1, &view);
+        return true;
+    }
+
+    /**
+     * @brief Sets the index buffer.
+     * @param cmd The command list.
+     * @param view The index buffer view.
+     * @return True if the call was issued.
+     */
+    bool SetIndexBuffer(CommandList* cmd, const D3D12_INDEX_BUFFER_VIEW& view)
+    {
+        const bool same = m_indexBuffer.BufferLocation == view.BufferLocation
+            && m_indexBuffer.SizeInBytes == view.SizeInBytes
+            && m_indexBuffer.Format == view.Format;
+        if (!Changed(same)) return false;
+        m_indexBuffer = view;
+        cmd->IASetIndexBuffer(&view);
+        return true;
+    }
+
+    /**
+     * @brief Gets the counts since the last ResetStats.
+     * @return The statistics.
+     */
+    const Stats& GetStats() const { return m_stats; }
+
+    /**
+     * @brief Restarts the counts.
+     */
+    void ResetStats() { m_stats = {}; }
+
+private:
+    static constexpr uint64_t kUnknown = ~0ull;
+
+    bool Changed(bool same)
+    {
+        ++(same ? m_stats.elided : m_stats.issued);
+        return !same;
+    }
+
+    bool ChangedRoot(UINT index, uint64_t value)
+    {
+        // Parameters past the cached range are always issued.
+        if (index >= kMaxRootParameters) return Changed(false);
+        if (!Changed(m_rootArguments[index] == value)) return false;
+        m_rootArguments[index] = value;
+        return true;
+    }
+
+    void InvalidateRootArguments()
+    {
+        for (uint64_t& argument : m_rootArguments) argument = kUnknown;
+    }
+
+    ID3D12RootSignature* m_rootSignature = nullptr;
+    ID3D12PipelineState* m_pipelineState = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY m_topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    D3D12_VERTEX_BUFFER_VIEW m_vertexBuffer{};
+    D3D12_INDEX_BUFFER_VIEW m_indexBuffer{};
+    uint64_t m_rootArguments[kMaxRootParameters] = { kUnknown, kUnknown, kUnknown, kUnknown,
+                                                     kUnknown, kUnknown, kUnknown, kUnknown };
+    Stats m_stats;
+};
@@ -0,0 +1,159 @@
+#include "StaticBatcher.h"
+#include "WindowDX12.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace {
+    // DrawScene shades meshes without submeshes with these material values.
+    constexpr float kDefaultShininess = 232.0f;
+
+    struct Batch {
+        Submesh material;
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    bool SameMaterial(const Submesh& a, const Submesh& b) {
+        return a.texture == b.texture
+            && a.normalMap == b.normalMap && a.hasNormalMap == b.hasNormalMap
+            && a.metalRoughMap == b.metalRoughMap && a.hasMetalRoughMap == b.hasMetalRoughMap
+            && a.ks.x == b.ks.x && a.ks.y == b.ks.y && a.ks.z == b.ks.z
+            && a.ke.x == b.ke.x && a.ke.y == b.ke.y && a.ke.z == b.ke.z
+            && a.shininess == b.shininess
+            && a.opacity == b.opacity;
+    }
+
+    void TransformDir(float* d, FXMMATRIX m) {
+        XMFLOAT3* f = reinterpret_cast<XMFLOAT3*>(d);
+        XMVECTOR v = XMVector3TransformNormal(XMLoadFloat3(f), m);
+        XMStoreFloat3(f, XMVector3Normalize(v));
+    }
+}
+
+bool StaticBatcher::HasChanged(const std::vector<const Mesh*>& statics) const {
+    if (statics.size() != m_sources.size()) return true;
+    for (size_t i = 0; i < statics.size(); ++i) {
+        if (statics[i] != m_sources[i].first || statics[i]->Version() != m_sources[i].second)
+            return true;
+    }
+    return false;
+}
+
+const std::vector<Mesh*>& StaticBatcher::Update(const std::vector<const Mesh*>& statics) {
+    if (HasChanged(statics))
+        Rebuild(statics);
+    return m_batchPtrs;
+}
+
+void StaticBatcher::Rebuild(const std::vector<const Mesh*>& statics) {
+    ++m_rebuilds;
+    m_sources.clear();
+    m_batches.clear();
+    m_batchPtrs.clear();
+
+    std::vector<Batch> batches;
+    std::vector<uint32_t> remap;
+    std::vector<uint32_t> remapStamp;
+    uint32_t stamp = 0;
+    std::vector<Vertex> readVertices;
+    std::vector<uint32_t> readIndices;
+
+    for (const Mesh* mesh : statics) {
+        m_sources.emplace_back(mesh, mesh->Version());
+
+        const MeshAsset* asset = mesh->GetAsset();
+        if (!asset) continue;
+
+        // Assets whose CPU copy was released are read back from their upload buffers.
+        const std::vector<Vertex>* srcVertices = &asset->vertices;
+        const std::vector<uint32_t>* srcIndices = &asset->indices;
+        if (asset->IsCpuGeometryReleased()) {
+            asset->ReadBackGeometry(readVertices, readIndices);
+            srcVertices = &readVertices;
+            srcIndices = &readIndices;
+        }
+        const std::vector<Vertex>& vertices = *srcVertices;
+        const std::vector<uint32_t>& indices = *srcIndices;
+        if (indices.empty() || vertices.empty()) continue;
+
+        const XMFLOAT3 tint = mesh->Tint();
+        const XMMATRIX M = mesh->Transform();
+        const XMMATRIX N = XMMatrixTranspose(XMMatrixInverse(nullptr, M));
+
+        std::vector<Submesh> ranges;
+        if (asset->submeshes.empty()) {
+            Submesh whole;
+            whole.indexStart = 0;
+            whole.indexCount = uint32_t(indices.size());
+            whole.shininess = mesh->ShininessOverride() >= 0.f ? mesh->ShininessOverride() : kDefaultShininess;
+            whole.texture = mesh->GetTextureShared();
+            ranges.push_back(whole);
+        }
+        else {
+            ranges = asset->submeshes;
+            for (auto& sm : ranges) {
+                if (!sm.texture) sm.texture = mesh->GetTextureShared();
+                if (mesh->ShininessOverride() >= 0.f) sm.shininess = mesh->ShininessOverride();
+            }
+        }
+
+        if (remap.size() < vertices.size()) {
+            remap.resize(vertices.size());
+            remapStamp.resize(vertices.size(), 0);
+        }
+
+        for (const Submesh& range : ranges) {
+            auto it = std::find_if(batches.begin(), batches.end(),
+                [&](const Batch& b) { return SameMaterial(b.material, range); });
+            if (it == batches.end()) {
+                batches.emplace_back();
+                batches.back().material = range;
+                it = std::prev(batches.end());
+            }
+            Batch& batch = *it;
+
+            ++stamp;
+            const uint32_t end = std::min<uint32_t>(range.indexStart + range.indexCount, uint32_t(indices.size()));
+            batch.indices.reserve(batch.indices.size() + (end - range.indexStart));
+            for (uint32_t i = range.indexStart; i < end; ++i) {
+                const uint32_t src = indices[i];
+                if (remapStamp[src] != stamp) {
+                    remapStamp[src] = stamp;
+                    remap[src] = uint32_t(batch.vertices.size());
+
+                    Vertex v = vertices[src];
+                    XMFLOAT3* p = reinterpret_cast<XMFLOAT3*>(&v.px);
+                    XMStoreFloat3(p, XMVector3TransformCoord(XMLoadFloat3(p), M));
+                    TransformDir(&v.nx, N);
+                    TransformDir(&v.tx, N);
+                    TransformDir(&v.bx, N);
+                    v.r *= tint.x; v.g *= tint.y; v.b *= tint.z;
+                    batch.vertices.push_back(v);
+                }
+                batch.indices.push_back(remap[src]);
+            }
+        }
+    }
+
+    for (auto& batch : batches) {
+        if (batch.indices.empty()) continue;
+
+        auto asset = std::make_shared<MeshAsset>();
+        asset->vertices = std::move(batch.vertices);
+        asset->indices = std::move(batch.indices);
+        asset->texture = batch.material.texture;
+        asset->shininess = batch.material.shininess;
+
+        Submesh sm = batch.material;
+        sm.indexStart = 0;
+        sm.indexCount = uint32_t(asset->indices.size());
+        asset->submeshes.push_back(sm);
+
+        asset->ComputeBounds();
+        asset->Upload(WindowDX12::Get().GetDevice());
+
+        m_batches.push_back(std::make_unique<Mesh>(asset));
+        m_batchPtrs.push_back(m_batches.back().get());
+    }
+}
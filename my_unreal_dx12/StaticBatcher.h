@@ -0,0 +1,50 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <utility>
+#include "Mesh.h"
+
+/**
+ * @class StaticBatcher
+ * @brief Merges static meshes into one pre-transformed mesh per material.
+ * Every frame the renderer hands over the static meshes it was asked to draw. As long as
+ * neither the set of meshes nor their content changes, the previously built batches are
+ * reused; otherwise the batches are rebuilt from scratch.
+ */
+class StaticBatcher
+{
+public:
+    /**
+     * @brief Updates the batches for the static meshes drawn this frame.
+     * @param statics The static meshes submitted this frame.
+     * @return The merged meshes to draw in place of the static meshes.
+     */
+    const std::vector<Mesh*>& Update(const std::vector<const Mesh*>& statics);
+
+    /**
+     * @brief Gets the number of merged batches.
+     * @return The batch count.
+     */
+    size_t BatchCount() const { return m_batchPtrs.size(); }
+
+    /**
+     * @brief Gets the number of static meshes merged into the batches.
+     * @return The source mesh count.
+     */
+    size_t SourceCount() const { return m_sources.size(); }
+
+    /**
+     * @brief Gets how many times the batches were rebuilt.
+     * @return The rebuild count.
+     */
+    uint64_t RebuildCount() const { return m_rebuilds; }
+
+private:
+    bool HasChanged(const std::vector<const Mesh*>& statics) const;
+    void Rebuild(const std::vector<const Mesh*>& statics);
+
+    std::vector<std::pair<const Mesh*, uint64_t>> m_sources;
+    std::vector<std::unique_ptr<Mesh>> m_batches;
+    std::vector<Mesh*> m_batchPtrs;
+    uint64_t m_rebuilds = 0;
+};
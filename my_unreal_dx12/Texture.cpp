@@ -14,6 +14,15 @@ void Texture::LoadFromFile(GraphicsDevice& gd,
         throw std::runtime_error("Failed to load image");
     }
 
+    InitFromMemory(gd, data, UINT(w), UINT(h), srvCpu, srvGpu);
+    stbi_image_free(data);
+}
+
+void Texture::InitFromMemory(GraphicsDevice& gd,
+    const uint8_t* rgba, UINT w, UINT h,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu)
+{
     auto device = gd.Device();
 
     D3D12_RESOURCE_DESC desc{};
@@ -77,13 +86,20 @@ void Texture::LoadFromFile(GraphicsDevice& gd,
     for (UINT row = 0; row < numRows; ++row) {
         memcpy(
             mapped + fp.Offset + row * fp.Footprint.RowPitch,
-            data + row * srcPitch,
+            rgba + row * srcPitch,
             srcPitch
         );
     }
 
     m_upload->Unmap(0, nullptr);
-    stbi_image_free(data);
+
+    double sum[4]{};
+    const size_t pixelCount = size_t(w) * h;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        for (int c = 0; c < 4; ++c) sum[c] += rgba[i * 4 + c];
+    }
+    const double scale = pixelCount ? 1.0 / (255.0 * double(pixelCount)) : 0.0;
+    m_average = { float(sum[0] * scale), float(sum[1] * scale), float(sum[2] * scale), float(sum[3] * scale) };
 
     ComPtr<ID3D12CommandAllocator> alloc;
     DXThrow(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&alloc)));
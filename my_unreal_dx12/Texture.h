@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include <wrl.h>
 #include <d3d12.h>
+#include <DirectXMath.h>
 #include "GraphicsDevice.h"
 
 /**
@@ -24,6 +25,20 @@ public:
         D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
         D3D12_GPU_DESCRIPTOR_HANDLE srvGpu);
 
+    /**
+     * @brief Creates a texture from pixels in memory.
+     * @param gd The graphics device.
+     * @param rgba The pixels, 4 bytes each, row after row.
+     * @param width The width in pixels.
+     * @param height The height in pixels.
+     * @param srvCpu The CPU descriptor handle for the shader resource view.
+     * @param srvGpu The GPU descriptor handle for the shader resource view.
+     */
+    void InitFromMemory(GraphicsDevice& gd,
+        const uint8_t* rgba, UINT width, UINT height,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu);
+
     /**
      * @brief Initializes a 1x1 white texture.
      * @param gd The graphics device.
@@ -52,10 +67,19 @@ public:
      */
     D3D12_CPU_DESCRIPTOR_HANDLE CPUHandle() const { return m_srvCPU; }
 
+    /**
+     * @brief Gets the average color of the texture, computed when it was loaded.
+     * Lets CPU code such as the impostor baker approximate the texture without reading it back.
+     * @return The average RGBA color, each component in [0, 1].
+     */
+    const DirectX::XMFLOAT4& AverageColor() const { return m_average; }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> m_tex;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_upload;
 
     D3D12_CPU_DESCRIPTOR_HANDLE m_srvCPU{};
     D3D12_GPU_DESCRIPTOR_HANDLE m_srvGPU{};
+
+    DirectX::XMFLOAT4 m_average{ 1.f, 1.f, 1.f, 1.f };
 };
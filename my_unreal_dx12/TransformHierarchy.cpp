@@ -0,0 +1,251 @@
+#include "TransformHierarchy.h"
+#include "Mesh.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace DirectX;
+
+namespace {
+    // Levels smaller than this are propagated on the calling thread.
+    constexpr uint32_t kNodesPerJob = 256;
+}
+
+HierarchyLink::~HierarchyLink() {
+    // The mesh is being destroyed, so its node goes without restoring its world transform.
+    if (m_hierarchy) m_hierarchy->Free(m_node);
+}
+
+void HierarchyLink::MarkDirty() {
+    // The assigned mesh brought the parent transform of another node; a rebuild reapplies ours.
+    if (m_hierarchy) m_hierarchy->m_orderDirty = true;
+}
+
+TransformHierarchy::~TransformHierarchy() {
+    for (NodeInfo& info : m_nodes) {
+        if (info.alive && info.mesh) info.mesh->m_hierarchyLink.m_hierarchy = nullptr;
+    }
+}
+
+TransformHierarchy::Node TransformHierarchy::Allocate(Mesh* mesh, Node parent) {
+    if (parent != kNoNode && (parent >= m_nodes.size() || !m_nodes[parent].alive)) {
+        std::cout << "[Warning]: TransformHierarchy parent node " << parent << " does not exist, node added as a root." << std::endl;
+        parent = kNoNode;
+    }
+
+    Node node;
+    if (!m_freeNodes.empty()) {
+        node = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    }
+    else {
+        node = Node(m_nodes.size());
+        m_nodes.emplace_back();
+        m_pivotLocal.push_back(XMMatrixIdentity());
+        m_pivotInverse.push_back(XMMatrixIdentity());
+    }
+    m_nodes[node] = { mesh, parent, UINT32_MAX, true };
+    m_pivotLocal[node] = XMMatrixIdentity();
+    m_pivotInverse[node] = XMMatrixIdentity();
+    m_orderDirty = true;
+    return node;
+}
+
+TransformHierarchy::Node TransformHierarchy::Attach(Mesh& mesh, Node parent) {
+    if (mesh.m_hierarchyLink.IsLinked()) {
+        std::cout << "[Warning]: mesh is already attached to a TransformHierarchy." << std::endl;
+        return kNoNode;
+    }
+    const Node node = Allocate(&mesh, parent);
+    mesh.m_hierarchyLink.m_hierarchy = this;
+    mesh.m_hierarchyLink.m_node = node;
+    return node;
+}
+
+TransformHierarchy::Node TransformHierarchy::CreateNode(Node parent) {
+    return Allocate(nullptr, parent);
+}
+
+void TransformHierarchy::Remove(Node node) {
+    if (node >= m_nodes.size() || !m_nodes[node].alive) return;
+    if (m_nodes[node].mesh) m_nodes[node].mesh->ClearParentTransform();
+    Free(node);
+}
+
+void TransformHierarchy::Free(Node node) {
+    NodeInfo& info = m_nodes[node];
+    for (NodeInfo& other : m_nodes) {
+        if (other.alive && other.parent == node) other.parent = info.parent;
+    }
+    if (info.mesh) info.mesh->m_hierarchyLink.m_hierarchy = nullptr;
+    info = NodeInfo{};
+    m_freeNodes.push_back(node);
+    m_orderDirty = true;
+}
+
+bool TransformHierarchy::IsInSubtree(Node node, Node root) const {
+    for (; node != kNoNode; node = m_nodes[node].parent) {
+        if (node == root) return true;
+    }
+    return false;
+}
+
+void TransformHierarchy::SetParent(Node node, Node parent) {
+    if (node >= m_nodes.size() || !m_nodes[node].alive) return;
+    if (parent != kNoNode && (parent >= m_nodes.size() || !m_nodes[parent].alive)) return;
+    if (m_nodes[node].parent == parent) return;
+    if (parent != kNoNode && IsInSubtree(parent, node)) {
+        std::cout << "[Warning]: TransformHierarchy::SetParent would create a cycle, ignored." << std::endl;
+        return;
+    }
+    m_nodes[node].parent = parent;
+    m_orderDirty = true;
+}
+
+void TransformHierarchy::SetLocalTransform(Node node, FXMMATRIX local) {
+    if (node >= m_nodes.size() || !m_nodes[node].alive) return;
+    if (m_nodes[node].mesh) {
+        std::cout << "[Warning]: SetLocalTransform ignored on a mesh node, move the mesh instead." << std::endl;
+        return;
+    }
+    m_pivotLocal[node] = local;
+    m_pivotInverse[node] = XMMatrixInverse(nullptr, local);
+
+    const uint32_t slot = m_nodes[node].slot;
+    if (!m_orderDirty && slot != UINT32_MAX) {
+        m_local[slot] = m_pivotLocal[node];
+        m_localInverse[slot] = m_pivotInverse[node];
+        m_changed[slot] |= kLocalChanged;
+    }
+}
+
+TransformHierarchy::Node TransformHierarchy::Find(const Mesh& mesh) const {
+    const HierarchyLink& link = mesh.m_hierarchyLink;
+    return link.m_hierarchy == this ? link.m_node : kNoNode;
+}
+
+const XMMATRIX& TransformHierarchy::WorldTransform(Node node) const {
+    static const XMMATRIX identity = XMMatrixIdentity();
+    if (node >= m_nodes.size() || m_nodes[node].slot == UINT32_MAX) return identity;
+    return m_world[m_nodes[node].slot];
+}
+
+void TransformHierarchy::Rebuild() {
+    const uint32_t nodeCount = uint32_t(m_nodes.size());
+
+    // Depth of every node, walking up until a node of known depth.
+    m_depth.assign(nodeCount, -1);
+    int32_t maxDepth = -1;
+    for (Node n = 0; n < nodeCount; ++n) {
+        if (!m_nodes[n].alive || m_depth[n] >= 0) continue;
+        Node top = n;
+        int32_t steps = 0;
+        while (m_depth[top] < 0 && m_nodes[top].parent != kNoNode) {
+            top = m_nodes[top].parent;
+            ++steps;
+        }
+        if (m_depth[top] < 0) m_depth[top] = 0;
+        int32_t depth = m_depth[top] + steps;
+        for (Node m = n; m != top; m = m_nodes[m].parent) m_depth[m] = depth--;
+        maxDepth = std::max(maxDepth, m_depth[n]);
+    }
+
+    // Counting sort by depth.
+    m_levelStart.assign(size_t(maxDepth) + 2, 0);
+    for (Node n = 0; n < nodeCount; ++n) {
+        if (m_nodes[n].alive) ++m_levelStart[m_depth[n] + 1];
+    }
+    for (size_t l = 1; l < m_levelStart.size(); ++l) m_levelStart[l] += m_levelStart[l - 1];
+
+    const uint32_t slotCount = m_levelStart.back();
+    m_slotNode.resize(slotCount);
+    std::vector<uint32_t> cursor(m_levelStart.begin(), m_levelStart.end() - 1);
+    for (Node n = 0; n < nodeCount; ++n) {
+        if (!m_nodes[n].alive) continue;
+        const uint32_t slot = cursor[m_depth[n]]++;
+        m_slotNode[slot] = n;
+        m_nodes[n].slot = slot;
+    }
+
+    m_parentSlot.resize(slotCount);
+    m_mesh.resize(slotCount);
+    m_localVersion.resize(slotCount);
+    m_local.resize(slotCount);
+    m_localInverse.resize(slotCount);
+    m_world.resize(slotCount);
+    m_worldInverse.resize(slotCount);
+    m_changed.assign(slotCount, kLocalChanged | kParentChanged);
+    for (uint32_t slot = 0; slot < slotCount; ++slot) {
+        const NodeInfo& info = m_nodes[m_slotNode[slot]];
+        m_parentSlot[slot] = info.parent != kNoNode ? m_nodes[info.parent].slot : UINT32_MAX;
+        m_mesh[slot] = info.mesh;
+        if (info.mesh) {
+            m_local[slot] = info.mesh->LocalTransform();
+            m_localInverse[slot] = info.mesh->LocalInverseTransform();
+            m_localVersion[slot] = info.mesh->LocalVersion();
+        }
+        else {
+            m_local[slot] = m_pivotLocal[m_slotNode[slot]];
+            m_localInverse[slot] = m_pivotInverse[m_slotNode[slot]];
+        }
+    }
+    m_orderDirty = false;
+}
+
+void TransformHierarchy::PropagateRange(uint32_t begin, uint32_t end) {
+    for (uint32_t slot = begin; slot < end; ++slot) {
+        const uint32_t parent = m_parentSlot[slot];
+        if (parent != UINT32_MAX && m_changed[parent]) m_changed[slot] |= kParentChanged;
+        if (!m_changed[slot]) continue;
+
+        if (parent == UINT32_MAX) {
+            m_world[slot] = m_local[slot];
+            m_worldInverse[slot] = m_localInverse[slot];
+        }
+        else {
+            m_world[slot] = XMMatrixMultiply(m_local[slot], m_world[parent]);
+            m_worldInverse[slot] = XMMatrixMultiply(m_worldInverse[parent], m_localInverse[slot]);
+        }
+    }
+}
+
+void TransformHierarchy::Update() {
+    if (m_orderDirty) Rebuild();
+    m_updatedCount = 0;
+
+    bool anyChanged = false;
+    const uint32_t slotCount = uint32_t(m_slotNode.size());
+    for (uint32_t slot = 0; slot < slotCount; ++slot) {
+        Mesh* mesh = m_mesh[slot];
+        if (mesh && mesh->LocalVersion() != m_localVersion[slot]) {
+            m_local[slot] = mesh->LocalTransform();
+            m_localInverse[slot] = mesh->LocalInverseTransform();
+            m_localVersion[slot] = mesh->LocalVersion();
+            m_changed[slot] |= kLocalChanged;
+        }
+        anyChanged |= m_changed[slot] != 0;
+    }
+    if (!anyChanged) return;
+
+    // Nodes of one level only read the level above, so each level is split across threads.
+    for (size_t level = 0; level + 1 < m_levelStart.size(); ++level) {
+        const uint32_t begin = m_levelStart[level];
+        const uint32_t count = m_levelStart[level + 1] - begin;
+        JobSystem::I().ParallelFor(count, kNodesPerJob, [this, begin](uint32_t b, uint32_t e) {
+            PropagateRange(begin + b, begin + e);
+        });
+    }
+
+    // Meshes notify the render scene when they change, which is not thread safe.
+    for (uint32_t slot = 0; slot < slotCount; ++slot) {
+        if (!m_changed[slot]) continue;
+        ++m_updatedCount;
+        Mesh* mesh = m_mesh[slot];
+        if (mesh && (m_changed[slot] & kParentChanged)) {
+            const uint32_t parent = m_parentSlot[slot];
+            if (parent == UINT32_MAX) mesh->ClearParentTransform();
+            else mesh->SetParentTransform(m_world[parent], m_worldInverse[parent]);
+        }
+        m_changed[slot] = 0;
+    }
+}
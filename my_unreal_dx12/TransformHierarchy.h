@@ -0,0 +1,180 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+class Mesh;
+class TransformHierarchy;
+
+/**
+ * @class HierarchyLink
+ * @brief Node of a mesh in a TransformHierarchy, held by the mesh.
+ * A copy of a mesh is a new object and starts detached; assigning to an attached mesh keeps
+ * its node and reapplies the parent transform. Destroying the mesh removes its node.
+ */
+class HierarchyLink
+{
+public:
+    HierarchyLink() = default;
+    HierarchyLink(const HierarchyLink&) {}
+    HierarchyLink(HierarchyLink&&) noexcept {}
+    HierarchyLink& operator=(const HierarchyLink&) { MarkDirty(); return *this; }
+    HierarchyLink& operator=(HierarchyLink&&) noexcept { MarkDirty(); return *this; }
+    ~HierarchyLink();
+
+    /**
+     * @brief Checks whether the mesh is attached to a hierarchy.
+     * @return True if attached.
+     */
+    bool IsLinked() const { return m_hierarchy != nullptr; }
+
+private:
+    friend class TransformHierarchy;
+    void MarkDirty();
+
+    TransformHierarchy* m_hierarchy = nullptr;
+    uint32_t m_node = 0;
+};
+
+/**
+ * @class TransformHierarchy
+ * @brief Parent/child links between meshes and pivot nodes.
+ * A child mesh keeps its own position, rotation and scale, now relative to its parent,
+ * and Update gives it the world transform of the parent. Nodes are kept in contiguous
+ * arrays sorted by depth, so a node is always processed after its parent; only the
+ * subtrees under a changed node are recomputed, and the nodes of a level are spread
+ * over the job system.
+ * Attached meshes must keep their address; destroying one removes its node.
+ */
+class TransformHierarchy
+{
+public:
+    using Node = uint32_t;
+    static constexpr Node kNoNode = UINT32_MAX;
+
+    TransformHierarchy() = default;
+    ~TransformHierarchy();
+
+    TransformHierarchy(const TransformHierarchy&) = delete;
+    TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+    /**
+     * @brief Adds a mesh to the hierarchy.
+     * @param mesh The mesh; it can only be attached to one hierarchy, once.
+     * @param parent The parent node, or kNoNode for a root.
+     * @return The node of the mesh, or kNoNode if the mesh is already attached.
+     */
+    Node Attach(Mesh& mesh, Node parent = kNoNode);
+
+    /**
+     * @brief Adds a node without a mesh, such as a pivot to group or orbit meshes.
+     * @param parent The parent node, or kNoNode for a root.
+     * @return The new node.
+     */
+    Node CreateNode(Node parent = kNoNode);
+
+    /**
+     * @brief Removes a node. Its children are moved to its parent, and its mesh is
+     * back in world space.
+     * @param node The node to remove.
+     */
+    void Remove(Node node);
+
+    /**
+     * @brief Moves a node under another parent.
+     * @param node The node to move.
+     * @param parent The new parent, or kNoNode for a root; ignored if it is inside the node's subtree.
+     */
+    void SetParent(Node node, Node parent);
+
+    /**
+     * @brief Sets the transform of a node without a mesh, relative to its parent.
+     * Nodes with a mesh follow the mesh position, rotation and scale instead.
+     * @param node The node.
+     * @param local The local transform.
+     */
+    void SetLocalTransform(Node node, DirectX::FXMMATRIX local);
+
+    /**
+     * @brief Finds the node of a mesh.
+     * @param mesh The mesh.
+     * @return The node, or kNoNode if the mesh is not attached.
+     */
+    Node Find(const Mesh& mesh) const;
+
+    /**
+     * @brief Gets the parent of a node.
+     * @param node The node.
+     * @return The parent node, or kNoNode for a root.
+     */
+    Node Parent(Node node) const { return m_nodes[node].parent; }
+
+    /**
+     * @brief Gets the world transform of a node computed by the last Update.
+     * @param node The node.
+     * @return The world transform.
+     */
+    const DirectX::XMMATRIX& WorldTransform(Node node) const;
+
+    /**
+     * @brief Propagates the changed transforms down the hierarchy.
+     * Call it once per frame after moving meshes and before drawing.
+     */
+    void Update();
+
+    /**
+     * @brief Gets the number of nodes.
+     * @return The node count.
+     */
+    uint32_t NodeCount() const { return uint32_t(m_nodes.size() - m_freeNodes.size()); }
+
+    /**
+     * @brief Gets the number of nodes whose world transform was recomputed by the last Update.
+     * @return The updated count.
+     */
+    uint32_t UpdatedCount() const { return m_updatedCount; }
+
+private:
+    friend class HierarchyLink;
+
+    enum : uint8_t { kLocalChanged = 1, kParentChanged = 2 };
+
+    /** What a node is, indexed by node; the arrays below are indexed by slot. */
+    struct NodeInfo
+    {
+        Mesh* mesh = nullptr;
+        Node parent = kNoNode;
+        uint32_t slot = UINT32_MAX;
+        bool alive = false;
+    };
+
+    Node Allocate(Mesh* mesh, Node parent);
+    void Free(Node node);
+    bool IsInSubtree(Node node, Node root) const;
+    void Rebuild();
+    void PropagateRange(uint32_t begin, uint32_t end);
+
+    std::vector<NodeInfo> m_nodes;
+    std::vector<Node> m_freeNodes;
+    bool m_orderDirty = false;
+
+    // Depth-sorted slots, parents before children.
+    std::vector<Node> m_slotNode;
+    std::vector<uint32_t> m_parentSlot;
+    std::vector<Mesh*> m_mesh;
+    std::vector<uint64_t> m_localVersion;
+    std::vector<DirectX::XMMATRIX> m_local;
+    std::vector<DirectX::XMMATRIX> m_localInverse;
+    std::vector<DirectX::XMMATRIX> m_world;
+    std::vector<DirectX::XMMATRIX> m_worldInverse;
+    std::vector<uint8_t> m_changed;
+    /** First slot of each depth, plus the slot count. */
+    std::vector<uint32_t> m_levelStart;
+
+    // Transforms of nodes without a mesh, indexed by node so a rebuild can restore them.
+    std::vector<DirectX::XMMATRIX> m_pivotLocal;
+    std::vector<DirectX::XMMATRIX> m_pivotInverse;
+    std::vector<int32_t> m_depth;
+
+    uint32_t m_updatedCount = 0;
+};
@@ -10,6 +10,9 @@
 
 
 inline constexpr uint32_t kSwapBufferCount = 2;
+// Upper bound on the frames the CPU records ahead of the GPU; per-frame resources are sized for it.
+inline constexpr uint32_t kMaxFramesInFlight = 3;
+inline constexpr uint32_t kDefaultFramesInFlight = 2;
 
 /**
  * @brief Throws an exception if the HRESULT is a failure.
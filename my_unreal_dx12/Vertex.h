@@ -0,0 +1,14 @@
+#pragma once
+
+/**
+ * @struct Vertex
+ * @brief Represents a vertex in a mesh.
+ */
+struct Vertex {
+    float px, py, pz;
+    float nx, ny, nz;
+    float r, g, b;
+    float u, v;
+    float tx, ty, tz;
+    float bx, by, bz;
+};
@@ -17,8 +17,23 @@ cbuffer Scene : register(b0)
 
     float3 uKe;
     float _pad1;
+
+    float3 uTint;
+    float uFade;
 };
 
+// uModel, uNormalMatrix, uTint and uFade are per instance here; the draw binds its first
+// instance at t4.
+struct InstanceData
+{
+    float4x4 model;
+    float4x4 normalMatrix;
+    float3 tint;
+    float fade;
+};
+
+StructuredBuffer<InstanceData> uInstances : register(t4);
+
 struct VSIn
 {
     float3 pos : POSITION;
@@ -39,22 +54,25 @@ struct VSOut
     float4 shadowPos : TEXCOORD3;
     float3 tangent : TEXCOORD4;
     float3 bitangent : TEXCOORD5;
+    nointerpolation float fade : TEXCOORD6;
 };
 
-VSOut main(VSIn v)
+VSOut main(VSIn v, uint instanceId : SV_InstanceID)
 {
     VSOut o;
+    InstanceData inst = uInstances[instanceId];
 
-    float4 w = mul(float4(v.pos, 1.0), uModel);
+    float4 w = mul(float4(v.pos, 1.0), inst.model);
     o.worldPos = w.xyz;
     o.pos = mul(w, uViewProj);
 
-    float3x3 nMat = (float3x3) uNormalMatrix;
+    float3x3 nMat = (float3x3) inst.normalMatrix;
     o.nrm = normalize(mul(v.nrm, nMat));
     o.tangent = normalize(mul(v.tangent, nMat));
     o.bitangent = normalize(mul(v.bitangent, nMat));
 
-    o.col = v.col;
+    o.col = v.col * inst.tint;
+    o.fade = inst.fade;
     o.uv = v.uv;
 
     o.shadowPos = mul(w, uLightViewProj);
@@ -1,9 +1,24 @@
 #include "WindowDX12.h"
-
-struct TransparentCommand {
-    Mesh* mesh;
-    const Submesh* sm;
-};
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iterator>
+
+namespace {
+    /** Pipeline field of the draw queue keys of the main pass. */
+    enum DrawPipeline : uint32_t { kMeshPipeline, kImpostorPipeline, kAlphaPipeline };
+
+    // Meshes simpler than this are cheaper to draw than to bake and texture.
+    constexpr uint32_t kMinImpostorTriangles = 256;
+
+    std::string ReadShaderSource(const char* path) {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error(std::string("Failed to open shader file ") + path);
+        }
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+}
 
 WindowDX12::WindowDX12(UINT w, UINT h, const std::wstring& title)
 {
@@ -58,8 +73,31 @@ WindowDX12::WindowDX12(UINT w, UINT h, const std::wstring& title)
         [this](float val) {
             m_camController.SetMoveSpeeds(val, val * 5.f);
      });
+    m_cullText = m_imgui.addText("Culled: 0/0 meshes (0 small, 0 occluded, 0 reused), 0/0 submeshes, 0/0 shadow casters (0 small, 0 reused)");
+    m_imgui.AddButton("Toggle Occlusion Culling", [this]() {
+        m_occlusionEnabled = !m_occlusionEnabled;
+    });
+    m_imgui.AddButton("Toggle Temporal Culling", [this]() {
+        m_temporalCulling = !m_temporalCulling;
+    });
+    m_imgui.addSliderFloat("Min Screen Size", &m_minScreenSize, 0.0f, 32.0f);
+    m_lodText = m_imgui.addText("LOD: 0 meshes reduced, 0 triangles saved, 0 shadow casters reduced, 0 triangles saved, 0 impostors");
+    m_imgui.addSliderFloat("LOD Bias", &m_lodBias, -2.0f, 4.0f);
+    m_imgui.addSliderFloat("Impostor Distance", &m_impostorDistance, 0.0f, 300.0f);
+
+    m_sceneText = m_imgui.addText("Scene: 0 proxies, 0 updated, 0/0 hierarchy nodes, 0 draws for 0 instances, 0/0 state changes elided, 0 command lists (0.00 ms)");
+    m_imgui.AddButton("Toggle Parallel Recording", [this]() {
+        m_parallelRecording = !m_parallelRecording;
+    });
+    m_frameText = m_imgui.addText("Frames: 2 in flight, 0.00 ms waiting for the GPU");
+    m_imgui.AddButton("Toggle Frames In Flight", [this]() {
+        setFramesInFlight(m_renderer.FramesInFlight() == kMaxFramesInFlight ? 2 : kMaxFramesInFlight);
+    });
+
+    ResizeOcclusion(w, h);
 
     m_renderer.Initialize(m_gfx, m_swap, m_depth);
+    m_renderer.SetDescriptorHeap(m_srvHeap.Get());
 
     CreateShader();
 
@@ -105,7 +143,22 @@ WindowDX12::WindowDX12(UINT w, UINT h, const std::wstring& title)
         delete[] shadowPsSrc;
     }
 
-    m_cb.Create(m_gfx.Device(), kSwapBufferCount * kMaxDrawsPerFrame);
+    m_cb.Create(m_gfx.Device(), kMaxFramesInFlight * kMaxDrawsPerFrame);
+    m_instances.Create(m_gfx.Device(), kMaxInstancesPerFrame, kMaxFramesInFlight);
+
+    {
+        // Unit quad; the impostor vertex shader turns it to face the camera.
+        m_impostorQuad = std::make_shared<MeshAsset>();
+        for (int i = 0; i < 4; ++i) {
+            Vertex v{};
+            v.u = float(i & 1);
+            v.v = float(i >> 1);
+            v.r = v.g = v.b = 1.f;
+            m_impostorQuad->vertices.push_back(v);
+        }
+        m_impostorQuad->indices = { 0, 1, 2, 2, 1, 3 };
+        m_impostorQuad->Upload(m_gfx.Device());
+    }
 
     const float aspect = float(m_window.GetWidth()) / float(m_window.GetHeight());
     m_camera.LookAt(
@@ -212,6 +265,19 @@ void WindowDX12::CreateShader(void)
 
     delete[] vertexShaderSrc;
     delete[] pixelShaderSrc;
+
+    const std::string impostorVs = ReadShaderSource("ImpostorVertex.hlsl");
+    const std::string impostorPs = ReadShaderSource("ImpostorPixel.hlsl");
+    m_impostorPipeline.Create(
+        m_gfx.Device(),
+        il, _countof(il),
+        impostorVs.c_str(), impostorPs.c_str(),
+        DXGI_FORMAT_R8G8B8A8_UNORM,
+        DXGI_FORMAT_D32_FLOAT,
+        false,
+        true,
+        D3D12_CULL_MODE_NONE
+    );
 }
 
 SrvHandlePair WindowDX12::AllocateSrv()
@@ -243,6 +309,7 @@ uint32_t WindowDX12::Clear()
         m_swap.Resize(m_gfx, m_window.GetWidth(), m_window.GetHeight());
         m_depth.Resize(m_gfx, m_window.GetWidth(), m_window.GetHeight());
         m_renderer.OnResize(m_window.GetWidth(), m_window.GetHeight());
+        ResizeOcclusion(m_window.GetWidth(), m_window.GetHeight());
 
         const float aspect = float(m_window.GetWidth()) / float(m_window.GetHeight());
         m_camera.SetPerspective(DirectX::XM_PIDIV4, aspect,
@@ -257,31 +324,39 @@ uint32_t WindowDX12::Clear()
     m_camController.Update(dt, m_camera,
         float(m_window.GetWidth()) / float(m_window.GetHeight()));
 
+    // Every pass of the frame reads the camera from here.
+    m_camera.UpdateViewConstants();
+    const ViewConstants& view = m_camera.GetViewConstants();
+
     m_drawCursor = 0;
 
     using namespace DirectX;
 
     XMVECTOR lightDirRays = XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.3f, 0.0f));
-    XMVECTOR center = XMVectorSet(m_camera.getPosition().x, m_camera.getPosition().y, m_camera.getPosition().z, 10);
+    XMVECTOR center = XMVectorSetW(XMLoadFloat3(&view.position), 10);
     XMVECTOR lightPos = XMVectorSubtract(center, XMVectorScale(lightDirRays, 80.0f));
 
     XMMATRIX lightView = XMMatrixLookAtLH(lightPos, center, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
     XMMATRIX lightProj = XMMatrixOrthographicLH(60.f, 60.f, 1.0f, 150.0f);
     XMStoreFloat4x4(&m_lightViewProj, XMMatrixTranspose(lightView * lightProj));
+    m_lightFrustum.SetViewProj(lightView * lightProj, false);
+    m_lightSizeCuller.SetView(lightView, lightProj, m_shadowMap.Viewport().Height);
+    m_cullHistory[0].BeginFrame(view.view, view.proj);
+    m_cullHistory[1].BeginFrame(lightView, lightProj);
 
     XMFLOAT3 lightDirShader;
     XMStoreFloat3(&lightDirShader, XMVectorNegate(lightDirRays));
     m_lightDir = lightDirShader;
 
-    m_renderer.BeginFrame(m_swap.FrameIndex());
+    // Waits, if needed, until the GPU is done with the slot's constants and instances.
+    m_renderer.BeginFrame();
+    m_instances.BeginFrame(m_renderer.FrameSlot());
     m_imgui.NewFrame();
 
-    ID3D12DescriptorHeap* heaps[] = { m_srvHeap.Get() };
-    m_renderer.GetCommandList()->SetDescriptorHeaps(1, heaps);
-
     auto s = m_trianglesCount;
     m_trianglesCount = 0;
     m_DrawList.clear();
+    m_StaticList.clear();
     return s;
 }
 
@@ -289,233 +364,849 @@ void WindowDX12::RenderShadowPass(const std::vector<Mesh*>& meshes)
 {
     using namespace DirectX;
 
-    ID3D12GraphicsCommandList* cmd = m_renderer.GetCommandList();
-    m_renderer.BeginShadowPass(m_shadowMap, m_shadowPipeline);
+    m_renderer.BeginShadowPass(m_shadowMap);
 
-    const UINT frame = m_swap.FrameIndex();
+    const UINT frame = m_renderer.FrameSlot();
+
+    // Casters are culled against the light volume without its near plane: anything between
+    // the light and the volume can still throw a shadow into it.
+    const bool fromDrawList = &meshes == &m_DrawList;
+    if (fromDrawList) {
+        CullDrawList(true, m_cullResults);
+        CullSmall(true, m_cullResults);
+        SelectLods(true, m_cullResults);
+    }
+    else {
+        m_cullBounds.resize(meshes.size());
+        m_cullResults.resize(meshes.size());
+        for (size_t i = 0; i < meshes.size(); ++i)
+            m_cullBounds[i] = meshes[i]->WorldBounds();
+        m_lightFrustum.Test(m_cullBounds.data(), m_cullBounds.size(), m_cullResults.data());
+    }
+    m_cullStats.shadowCastersTested += uint32_t(meshes.size());
 
-    for (auto* mesh : meshes)
+    // Casters are gathered here, so the recording threads only read plain data.
+    m_shadowCasters.clear();
+    for (size_t i = 0; i < meshes.size(); ++i)
     {
-        XMMATRIX M = mesh->Transform();
+        if (m_cullResults[i] == CullResult::Outside) {
+            ++m_cullStats.shadowCastersCulled;
+            continue;
+        }
+        Mesh* mesh = meshes[i];
+
+        ShadowCaster caster;
+        if (fromDrawList)
+            caster.model = m_renderScene.Proxy(m_drawIds[i]).model;
+        else
+            XMStoreFloat4x4(&caster.model, XMMatrixTranspose(mesh->Transform()));
+
+        const uint32_t level = fromDrawList ? m_shadowLods[i] : 0;
+        caster.asset = mesh->LodAsset(level);
+        if (!caster.asset) continue;
+        if (level > 0) {
+            ++m_cullStats.shadowCastersReduced;
+            const MeshAsset* base = mesh->GetAsset();
+            if (base && base->indexCount > caster.asset->indexCount)
+                m_cullStats.shadowTrianglesSaved += (base->indexCount - caster.asset->indexCount) / 3;
+        }
+        m_shadowCasters.push_back(caster);
+    }
 
-        SceneCB cb{};
-        XMStoreFloat4x4(&cb.uModel, XMMatrixTranspose(M));
-        cb.uLightViewProj = m_lightViewProj;
+    m_recordChunks.clear();
+    SplitChunks(0, 0, uint32_t(m_shadowCasters.size()), nullptr);
+    RecordChunks([&](CommandContext& ctx, RecordChunk& chunk) {
+        m_renderer.BindShadowTargets(ctx, m_shadowMap, m_shadowPipeline);
 
-        UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
-        D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+        for (uint32_t k = chunk.begin; k < chunk.end; ++k) {
+            const ShadowCaster& caster = m_shadowCasters[k];
 
-        m_renderer.DrawMeshShadow(*mesh, addr);
-    }
+            SceneCB cb{};
+            cb.uModel = caster.model;
+            cb.uLightViewProj = m_lightViewProj;
+
+            UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
+            D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+
+            m_renderer.DrawMeshShadow(ctx, *caster.asset, addr);
+        }
+    });
 
     m_renderer.EndShadowPass(m_shadowMap);
-    m_renderer.BindMainRenderTargets();
+}
+
+void WindowDX12::SplitChunks(uint32_t pipeline, uint32_t begin, uint32_t end, const std::function<bool(uint32_t)>& canSplitAt)
+{
+    if (begin >= end) return;
+
+    // Each thread gets about the same share, unless the shares would be too small to pay
+    // for a command list of their own.
+    const uint32_t count = end - begin;
+    uint32_t chunks = 1;
+    if (m_parallelRecording)
+        chunks = std::clamp((count + kMinDrawsPerChunk - 1) / kMinDrawsPerChunk, 1u, JobSystem::I().ThreadCount());
+
+    uint32_t start = begin;
+    for (uint32_t k = 1; k <= chunks && start < end; ++k) {
+        uint32_t split = begin + uint32_t(uint64_t(count) * k / chunks);
+        if (split <= start) continue;
+        while (split < end && canSplitAt && !canSplitAt(split)) ++split;
+        m_recordChunks.push_back({ pipeline, start, split, 0, 0 });
+        start = split;
+    }
+}
+
+void WindowDX12::RecordChunks(const std::function<void(CommandContext&, RecordChunk&)>& record)
+{
+    const uint32_t count = uint32_t(m_recordChunks.size());
+    if (count == 0) return;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Contexts are opened in chunk order here, so the lists are submitted in draw order
+    // whichever thread records them.
+    m_renderer.BeginParallel(count);
+    auto recordRange = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i)
+            record(m_renderer.ParallelContext(i), m_recordChunks[i]);
+    };
+    if (m_parallelRecording)
+        JobSystem::I().ParallelFor(count, 1, recordRange);
+    else
+        recordRange(0, count);
+    m_renderer.EndParallel();
+
+    for (const RecordChunk& chunk : m_recordChunks) {
+        m_drawCalls += chunk.drawCalls;
+        m_trianglesCount += chunk.triangles;
+    }
+    m_recordMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
 void WindowDX12::Draw(const Mesh& mesh)
 {
-    m_DrawList.push_back(const_cast<Mesh*>(&mesh));
+    if (mesh.IsInScene())
+        return;
+    if (mesh.IsBatched())
+        m_StaticList.push_back(&mesh);
+    else
+        m_DrawList.push_back(const_cast<Mesh*>(&mesh));
 }
 
 void WindowDX12::Display()
 {
+    // Children pick up their parent's transform before their proxies are refreshed.
+    m_hierarchy.Update();
+
+    // Retained meshes join the meshes submitted with Draw for this frame.
+    m_renderScene.Flush();
+    const auto& retainedDynamic = m_renderScene.RetainedDynamic();
+    const auto& retainedStatic = m_renderScene.RetainedStatic();
+    m_DrawList.insert(m_DrawList.end(), retainedDynamic.begin(), retainedDynamic.end());
+    m_StaticList.insert(m_StaticList.end(), retainedStatic.begin(), retainedStatic.end());
+
+    const auto& batches = m_staticBatcher.Update(m_StaticList);
+    m_batchStart = m_DrawList.size();
+    m_DrawList.insert(m_DrawList.end(), batches.begin(), batches.end());
+    SyncRenderScene();
+    m_sceneAccel.Update(m_renderScene);
+
+    m_cullStats = {};
+    m_drawCalls = 0;
+    m_recordMs = 0.f;
     RenderShadowPass(m_DrawList);
     DrawScene();
+
+    if (m_cullText) {
+        m_cullText->setText("Culled: %u/%u meshes (%u small, %u occluded, %.2f ms, %u reused), %u/%u submeshes, %u/%u shadow casters (%u small, %u reused)",
+            m_cullStats.meshesCulled, m_cullStats.meshesTested,
+            m_cullStats.meshesTooSmall, m_cullStats.meshesOccluded, m_cullStats.occlusionMs,
+            m_cullStats.meshesReused,
+            m_cullStats.submeshesCulled, m_cullStats.submeshesTested,
+            m_cullStats.shadowCastersCulled, m_cullStats.shadowCastersTested,
+            m_cullStats.shadowCastersTooSmall, m_cullStats.shadowCastersReused);
+    }
+    if (m_lodText) {
+        m_lodText->setText("LOD: %u meshes reduced, %u triangles saved, %u shadow casters reduced, %u triangles saved, %u impostors",
+            m_cullStats.meshesReduced, m_cullStats.trianglesSaved,
+            m_cullStats.shadowCastersReduced, m_cullStats.shadowTrianglesSaved,
+            m_cullStats.meshesImpostored);
+    }
+    if (m_sceneText) {
+        const auto& state = m_renderer.StateStats();
+        m_sceneText->setText("Scene: %u proxies, %u updated, %u/%u hierarchy nodes, %u draws for %u instances, %u/%u state changes elided, %u command lists (%.2f ms)",
+            m_renderScene.ProxyCount(), m_renderScene.UpdatedCount(),
+            m_hierarchy.UpdatedCount(), m_hierarchy.NodeCount(),
+            m_drawCalls, m_instances.Count(),
+            state.elided, state.issued + state.elided,
+            m_renderer.ContextCount(), m_recordMs);
+    }
+    if (m_frameText) {
+        m_frameText->setText("Frames: %u in flight, %.2f ms waiting for the GPU",
+            m_renderer.FramesInFlight(), m_renderer.GpuWaitMs());
+    }
     m_imgui.Draw(m_renderer);
-    const UINT frame = m_swap.FrameIndex();
-    m_renderer.EndFrame(frame);
+    m_renderer.EndFrame();
 }
 
-void WindowDX12::SetCameraLookAt(DirectX::XMVECTOR eye, DirectX::XMVECTOR at, DirectX::XMVECTOR up)
+void WindowDX12::SyncRenderScene()
 {
-    m_camera.LookAt(eye, at, up);
-    m_view = m_camera.View();
+    ++m_frameNumber;
+    m_duplicateDraws.clear();
+    m_drawIds.resize(m_DrawList.size());
+
+    // Retained meshes already have a proxy; the others are matched by address and only
+    // refreshed when their version changed.
+    for (uint32_t i = 0; i < uint32_t(m_DrawList.size()); ++i) {
+        Mesh* mesh = m_DrawList[i];
+        bool first = true;
+        const uint32_t id = mesh->IsInScene()
+            ? m_renderScene.IdOf(*mesh)
+            : m_renderScene.Track(*mesh, m_frameNumber, first, i >= m_batchStart);
+        m_drawIds[i] = id;
+
+        RenderProxy& proxy = m_renderScene.Proxy(id);
+        if (first) proxy.drawIndex = i;
+        else m_duplicateDraws.emplace_back(i, proxy.drawIndex);
+    }
+
+    // Static meshes drawn in immediate mode are not drawn on their own, but scene queries
+    // still report them, so they get a proxy too.
+    for (const Mesh* mesh : m_StaticList) {
+        if (mesh->IsInScene()) continue;
+        bool first;
+        m_renderScene.Track(const_cast<Mesh&>(*mesh), m_frameNumber, first);
+    }
+
+    m_renderScene.Update(m_frameNumber);
 }
 
-void WindowDX12::SetCameraPerspective(float fov, float aspect, float zn, float zf)
+void WindowDX12::CullDrawList(bool shadowPass, std::vector<CullResult>& results)
 {
-    m_camera.SetPerspective(fov, aspect, zn, zf);
-    m_proj = m_camera.Proj();
+    const FrustumCuller& culler = shadowPass ? m_lightFrustum : m_frustum;
+    results.assign(m_DrawList.size(), CullResult::Outside);
+    m_cullCandidates.clear();
+
+    // The tree only tests fat bounds; leaves not fully inside get an exact test on their
+    // tight bounds, unless temporal culling still trusts a result from an earlier frame.
+    const CullHistory& history = m_cullHistory[shadowPass];
+    uint32_t& reused = shadowPass ? m_cullStats.shadowCastersReused : m_cullStats.meshesReused;
+    m_renderScene.Tree().QueryFrustum(culler, [&](int32_t leaf, CullResult r) {
+        const RenderProxy& proxy = m_renderScene.Proxy(m_renderScene.FromTree(leaf));
+        const CullCache& cache = proxy.cull[shadowPass];
+        if (r == CullResult::Inside) {
+            results[proxy.drawIndex] = CullResult::Inside;
+        }
+        else if (m_temporalCulling && history.CanReuse(cache, proxy.bounds)) {
+            results[proxy.drawIndex] = cache.result;
+            ++reused;
+        }
+        else {
+            m_cullCandidates.push_back(proxy.drawIndex);
+        }
+    });
+
+    m_cullBounds.resize(m_cullCandidates.size());
+    m_candidateResults.resize(m_cullCandidates.size());
+    for (size_t i = 0; i < m_cullCandidates.size(); ++i)
+        m_cullBounds[i] = m_renderScene.Proxy(m_drawIds[m_cullCandidates[i]]).bounds;
+
+    if (m_temporalCulling) {
+        // The exact test also measures how far the view can move before each result changes.
+        m_candidateMargins.resize(m_cullCandidates.size());
+        culler.Test(m_cullBounds.data(), m_cullBounds.size(), m_candidateResults.data(), m_candidateMargins.data());
+        for (size_t i = 0; i < m_cullCandidates.size(); ++i) {
+            const uint32_t index = m_cullCandidates[i];
+            results[index] = m_candidateResults[i];
+            history.Store(m_renderScene.Proxy(m_drawIds[index]).cull[shadowPass], m_candidateResults[i], m_candidateMargins[i]);
+        }
+    }
+    else {
+        culler.Test(m_cullBounds.data(), m_cullBounds.size(), m_candidateResults.data());
+        for (size_t i = 0; i < m_cullCandidates.size(); ++i)
+            results[m_cullCandidates[i]] = m_candidateResults[i];
+    }
+
+    for (const auto& [index, primary] : m_duplicateDraws)
+        results[index] = results[primary];
 }
 
-void WindowDX12::ActivateConsole()
+void WindowDX12::SelectLods(bool shadowPass, const std::vector<CullResult>& results)
 {
-    AllocConsole();
-    SetConsoleTitleW(L"Debug Output");
-    FILE* fp;
-    freopen_s(&fp, "CONOUT$", "w", stdout);
-    freopen_s(&fp, "CONOUT$", "w", stderr);
+    const ScreenSizeCuller& sizer = shadowPass ? m_lightSizeCuller : m_sizeCuller;
+    const float threshold = m_lodErrorThreshold * std::exp2(m_lodBias + (shadowPass ? m_shadowLodBias : 0.f));
+    std::vector<uint8_t>& levels = shadowPass ? m_shadowLods : m_drawLods;
+    levels.assign(m_DrawList.size(), 0);
+
+    for (size_t i = 0; i < m_DrawList.size(); ++i) {
+        if (results[i] == CullResult::Outside) continue;
+        const Mesh* mesh = m_DrawList[i];
+        if (mesh->LodCount() < 2) continue;
+
+        // Errors are in mesh units; the ratio of the world and local spheres scales them.
+        RenderProxy& proxy = m_renderScene.Proxy(m_drawIds[i]);
+        const MeshAsset* base = mesh->GetAsset();
+        const float scale = base->sphere.Radius > 0.f ? proxy.sphere.Radius / base->sphere.Radius : 1.f;
+        float pixelsPerUnit = sizer.PixelsPerUnitAt(proxy.sphere);
+        if (pixelsPerUnit != FLT_MAX) pixelsPerUnit *= scale;
+
+        uint8_t& current = shadowPass ? proxy.shadowLod : proxy.lod;
+        current = uint8_t(LodSelector::Select(mesh->LodErrors(), mesh->LodCount(),
+            pixelsPerUnit, threshold, m_lodHysteresis, current));
+        levels[i] = current;
+    }
 }
 
-void WindowDX12::DrawScene() {
+void WindowDX12::SelectImpostors(const std::vector<CullResult>& results)
+{
     using namespace DirectX;
 
-    std::vector<TransparentCommand> transparent;
+    m_drawImpostor.assign(m_DrawList.size(), 0.f);
+    const XMVECTOR eye = XMLoadFloat3(&m_camera.GetViewConstants().position);
 
-    m_renderer.SetPipeline(m_pipeline);
-    m_renderer.BindMainRenderTargets();
+    // Static batches span large areas, so they are always drawn as meshes.
+    for (size_t i = 0; i < m_batchStart; ++i) {
+        if (results[i] == CullResult::Outside) continue;
+        const Mesh* mesh = m_DrawList[i];
 
-    for (auto& meshPtr : m_DrawList) {
-        XMMATRIX M = meshPtr->Transform();
-        XMMATRIX V = m_camera.View();
-        XMMATRIX P = m_camera.Proj();
-        XMMATRIX VP = V * P;
-
-        XMFLOAT3 camPos = m_camera.getPosition();
-
-        XMVECTOR det;
-        XMMATRIX MInv = XMMatrixInverse(&det, M);
-        XMMATRIX NMat = XMMatrixTranspose(MInv);
-
-        SceneCB base{};
-		base.uShininess = 232.0f;
-        XMStoreFloat4x4(&base.uModel, XMMatrixTranspose(M));
-        XMStoreFloat4x4(&base.uViewProj, XMMatrixTranspose(VP));
-        XMStoreFloat4x4(&base.uNormalMatrix, XMMatrixTranspose(NMat));
-        base.uCameraPos = camPos;
-        base.uLightViewProj = m_lightViewProj;
-        base.uLightDir = m_lightDir;
-        base._pad0 = 0.0f;
-
-        base.uKs = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
-        base.uOpacity = 1.f;
-        base.uKe = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
-        base._pad1 = 0.0f;
-
-        const UINT frame = m_swap.FrameIndex();
-        const MeshAsset* asset = meshPtr->GetAsset();
-
-        if (asset && !asset->submeshes.empty()) {
-            for (const auto& sm : asset->submeshes) {
-                if (sm.opacity < 0.999f) {
-                    transparent.push_back({ meshPtr, &sm });
-                    continue;
-                }
+        float distance = mesh->ImpostorDistance();
+        if (distance < 0.f) distance = m_impostorDistance;
+        if (distance <= 0.f) continue;
 
-                SceneCB cb = base;
-                cb.uShininess = sm.shininess;
-                cb.uKs = sm.ks;
-                cb.uOpacity = sm.opacity;
-                cb.uKe = sm.ke;
+        // Atlases are baked per asset with the asset's texture.
+        const MeshAsset* asset = mesh->GetAsset();
+        if (!asset || asset->indexCount / 3 < kMinImpostorTriangles || mesh->HasOwnTexture()) continue;
 
-                const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
-                D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+        const RenderProxy& proxy = m_renderScene.Proxy(m_drawIds[i]);
+        const float d = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&proxy.sphere.Center), eye)));
+        const float blend = distance * m_impostorBlend;
+        const float t = blend > 0.f ? std::clamp((d - distance) / blend, 0.f, 1.f) : (d > distance ? 1.f : 0.f);
+        if (t <= 0.f || !ImpostorFor(*asset)) continue;
 
-                Texture* tex = sm.texture ? sm.texture.get() : meshPtr->GetTexture();
-                if (!tex) tex = &getDefaultTexture();
+        m_drawImpostor[i] = t;
+    }
+}
 
-                Texture* normalTex = nullptr;
-                if (sm.hasNormalMap && sm.normalMap)
-                    normalTex = sm.normalMap.get();
-                if (!normalTex)
-                    normalTex = &getDefaultTexture();
+const ImpostorAtlas* WindowDX12::ImpostorFor(const MeshAsset& asset)
+{
+    // Baked the first time the asset is far enough away, then shared by all its meshes.
+    if (!asset.impostor) {
+        auto atlas = ImpostorBaker::Bake(asset);
+        if (atlas->radius > 0.f) {
+            const UINT size = atlas->Size();
+            const SrvHandlePair albedo = AllocateSrv();
+            const SrvHandlePair normals = AllocateSrv();
+            atlas->albedoTexture = std::make_shared<Texture>();
+            atlas->albedoTexture->InitFromMemory(m_gfx, atlas->albedo.data(), size, size, albedo.cpu, albedo.gpu);
+            atlas->normalTexture = std::make_shared<Texture>();
+            atlas->normalTexture->InitFromMemory(m_gfx, atlas->normals.data(), size, size, normals.cpu, normals.gpu);
+        }
+        asset.impostor = std::move(atlas);
+    }
+    // Assets without a volume keep an empty atlas so they are not baked again.
+    return asset.impostor->albedoTexture ? asset.impostor.get() : nullptr;
+}
 
-                Texture* mrTex = nullptr;
-                if (sm.hasMetalRoughMap && sm.metalRoughMap)
-                    mrTex = sm.metalRoughMap.get();
-                if (!mrTex)
-                    mrTex = &getDefaultTexture();
+void WindowDX12::DrawInstanced(CommandContext& ctx, RecordChunk& chunk)
+{
+    using namespace DirectX;
 
-                D3D12_GPU_DESCRIPTOR_HANDLE texHandle = tex->GPUHandle();
-                D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle = m_shadowMap.SRVGPU();
-                D3D12_GPU_DESCRIPTOR_HANDLE normalHandle = normalTex->GPUHandle();
-                D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle = mrTex->GPUHandle();
+    m_renderer.BindMainRenderTargets(ctx, &m_pipeline);
 
-                m_renderer.DrawMeshRange(*meshPtr, addr,
-                    texHandle, shadowHandle, normalHandle, metalRoughHandle,
-                    sm.indexStart, sm.indexCount);
+    const ViewConstants& view = m_camera.GetViewConstants();
+    const UINT frame = m_renderer.FrameSlot();
 
-                m_trianglesCount += sm.indexCount / 3;
-            }
+    // Meshes sharing geometry and texture are next to each other in the queue, front to
+    // back, and become the instances of one draw per submesh. Chunks never split them.
+    const DrawQueue::Item* begin = m_drawQueue.Items().data() + chunk.begin;
+    auto commandAt = [&](size_t i) -> const InstanceCommand& { return m_instanceCommands[begin[i].payload]; };
+    const size_t commandCount = size_t(chunk.end - chunk.begin);
+
+    auto writeInstance = [&](UINT index, const InstanceCommand& command) {
+        const RenderProxy& proxy = m_renderScene.Proxy(m_drawIds[command.meshIndex]);
+        m_instances.Write(index, { proxy.model, proxy.normalMatrix, proxy.tint, command.fade });
+    };
+    auto culled = [&](const InstanceCommand& command, size_t submesh) {
+        return command.submeshVisible != UINT32_MAX && !m_submeshVisible[command.submeshVisible + submesh];
+    };
+
+    // Per-object fields come from the instances.
+    SceneCB base{};
+    base.uShininess = 232.0f;
+    base.uViewProj = view.viewProjTransposed;
+    base.uCameraPos = view.position;
+    base.uLightViewProj = m_lightViewProj;
+    base.uLightDir = m_lightDir;
+    base.uKs = XMFLOAT3(1.f, 1.f, 1.f);
+    base.uOpacity = 1.f;
+    base.uKe = XMFLOAT3(0.f, 0.f, 0.f);
+    base.uTint = XMFLOAT3(1.f, 1.f, 1.f);
+    base.uFade = 1.f;
+
+    Texture* defaultTex = &getDefaultTexture();
+    const D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle = m_shadowMap.SRVGPU();
+
+    for (size_t groupStart = 0; groupStart < commandCount;) {
+        const InstanceCommand& head = commandAt(groupStart);
+        size_t groupEnd = groupStart + 1;
+        while (groupEnd < commandCount && head.SharesDrawWith(commandAt(groupEnd)))
+            ++groupEnd;
+
+        // Instances that do not fit in the buffer are not drawn.
+        UINT first;
+        const UINT count = m_instances.Allocate(UINT(groupEnd - groupStart), first);
+        for (UINT k = 0; k < count; ++k)
+            writeInstance(first + k, commandAt(groupStart + k));
+
+        const MeshAsset& asset = *head.asset;
+        Texture* meshTex = head.texture ? head.texture : defaultTex;
+
+        if (asset.submeshes.empty() && count > 0) {
+            SceneCB cb = base;
+            if (head.shininess >= 0.f) cb.uShininess = head.shininess;
+
+            const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
+            D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+
+            m_renderer.DrawMeshInstanced(ctx, asset, addr, m_instances.Address(first), count,
+                meshTex->GPUHandle(), shadowHandle, defaultTex->GPUHandle(), defaultTex->GPUHandle(),
+                0, asset.indexCount);
+            ++chunk.drawCalls;
+            chunk.triangles += asset.indexCount / 3 * count;
         }
-        else {
+
+        for (size_t j = 0; j < asset.submeshes.size() && count > 0; ++j) {
+            const Submesh& sm = asset.submeshes[j];
+            if (sm.opacity < 0.999f) continue;
+
+            // Instances that culled this submesh are left out of a compacted copy of the range.
+            UINT drawFirst = first;
+            UINT drawCount = count;
+            bool partial = false;
+            for (UINT k = 0; k < count && !partial; ++k)
+                partial = culled(commandAt(groupStart + k), j);
+            if (partial) {
+                UINT visible = 0;
+                for (UINT k = 0; k < count; ++k)
+                    visible += culled(commandAt(groupStart + k), j) ? 0 : 1;
+                drawCount = m_instances.Allocate(visible, drawFirst);
+                UINT written = 0;
+                for (UINT k = 0; k < count && written < drawCount; ++k) {
+                    const InstanceCommand& command = commandAt(groupStart + k);
+                    if (!culled(command, j)) writeInstance(drawFirst + written++, command);
+                }
+                if (drawCount == 0) continue;
+            }
+
             SceneCB cb = base;
+            cb.uShininess = head.shininess >= 0.f ? head.shininess : sm.shininess;
+            cb.uKs = sm.ks;
+            cb.uOpacity = sm.opacity;
+            cb.uKe = sm.ke;
 
             const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
             D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
 
-            Texture* tex = meshPtr->GetTexture();
-            if (!tex) tex = &getDefaultTexture();
+            Texture* tex = sm.texture ? sm.texture.get() : meshTex;
+            Texture* normalTex = sm.hasNormalMap && sm.normalMap ? sm.normalMap.get() : defaultTex;
+            Texture* mrTex = sm.hasMetalRoughMap && sm.metalRoughMap ? sm.metalRoughMap.get() : defaultTex;
+
+            m_renderer.DrawMeshInstanced(ctx, asset, addr, m_instances.Address(drawFirst), drawCount,
+                tex->GPUHandle(), shadowHandle, normalTex->GPUHandle(), mrTex->GPUHandle(),
+                sm.indexStart, sm.indexCount);
+            ++chunk.drawCalls;
+            chunk.triangles += sm.indexCount / 3 * drawCount;
+        }
+
+        groupStart = groupEnd;
+    }
+}
+
+void WindowDX12::DrawImpostors(CommandContext& ctx, RecordChunk& chunk)
+{
+    m_renderer.BindMainRenderTargets(ctx, &m_impostorPipeline);
+
+    const ViewConstants& view = m_camera.GetViewConstants();
+    const UINT frame = m_renderer.FrameSlot();
+
+    const DrawQueue::Item* items = m_drawQueue.Items().data();
+    for (const DrawQueue::Item* item = items + chunk.begin; item != items + chunk.end; ++item) {
+        const uint32_t i = item->payload;
+        const RenderProxy& proxy = m_renderScene.Proxy(m_drawIds[i]);
+        const ImpostorAtlas& atlas = *m_DrawList[i]->GetAsset()->impostor;
+
+        ImpostorCB cb{};
+        cb.uModel = proxy.model;
+        cb.uViewProj = view.viewProjTransposed;
+        cb.uNormalMatrix = proxy.normalMatrix;
+        cb.uCameraPos = view.position;
+        cb.uFrames = float(atlas.frames);
+        cb.uLightViewProj = m_lightViewProj;
+        cb.uLightDir = m_lightDir;
+        cb.uAtlasRadius = atlas.radius;
+        cb.uCenter = proxy.sphere.Center;
+        cb.uRadius = proxy.sphere.Radius;
+        cb.uTint = proxy.tint;
+        // The mesh keeps the first part of the dither pattern, the impostor takes the rest.
+        cb.uFadeStart = m_drawFade[i] * (1.f - m_drawImpostor[i]);
+        cb.uFadeEnd = m_drawFade[i];
+        cb.uFrameSize = float(atlas.frameSize);
+
+        const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
+        D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+
+        m_renderer.DrawMesh(ctx, *m_impostorQuad, addr,
+            atlas.albedoTexture->GPUHandle(), m_shadowMap.SRVGPU(),
+            atlas.normalTexture->GPUHandle(), getDefaultTexture().GPUHandle());
+        ++chunk.drawCalls;
+        chunk.triangles += 2;
+    }
+}
+
+void WindowDX12::CullSmall(bool shadowPass, std::vector<CullResult>& results)
+{
+    const ScreenSizeCuller& sizer = shadowPass ? m_lightSizeCuller : m_sizeCuller;
+    if (!shadowPass) m_drawFade.assign(m_DrawList.size(), 1.f);
+
+    for (size_t i = 0; i < m_DrawList.size(); ++i) {
+        if (results[i] == CullResult::Outside) continue;
+        const Mesh* mesh = m_DrawList[i];
+
+        float threshold = shadowPass ? mesh->MinShadowScreenSize() : mesh->MinScreenSize();
+        if (threshold < 0.f) threshold = shadowPass ? m_minShadowScreenSize : m_minScreenSize;
+        if (threshold <= 0.f) continue;
+
+        // The decision is remembered per pass, so a mesh can keep its shadow after it stops
+        // being drawn and the other way around.
+        RenderProxy& proxy = m_renderScene.Proxy(m_drawIds[i]);
+        bool& dropped = shadowPass ? proxy.droppedInShadow : proxy.droppedInMain;
+        const float size = sizer.ProjectedSize(proxy.sphere);
+        dropped = !ScreenSizeCuller::Keep(size, threshold, m_screenSizeHysteresis, dropped);
+
+        if (dropped) {
+            results[i] = CullResult::Outside;
+            ++(shadowPass ? m_cullStats.shadowCastersTooSmall : m_cullStats.meshesTooSmall);
+        }
+        else if (!shadowPass && m_screenSizeFade) {
+            m_drawFade[i] = std::min<float>(1.f, (size - threshold) / threshold);
+        }
+    }
+}
+
+void WindowDX12::ResizeOcclusion(UINT width, UINT height)
+{
+    // The CPU depth buffer keeps a fixed width and follows the aspect ratio of the window,
+    // so boxes are tested against the pixels they cover on screen.
+    if (width == 0) return;
+    m_occlusion.SetResolution(kOcclusionWidth, kOcclusionWidth * height / width);
+}
 
-            Texture* normalTex = &getDefaultTexture();
-            Texture* mrTex = &getDefaultTexture();
+void WindowDX12::CullOccluded()
+{
+    using namespace DirectX;
 
-            D3D12_GPU_DESCRIPTOR_HANDLE texHandle = tex->GPUHandle();
-            D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle = m_shadowMap.SRVGPU();
-            D3D12_GPU_DESCRIPTOR_HANDLE normalHandle = normalTex->GPUHandle();
-            D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle = mrTex->GPUHandle();
+    const auto start = std::chrono::steady_clock::now();
+    m_occlusion.BeginFrame(m_camera.GetViewConstants().viewProj);
 
-            m_renderer.DrawMesh(*meshPtr, addr,
-                texHandle, shadowHandle, normalHandle, metalRoughHandle);
+    auto addOccluder = [&](const Mesh& mesh) {
+        const MeshAsset* asset = mesh.OccluderAsset();
+        if (!asset || asset->indices.empty()) return;
+        if (!asset->vertices.empty()) {
+            m_occlusion.AddOccluder(reinterpret_cast<const XMFLOAT3*>(&asset->vertices[0].px), sizeof(Vertex),
+                asset->indices.data(), asset->indices.size(), mesh.Transform());
+        }
+        else if (!asset->positions.empty()) {
+            m_occlusion.AddOccluder(asset->positions.data(), sizeof(XMFLOAT3),
+                asset->indices.data(), asset->indices.size(), mesh.Transform());
+        }
+    };
 
-            m_trianglesCount += meshPtr->IndexCount() / 3;
+    // Static occluders are merged into batches, so their source meshes are used instead.
+    bool hasOccluders = false;
+    for (size_t i = 0; i < m_DrawList.size(); ++i) {
+        if (m_cullResults[i] != CullResult::Outside && m_DrawList[i]->IsOccluder()) {
+            addOccluder(*m_DrawList[i]);
+            hasOccluders = true;
+        }
+    }
+    for (const Mesh* mesh : m_StaticList) {
+        if (mesh->IsOccluder() && m_frustum.Test(mesh->WorldBounds()) != CullResult::Outside) {
+            addOccluder(*mesh);
+            hasOccluders = true;
         }
     }
+    if (!hasOccluders) return;
 
-    if (!transparent.empty()) {
-        m_renderer.SetPipeline(m_alphaPipeline);
-        m_renderer.BindMainRenderTargets();
+    m_occlusion.Rasterize();
 
-        const UINT frame = m_swap.FrameIndex();
+    m_cullCandidates.clear();
+    m_cullBounds.clear();
+    for (uint32_t i = 0; i < uint32_t(m_DrawList.size()); ++i) {
+        if (m_cullResults[i] == CullResult::Outside || m_DrawList[i]->IsOccluder()) continue;
+        m_cullCandidates.push_back(i);
+        m_cullBounds.push_back(m_renderScene.Proxy(m_drawIds[i]).bounds);
+    }
+    m_occlusionVisible.resize(m_cullCandidates.size());
+    m_occlusion.Test(m_cullBounds.data(), m_cullBounds.size(), m_occlusionVisible.data());
 
-        for (auto& cmd : transparent) {
-            Mesh* meshPtr = cmd.mesh;
-            const Submesh* sm = cmd.sm;
+    for (size_t k = 0; k < m_cullCandidates.size(); ++k) {
+        if (!m_occlusionVisible[k]) {
+            m_cullResults[m_cullCandidates[k]] = CullResult::Outside;
+            ++m_cullStats.meshesOccluded;
+        }
+    }
+    m_cullStats.occlusionMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-            XMMATRIX M = meshPtr->Transform();
-            XMMATRIX V = m_camera.View();
-            XMMATRIX P = m_camera.Proj();
-            XMMATRIX VP = V * P;
+void WindowDX12::QueryRadius(DirectX::FXMVECTOR center, float radius, std::vector<const Mesh*>& out) const
+{
+    using namespace DirectX;
 
-            XMFLOAT3 camPos = m_camera.getPosition();
+    out.clear();
+    const float radiusSq = radius * radius;
+    const DynamicAABBTree& tree = m_renderScene.Tree();
+    tree.QuerySphere(center, radius, [&](int32_t leaf) {
+        const RenderProxy& proxy = m_renderScene.Proxy(m_renderScene.FromTree(leaf));
+        const BoundingBox& b = proxy.bounds;
+        const XMVECTOR c = XMLoadFloat3(&b.Center), e = XMLoadFloat3(&b.Extents);
+        const XMVECTOR closest = XMVectorClamp(center, XMVectorSubtract(c, e), XMVectorAdd(c, e));
+        if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(closest, center))) <= radiusSq)
+            out.push_back(proxy.mesh);
+    });
+}
 
-            XMVECTOR det;
-            XMMATRIX MInv = XMMatrixInverse(&det, M);
-            XMMATRIX NMat = XMMatrixTranspose(MInv);
+bool WindowDX12::Pick(float x, float y, SceneRayHit& hit) const
+{
+    using namespace DirectX;
 
-            SceneCB cb{};
-            XMStoreFloat4x4(&cb.uModel, XMMatrixTranspose(M));
-            XMStoreFloat4x4(&cb.uViewProj, XMMatrixTranspose(VP));
-            XMStoreFloat4x4(&cb.uNormalMatrix, XMMatrixTranspose(NMat));
-            cb.uCameraPos = camPos;
-            cb.uLightViewProj = m_lightViewProj;
-            cb.uLightDir = m_lightDir;
-            cb._pad0 = 0.0f;
+    const float ndcX = 2.f * x / float(m_window.GetWidth()) - 1.f;
+    const float ndcY = 1.f - 2.f * y / float(m_window.GetHeight());
+    const XMMATRIX invVP = XMMatrixInverse(nullptr, m_camera.GetViewConstants().viewProj);
+    const XMVECTOR nearPt = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.f, 1.f), invVP);
+    const XMVECTOR farPt = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.f, 1.f), invVP);
 
-            cb.uShininess = sm->shininess;
-            cb.uKs = sm->ks;
-            cb.uOpacity = sm->opacity;
-            cb.uKe = sm->ke;
-            cb._pad1 = 0.0f;
+    const XMVECTOR dir = XMVectorSubtract(farPt, nearPt);
+    const float length = XMVectorGetX(XMVector3Length(dir));
+    return m_sceneAccel.Raycast(nearPt, XMVectorScale(dir, 1.f / length), length, hit);
+}
 
-            const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
-            D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+void WindowDX12::SetCameraLookAt(DirectX::XMVECTOR eye, DirectX::XMVECTOR at, DirectX::XMVECTOR up)
+{
+    m_camera.LookAt(eye, at, up);
+    m_view = m_camera.View();
+}
 
-            Texture* tex = sm->texture ? sm->texture.get() : meshPtr->GetTexture();
-            if (!tex) tex = &getDefaultTexture();
+void WindowDX12::SetCameraPerspective(float fov, float aspect, float zn, float zf)
+{
+    m_camera.SetPerspective(fov, aspect, zn, zf);
+    m_proj = m_camera.Proj();
+}
 
-            Texture* normalTex = nullptr;
-            if (sm->hasNormalMap && sm->normalMap)
-                normalTex = sm->normalMap.get();
-            if (!normalTex)
-                normalTex = &getDefaultTexture();
+void WindowDX12::ActivateConsole()
+{
+    AllocConsole();
+    SetConsoleTitleW(L"Debug Output");
+    FILE* fp;
+    freopen_s(&fp, "CONOUT$", "w", stdout);
+    freopen_s(&fp, "CONOUT$", "w", stderr);
+}
 
-            Texture* mrTex = nullptr;
-            if (sm->hasMetalRoughMap && sm->metalRoughMap)
-                mrTex = sm->metalRoughMap.get();
-            if (!mrTex)
-                mrTex = &getDefaultTexture();
+void WindowDX12::DrawScene() {
+    using namespace DirectX;
+
+    m_renderer.SetPipeline(m_pipeline);
 
-            D3D12_GPU_DESCRIPTOR_HANDLE texHandle = tex->GPUHandle();
-            D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle = m_shadowMap.SRVGPU();
-            D3D12_GPU_DESCRIPTOR_HANDLE normalHandle = normalTex->GPUHandle();
-            D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle = mrTex->GPUHandle();
+    const ViewConstants& view = m_camera.GetViewConstants();
+    m_frustum.SetPlanes(view.frustumPlanes, 6);
+
+    CullDrawList(false, m_cullResults);
+    m_cullStats.meshesTested = uint32_t(m_DrawList.size());
+
+    m_sizeCuller.SetView(view.view, view.proj, float(m_window.GetHeight()));
+    CullSmall(false, m_cullResults);
+    if (m_occlusionEnabled) CullOccluded();
+    SelectLods(false, m_cullResults);
+    SelectImpostors(m_cullResults);
+
+    m_instanceCommands.clear();
+    m_submeshVisible.clear();
+    m_transparent.clear();
+    m_drawQueue.Clear();
+    const XMVECTOR eye = XMLoadFloat3(&view.position);
+    auto distanceTo = [&](const XMFLOAT3& p) {
+        return XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&p), eye)));
+    };
 
-            m_renderer.DrawMeshRange(*meshPtr, addr,
-                texHandle, shadowHandle, normalHandle, metalRoughHandle,
-                sm->indexStart, sm->indexCount);
+    for (size_t meshIndex = 0; meshIndex < m_DrawList.size(); ++meshIndex) {
+        const CullResult meshCull = m_cullResults[meshIndex];
+        if (meshCull == CullResult::Outside) {
+            ++m_cullStats.meshesCulled;
+            continue;
+        }
+        // Past the crossfade, the impostor drawn below replaces the mesh.
+        Mesh* meshPtr = m_DrawList[meshIndex];
+        const RenderProxy& proxy = m_renderScene.Proxy(m_drawIds[meshIndex]);
+        const float distance = distanceTo(proxy.sphere.Center);
+
+        const float impostor = m_drawImpostor[meshIndex];
+        if (impostor > 0.f) {
+            const MeshAsset* base = meshPtr->GetAsset();
+            m_drawQueue.Push(DrawQueue::OpaqueKey(kImpostorPipeline, DrawQueue::HashPointer(base),
+                DrawQueue::HashPointer(base), distance), uint32_t(meshIndex));
+        }
+        if (impostor >= 1.f) continue;
+        const float fade = m_drawFade[meshIndex] * (1.f - impostor);
+
+        const uint32_t level = m_drawLods[meshIndex];
+        const MeshAsset* asset = meshPtr->LodAsset(level);
+        if (!asset) continue;
+        if (level > 0) {
+            ++m_cullStats.meshesReduced;
+            const MeshAsset* base = meshPtr->GetAsset();
+            if (base && base->indexCount > asset->indexCount)
+                m_cullStats.trianglesSaved += (base->indexCount - asset->indexCount) / 3;
+        }
+
+        InstanceCommand command{ asset, meshPtr->GetTexture(), proxy.shininess, uint32_t(meshIndex), fade, UINT32_MAX };
+        bool opaque = asset->submeshes.empty();
+        if (!asset->submeshes.empty()) {
+            // Submeshes only need their own test when the mesh straddles the frustum. Their
+            // bounds are those of the full-detail level.
+            const size_t submeshCount = asset->submeshes.size();
+            const bool testSubmeshes = meshCull == CullResult::Intersecting && submeshCount > 1 && level == 0;
+            if (testSubmeshes) {
+                m_submeshBounds.resize(submeshCount);
+                m_submeshResults.resize(submeshCount);
+                for (size_t j = 0; j < submeshCount; ++j)
+                    m_submeshBounds[j] = meshPtr->SubmeshWorldBounds(j);
+                m_frustum.Test(m_submeshBounds.data(), submeshCount, m_submeshResults.data());
+                m_cullStats.submeshesTested += uint32_t(submeshCount);
+
+                command.submeshVisible = uint32_t(m_submeshVisible.size());
+                for (size_t j = 0; j < submeshCount; ++j) {
+                    const bool visible = m_submeshResults[j] != CullResult::Outside;
+                    if (!visible) ++m_cullStats.submeshesCulled;
+                    m_submeshVisible.push_back(visible);
+                }
+            }
+
+            for (size_t j = 0; j < submeshCount; ++j) {
+                const Submesh& sm = asset->submeshes[j];
+                if (testSubmeshes && m_submeshResults[j] == CullResult::Outside) continue;
+                if (sm.opacity >= 0.999f) {
+                    opaque = true;
+                    continue;
+                }
+                // Transparent submeshes are sorted on their own, so they blend back to front.
+                const Texture* tex = sm.texture ? sm.texture.get() : meshPtr->GetTexture();
+                m_drawQueue.Push(DrawQueue::TransparentKey(kAlphaPipeline, DrawQueue::HashPointer(tex),
+                    DrawQueue::HashPointer(asset), distanceTo(meshPtr->SubmeshWorldBounds(j).Center)),
+                    uint32_t(m_transparent.size()));
+                m_transparent.push_back({ tex, asset, &proxy, &sm, fade });
+            }
+        }
+        if (opaque) {
+            m_drawQueue.Push(DrawQueue::OpaqueKey(kMeshPipeline, DrawQueue::HashPointer(command.texture),
+                DrawQueue::HashPointer(asset), distance), uint32_t(m_instanceCommands.size()));
+            m_instanceCommands.push_back(command);
+        }
+    }
 
-            m_trianglesCount += sm->indexCount / 3;
+    // Keys start with the pass and the pipeline, so each pipeline gets one range of the queue.
+    m_drawQueue.Sort();
+    const DrawQueue::Item* items = m_drawQueue.Items().data();
+    const uint32_t itemCount = uint32_t(m_drawQueue.Size());
+    auto rangeEnd = [&](uint32_t from, uint32_t pipeline) {
+        while (from != itemCount && DrawQueue::PipelineOf(items[from].key) == pipeline) ++from;
+        return from;
+    };
+    const uint32_t meshesEnd = rangeEnd(0, kMeshPipeline);
+    const uint32_t impostorsEnd = rangeEnd(meshesEnd, kImpostorPipeline);
+    m_cullStats.meshesImpostored += impostorsEnd - meshesEnd;
+
+    // Each range is cut into chunks recorded side by side. The chunks are submitted in queue
+    // order, so draws keep their sorted order and transparent ones still blend back to front.
+    m_recordChunks.clear();
+    SplitChunks(kMeshPipeline, 0, meshesEnd, [&](uint32_t i) {
+        return !m_instanceCommands[items[i - 1].payload].SharesDrawWith(m_instanceCommands[items[i].payload]);
+    });
+    SplitChunks(kImpostorPipeline, meshesEnd, impostorsEnd, nullptr);
+    SplitChunks(kAlphaPipeline, impostorsEnd, itemCount, nullptr);
+    RecordChunks([&](CommandContext& ctx, RecordChunk& chunk) {
+        switch (chunk.pipeline) {
+        case kMeshPipeline: DrawInstanced(ctx, chunk); break;
+        case kImpostorPipeline: DrawImpostors(ctx, chunk); break;
+        default: DrawTransparent(ctx, chunk); break;
         }
+    });
+
+    // ImGui draws over the scene on the context that follows.
+    m_renderer.BindMainRenderTargets();
+}
+
+void WindowDX12::DrawTransparent(CommandContext& ctx, RecordChunk& chunk)
+{
+    using namespace DirectX;
+
+    m_renderer.BindMainRenderTargets(ctx, &m_alphaPipeline);
+
+    const ViewConstants& view = m_camera.GetViewConstants();
+    const UINT frame = m_renderer.FrameSlot();
+
+    const DrawQueue::Item* items = m_drawQueue.Items().data();
+    for (const DrawQueue::Item* item = items + chunk.begin; item != items + chunk.end; ++item) {
+        const TransparentCommand& cmd = m_transparent[item->payload];
+        const Submesh* sm = cmd.sm;
+
+        SceneCB cb{};
+        cb.uModel = cmd.proxy->model;
+        cb.uViewProj = view.viewProjTransposed;
+        cb.uNormalMatrix = cmd.proxy->normalMatrix;
+        cb.uCameraPos = view.position;
+        cb.uLightViewProj = m_lightViewProj;
+        cb.uLightDir = m_lightDir;
+        cb._pad0 = 0.0f;
+
+        cb.uShininess = cmd.proxy->shininess >= 0.f ? cmd.proxy->shininess : sm->shininess;
+        cb.uKs = sm->ks;
+        cb.uOpacity = sm->opacity;
+        cb.uKe = sm->ke;
+        cb._pad1 = 0.0f;
+        cb.uTint = cmd.proxy->tint;
+        cb.uFade = cmd.fade;
+
+        const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
+        D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+
+        UINT instance;
+        if (m_instances.Allocate(1, instance) == 0) break;
+        m_instances.Write(instance, { cmd.proxy->model, cmd.proxy->normalMatrix, cmd.proxy->tint, cmd.fade });
+
+        const Texture* tex = cmd.texture;
+        if (!tex) tex = &getDefaultTexture();
+
+        Texture* normalTex = nullptr;
+        if (sm->hasNormalMap && sm->normalMap)
+            normalTex = sm->normalMap.get();
+        if (!normalTex)
+            normalTex = &getDefaultTexture();
+
+        Texture* mrTex = nullptr;
+        if (sm->hasMetalRoughMap && sm->metalRoughMap)
+            mrTex = sm->metalRoughMap.get();
+        if (!mrTex)
+            mrTex = &getDefaultTexture();
+
+        D3D12_GPU_DESCRIPTOR_HANDLE texHandle = tex->GPUHandle();
+        D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle = m_shadowMap.SRVGPU();
+        D3D12_GPU_DESCRIPTOR_HANDLE normalHandle = normalTex->GPUHandle();
+        D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle = mrTex->GPUHandle();
+
+        m_renderer.DrawMeshInstanced(ctx, *cmd.asset, addr, m_instances.Address(instance), 1,
+            texHandle, shadowHandle, normalHandle, metalRoughHandle,
+            sm->indexStart, sm->indexCount);
+        ++chunk.drawCalls;
+
+        chunk.triangles += sm->indexCount / 3;
     }
 }
@@ -6,6 +6,8 @@
 #include "ShaderPipeline.h"
 #include "ShadowMap.h"
 #include "Renderer.h"
+#include "InstanceBuffer.h"
+#include "DrawQueue.h"
 #include "Shaders.h"
 #include "Camera.h"
 #include "Window.h"
@@ -13,7 +15,17 @@
 #include <chrono>
 #include <wrl.h>
 #include "ImGuiDx12.h"
+#include "StaticBatcher.h"
+#include "SceneAccel.h"
+#include "Culling.h"
+#include "DynamicAABBTree.h"
+#include "OcclusionCuller.h"
+#include "RenderScene.h"
+#include "TransformHierarchy.h"
+#include "JobSystem.h"
+#include <atomic>
 #include <fstream>
+#include <functional>
 
 struct SrvHandlePair {
     D3D12_CPU_DESCRIPTOR_HANDLE cpu;
@@ -36,6 +48,14 @@ public:
      */
     WindowDX12(UINT w, UINT h, const std::wstring& title);
 
+    /**
+     * @brief Destructor that waits for the frames still in flight before their resources go.
+     */
+    ~WindowDX12() noexcept {
+        try { m_gfx.WaitGPU(); }
+        catch (...) {}
+    }
+
     /**
      * @brief Creates the shader pipelines.
      */
@@ -114,8 +134,37 @@ public:
      */
     void RenderShadowPass(const std::vector<Mesh*>& meshes);
 
+    /**
+     * @brief Adds a mesh to the retained scene, drawing it every frame until removed.
+     * Only the meshes that change are processed again; the mesh must keep its address
+     * while in the scene, and is removed automatically when destroyed.
+     * @param mesh The mesh to add.
+     */
+    void AddToScene(Mesh& mesh) { m_renderScene.Add(mesh); }
+
+    /**
+     * @brief Removes a mesh from the retained scene.
+     * @param mesh The mesh to remove.
+     */
+    void RemoveFromScene(Mesh& mesh) { m_renderScene.Remove(mesh); }
+
+    /**
+     * @brief Gets the retained scene.
+     * @return A reference to the render scene.
+     */
+    const RenderScene& GetRenderScene() const { return m_renderScene; }
+
+    /**
+     * @brief Gets the parent/child links between meshes, updated at the start of Display.
+     * @return A reference to the transform hierarchy.
+     */
+    TransformHierarchy& GetHierarchy() { return m_hierarchy; }
+
     /**
      * @brief Adds a mesh to the draw list for the current frame.
+     * Static meshes with a single level of detail are merged into per-material batches
+     * instead of being drawn one by one.
+     * Meshes already in the retained scene are ignored, as they are drawn anyway.
      * @param mesh The mesh to draw.
      */
     void Draw(const Mesh& mesh);
@@ -150,6 +199,143 @@ public:
         return m_camera.getPosition();
     }
 
+    /**
+     * @brief Gets the acceleration structure over the meshes drawn in the last frame.
+     * Use it for ray picks, overlap and nearest-object queries between frames.
+     * @return A reference to the scene acceleration structure.
+     */
+    const SceneAccel& GetScene() const { return m_sceneAccel; }
+
+    /**
+     * @brief Finds the mesh under a point of the window.
+     * @param x The x-coordinate in client pixels.
+     * @param y The y-coordinate in client pixels.
+     * @param hit Receives the closest mesh hit.
+     * @return True if a mesh was hit.
+     */
+    bool Pick(float x, float y, SceneRayHit& hit) const;
+
+    /**
+     * @brief Gets the frustum culling counts of the last frame.
+     * @return The culling statistics.
+     */
+    const CullingStats& GetCullingStats() const { return m_cullStats; }
+
+    /**
+     * @brief Enables or disables occlusion culling against the meshes marked as occluders.
+     * @param enable True to enable occlusion culling.
+     */
+    void setOcclusionCulling(bool enable) { m_occlusionEnabled = enable; }
+
+    /**
+     * @brief Enables or disables reusing frustum results from earlier frames.
+     * The scene tree settles most objects; when enabled, those it leaves on the edge of the
+     * view keep their exact result until the view moved enough to change it, or for a few frames.
+     * @param enable True to reuse results.
+     */
+    void setTemporalCulling(bool enable) { m_temporalCulling = enable; }
+
+    /**
+     * @brief Sets how many frames a frustum result may be reused before it is tested again.
+     * @param frames The number of frames, up to CullHistory::kMaxAge.
+     */
+    void setCullReuseFrames(uint32_t frames) {
+        m_cullHistory[0].SetMaxAge(frames);
+        m_cullHistory[1].SetMaxAge(frames);
+    }
+
+    /**
+     * @brief Enables or disables recording the passes on several threads.
+     * When enabled, the shadow pass and the main pass are split into chunks, each recorded
+     * by a worker of JobSystem on a command list of its own; the lists are submitted in
+     * draw order either way.
+     * @param enable True to record in parallel.
+     */
+    void setParallelRecording(bool enable) { m_parallelRecording = enable; }
+
+    /**
+     * @brief Sets the number of frames the CPU may record ahead of the GPU.
+     * More frames hide GPU latency at the cost of input latency; the CPU only waits when
+     * it is about to reuse the constants, instances and allocators of a frame still in flight.
+     * @param count The frame count, clamped to [1, kMaxFramesInFlight].
+     */
+    void setFramesInFlight(uint32_t count) { m_renderer.SetFramesInFlight(count); }
+
+    /**
+     * @brief Sets the projected size under which meshes are not drawn.
+     * Meshes can override it with Mesh::SetMinScreenSize.
+     * @param pixels The minimum diameter in pixels; zero disables the test.
+     */
+    void setMinScreenSize(float pixels) { m_minScreenSize = pixels; }
+
+    /**
+     * @brief Sets the projected size in the shadow map under which meshes cast no shadow.
+     * Meshes can override it with Mesh::SetMinShadowScreenSize.
+     * @param texels The minimum diameter in shadow map texels; zero disables the test.
+     */
+    void setMinShadowScreenSize(float texels) { m_minShadowScreenSize = texels; }
+
+    /**
+     * @brief Sets how much a dropped mesh must grow past the size threshold to be drawn again.
+     * @param fraction The fraction of the threshold, e.g. 0.25 for 25%.
+     */
+    void setScreenSizeHysteresis(float fraction) { m_screenSizeHysteresis = fraction; }
+
+    /**
+     * @brief Enables or disables the dithered fade of meshes approaching the size threshold.
+     * When enabled, a mesh fades out between twice the threshold and the threshold.
+     * @param enable True to fade meshes out instead of popping them.
+     */
+    void setScreenSizeFade(bool enable) { m_screenSizeFade = enable; }
+
+    /**
+     * @brief Sets the largest geometric error allowed on screen when picking a level of detail.
+     * @param pixels The error in pixels; meshes are drawn at the coarsest level under it.
+     */
+    void setLodErrorThreshold(float pixels) { m_lodErrorThreshold = pixels; }
+
+    /**
+     * @brief Shifts every level of detail choice towards coarser or finer levels.
+     * @param bias Each unit doubles the allowed error; negative values favor detail.
+     */
+    void setLodBias(float bias) { m_lodBias = bias; }
+
+    /**
+     * @brief Sets the extra bias applied to the shadow pass, on top of the global one.
+     * Shadows blur small details away, so shadow casters can use coarser levels.
+     * @param bias Each unit doubles the allowed error, in shadow map texels.
+     */
+    void setShadowLodBias(float bias) { m_shadowLodBias = bias; }
+
+    /**
+     * @brief Sets the margin around level of detail transitions.
+     * @param fraction The fraction of the threshold, e.g. 0.25 for 25%.
+     */
+    void setLodHysteresis(float fraction) { m_lodHysteresis = fraction; }
+
+    /**
+     * @brief Sets the distance beyond which detailed meshes are drawn as impostors, quads
+     * showing pre-rendered views of the mesh. Meshes can override it with
+     * Mesh::SetImpostorDistance.
+     * @param distance The distance from the camera in world units; zero disables impostors.
+     */
+    void setImpostorDistance(float distance) { m_impostorDistance = distance; }
+
+    /**
+     * @brief Sets the length of the dithered crossfade between a mesh and its impostor.
+     * @param fraction The fraction of the impostor distance, e.g. 0.25 for a crossfade
+     * from the distance to 1.25 times the distance.
+     */
+    void setImpostorBlend(float fraction) { m_impostorBlend = fraction; }
+
+    /**
+     * @brief Finds the meshes drawn in the last frame whose bounds overlap a sphere.
+     * @param center The sphere center.
+     * @param radius The sphere radius.
+     * @param out Receives the meshes; cleared first.
+     */
+    void QueryRadius(DirectX::FXMVECTOR center, float radius, std::vector<const Mesh*>& out) const;
+
     /**
      * @brief Gets the D3D12 device.
      * @return A pointer to the ID3D12Device.
@@ -170,6 +356,11 @@ public:
 private:
     inline static std::shared_ptr<Texture> m_whitePtr;
     static constexpr UINT kMaxDrawsPerFrame = 19000;
+    static constexpr UINT kMaxInstancesPerFrame = 32768;
+    /** Smallest share of a pass given its own command list when recording in parallel. */
+    static constexpr uint32_t kMinDrawsPerChunk = 256;
+    /** Width of the CPU depth buffer used for occlusion culling, in pixels. */
+    static constexpr UINT kOcclusionWidth = 256;
 
     Window          m_window;
     GraphicsDevice  m_gfx;
@@ -179,10 +370,12 @@ private:
     ShaderPipeline  m_pipeline;
     ShaderPipeline  m_shadowPipeline;
     ShaderPipeline  m_alphaPipeline;
+    ShaderPipeline  m_impostorPipeline;
     ShadowMap       m_shadowMap;
 
     ConstantBuffer  m_cb{};
-    UINT            m_drawCursor = 0;
+    /** Next constant buffer slice of the frame, taken by the recording threads. */
+    std::atomic<UINT> m_drawCursor{ 0 };
 
     Camera           m_camera;
     CameraController m_camController;
@@ -200,10 +393,132 @@ private:
     DirectX::XMFLOAT3   m_lightDir{};
 
 	std::vector<Mesh*> m_DrawList;
+    std::vector<const Mesh*> m_StaticList;
+    StaticBatcher m_staticBatcher;
+    SceneAccel m_sceneAccel;
+
+    FrustumCuller m_frustum;
+    FrustumCuller m_lightFrustum;
+    CullingStats m_cullStats;
+    std::vector<DirectX::BoundingBox> m_cullBounds;
+    std::vector<CullResult> m_cullResults;
+    std::vector<DirectX::BoundingBox> m_submeshBounds;
+    std::vector<CullResult> m_submeshResults;
+    std::shared_ptr<TextItem> m_cullText;
+
+    RenderScene m_renderScene;
+    TransformHierarchy m_hierarchy;
+    std::shared_ptr<TextItem> m_sceneText;
+    std::shared_ptr<TextItem> m_frameText;
+    /** Render proxy of each entry of m_DrawList. */
+    std::vector<uint32_t> m_drawIds;
+    std::vector<std::pair<uint32_t, uint32_t>> m_duplicateDraws;
+    std::vector<uint32_t> m_cullCandidates;
+    std::vector<CullResult> m_candidateResults;
+    std::vector<float> m_candidateMargins;
+    /** Viewpoints of the main pass and the shadow pass in the last frames. */
+    CullHistory m_cullHistory[2];
+    bool m_temporalCulling = true;
+    uint64_t m_frameNumber = 0;
+
+    OcclusionCuller m_occlusion;
+    std::vector<uint8_t> m_occlusionVisible;
+    bool m_occlusionEnabled = true;
+
+    ScreenSizeCuller m_sizeCuller;
+    ScreenSizeCuller m_lightSizeCuller;
+    std::vector<float> m_drawFade;
+    float m_minScreenSize = 4.f;
+    float m_minShadowScreenSize = 2.f;
+    float m_screenSizeHysteresis = 0.25f;
+    bool m_screenSizeFade = true;
+
+    std::vector<uint8_t> m_drawLods;
+    std::vector<uint8_t> m_shadowLods;
+    float m_lodErrorThreshold = 1.f;
+    float m_lodBias = 0.f;
+    float m_shadowLodBias = 1.f;
+    float m_lodHysteresis = 0.25f;
+    std::shared_ptr<TextItem> m_lodText;
+
+    /** Crossfade of each draw list entry towards its impostor: 0 draws the mesh only, 1 the impostor only. */
+    std::vector<float> m_drawImpostor;
+    std::shared_ptr<MeshAsset> m_impostorQuad;
+    float m_impostorDistance = 60.f;
+    float m_impostorBlend = 0.25f;
+    /** Index of the first static batch in m_DrawList. */
+    size_t m_batchStart = 0;
+
+    /** A visible mesh, drawn with the other meshes sharing its geometry and texture. */
+    struct InstanceCommand {
+        const MeshAsset* asset;
+        Texture* texture;
+        /** Shininess of the mesh, or a negative value to use the materials' own. */
+        float shininess;
+        uint32_t meshIndex;
+        float fade;
+        /** Offset of the mesh's flags in m_submeshVisible, or UINT32_MAX if no submesh was culled. */
+        uint32_t submeshVisible;
+
+        /** Commands drawn together share their geometry, texture and shininess. */
+        bool SharesDrawWith(const InstanceCommand& other) const {
+            return asset == other.asset && texture == other.texture && shininess == other.shininess;
+        }
+    };
+    /** A transparent submesh, drawn on its own after the opaque meshes. */
+    struct TransparentCommand {
+        const Texture* texture;
+        const MeshAsset* asset;
+        const RenderProxy* proxy;
+        const Submesh* sm;
+        float fade;
+    };
+    std::vector<InstanceCommand> m_instanceCommands;
+    std::vector<uint8_t> m_submeshVisible;
+    std::vector<TransparentCommand> m_transparent;
+    /** Draws of the main pass; payloads index m_instanceCommands, m_DrawList or m_transparent by pipeline. */
+    DrawQueue m_drawQueue;
+    InstanceBuffer m_instances;
+    /** Mesh draw calls of the main pass in the last frame. */
+    uint32_t m_drawCalls = 0;
+
+    /** A shadow caster that passed culling, gathered before the shadow pass is recorded. */
+    struct ShadowCaster {
+        const MeshAsset* asset;
+        DirectX::XMFLOAT4X4 model;
+    };
+    /** A range of a pass recorded on a command list of its own, and what it drew. */
+    struct RecordChunk {
+        /** DrawPipeline of the range in the main pass; unused in the shadow pass. */
+        uint32_t pipeline;
+        /** Range of m_drawQueue items, or of m_shadowCasters. */
+        uint32_t begin;
+        uint32_t end;
+        uint32_t drawCalls;
+        uint32_t triangles;
+    };
+    std::vector<ShadowCaster> m_shadowCasters;
+    std::vector<RecordChunk> m_recordChunks;
+    bool m_parallelRecording = true;
+    /** Time spent recording draws in the last frame, in milliseconds. */
+    float m_recordMs = 0.f;
 
     std::chrono::steady_clock::time_point m_t0 = std::chrono::steady_clock::now();
     float dt = 0.0f;
     mutable uint32_t m_trianglesCount = 0;
 
     void DrawScene();
+    void SyncRenderScene();
+    void CullDrawList(bool shadowPass, std::vector<CullResult>& results);
+    void CullOccluded();
+    void ResizeOcclusion(UINT width, UINT height);
+    void CullSmall(bool shadowPass, std::vector<CullResult>& results);
+    void SelectLods(bool shadowPass, const std::vector<CullResult>& results);
+    void SelectImpostors(const std::vector<CullResult>& results);
+    const ImpostorAtlas* ImpostorFor(const MeshAsset& asset);
+    void SplitChunks(uint32_t pipeline, uint32_t begin, uint32_t end, const std::function<bool(uint32_t)>& canSplitAt);
+    void RecordChunks(const std::function<void(CommandContext&, RecordChunk&)>& record);
+    void DrawInstanced(CommandContext& ctx, RecordChunk& chunk);
+    void DrawImpostors(CommandContext& ctx, RecordChunk& chunk);
+    void DrawTransparent(CommandContext& ctx, RecordChunk& chunk);
 };
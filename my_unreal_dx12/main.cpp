@@ -40,33 +40,52 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
     win.setWindowTitle(L"My ruru");
     srand(static_cast<unsigned int>(time(nullptr)));
 
+    MeshCleanupOptions cleanup;
+    cleanup.enabled = true;
+    ResourceCache::I().setMeshCleanup(cleanup);
+    ResourceCache::I().setDefaultRetention(CpuRetention::PositionsOnly);
+
     Mesh floor = Mesh::CreatePlane(100.0f, 100.0f, 2, 2);
     floor.SetPosition(0.f, -5.f, 0.f);
     floor.SetColor(0.3f, 0.0f, 0.1f);
+    floor.SetStatic(true);
+    floor.SetOccluder(true);
 
     std::vector<std::shared_ptr<Mesh>> geometricsMeshes;
 
     auto cubeMesh = std::make_shared<Mesh>(Mesh::CreateCube(2.0f));
     cubeMesh->SetPosition(10.f, 0.f, 0.f);
+    cubeMesh->SetStatic(true);
+    cubeMesh->SetOccluder(true);
     geometricsMeshes.push_back(cubeMesh);
 
     auto cubeMesh2 = std::make_shared<Mesh>(Mesh::CreateCube(2.0f));
     cubeMesh2->SetPosition(12.f, 0.f, 0.f);
+    cubeMesh2->SetStatic(true);
+    cubeMesh2->SetOccluder(true);
     geometricsMeshes.push_back(cubeMesh2);
 
     auto sphereMesh = std::make_shared<Mesh>(Mesh::CreateSphere(1.0f, 16, 16));
     sphereMesh->SetPosition(-10.f, 0.f, 0.f);
+    sphereMesh->SetStatic(true);
     geometricsMeshes.push_back(sphereMesh);
 
     auto cylinderMesh = std::make_shared<Mesh>(Mesh::CreateCylinder(1.0f, 2.0f, 16));
     cylinderMesh->SetPosition(0.f, 0.f, 10.f);
+    cylinderMesh->SetStatic(true);
     geometricsMeshes.push_back(cylinderMesh);
 
     auto coneMesh = std::make_shared<Mesh>(Mesh::CreateCone(1.0f, 2.0f, 1600, true));
     coneMesh->SetPosition(0.f, 0.f, -10.f);
+    coneMesh->SetStatic(true);
     geometricsMeshes.push_back(coneMesh);
 
+    win.AddToScene(floor);
+    for (auto& g : geometricsMeshes)
+        win.AddToScene(*g);
+
     std::vector<std::shared_ptr<Mesh>> weapons;
+    std::vector<std::shared_ptr<Mesh>> attachments;
 
     auto meshDraw = win.getImGui().addText("Mesh: 0");
     win.getImGui().AddButton("Add 1 Test wall", [&weapons, &win, meshDraw]() {
@@ -76,11 +95,12 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
                 ((rand() % 100) / 100.f - 0.5f) * 50.f,
 				((rand() % 100) / 100.f) * 50.f
             );
+            win.AddToScene(*weapon);
             weapons.push_back(std::move(weapon));
             meshDraw->setText("Mesh: %u", (unsigned)weapons.size());
         }
     );
-    win.getImGui().AddButton("Add 1 Fighters Jets", [&weapons, &win, meshDraw]() {
+    win.getImGui().AddButton("Add 1 Fighters Jets", [&weapons, &attachments, &win, meshDraw]() {
         for (int lh = 1; lh--;) {
             std::shared_ptr<Mesh> weapon = std::make_shared<Mesh>("mirage2000/scene.obj");
             weapon->SetPosition(
@@ -88,6 +108,19 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
                 ((rand() % 100) / 100.f) * 10.f,
 				((rand() % 100) / 100.f - 0.5f) * 10.f
             );
+            win.AddToScene(*weapon);
+
+            // Missiles under the wings follow the jet without any per-frame code.
+            const auto jetNode = win.GetHierarchy().Attach(*weapon);
+            for (float side : { -1.f, 1.f }) {
+                auto missile = std::make_shared<Mesh>(Mesh::CreateCylinder(0.08f, 1.2f, 8));
+                missile->SetPosition(side * 1.2f, -0.3f, 0.f);
+                missile->SetRotationPitch(90.f);
+                missile->SetColor(0.8f, 0.8f, 0.8f);
+                win.GetHierarchy().Attach(*missile, jetNode);
+                win.AddToScene(*missile);
+                attachments.push_back(std::move(missile));
+            }
             weapons.push_back(std::move(weapon));
             meshDraw->setText("Mesh: %u", (unsigned)weapons.size());
         }
@@ -112,6 +145,7 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
     win.getImGui().addSeparator();
 
     auto triangleText = win.getImGui().addText("Triangles: 0");
+    auto cpuSavedText = win.getImGui().addText("CPU geometry released: 0 MB");
 
     std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
     auto msFrame = win.getImGui().addText("Frame Time: 0 ms");
@@ -120,20 +154,13 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
     {
         uint32_t trianglesLastFrame = win.Clear();
 
-        for (auto& w : weapons)
-            win.Draw(*w);
-
-        win.Draw(floor);
-
-        for (auto& g : geometricsMeshes)
-            win.Draw(*g);
-
         auto currentTime = std::chrono::steady_clock::now();
         auto frameDuration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastTime).count();
         lastTime = currentTime;
 
         msFrame->setText("Frame Time: %lld ms", frameDuration);
         triangleText->setText("Triangles: %u", trianglesLastFrame);
+        cpuSavedText->setText("CPU geometry released: %.1f MB", ResourceCache::I().cpuBytesSaved() / (1024.0 * 1024.0));
 
         win.Display();
     }
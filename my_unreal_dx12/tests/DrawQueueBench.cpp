@@ -0,0 +1,86 @@
+// Sorts 100k draw keys with DrawQueue and reports the time against the 1 ms budget.
+// Fails if the result is not ordered, or not stable.
+#include "DrawQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kDraws = 100000;
+    constexpr int kRuns = 50;
+    constexpr double kBudgetMs = 1.0;
+
+    struct Result {
+        double averageMs = 0.0;
+        double bestMs = 1e30;
+    };
+
+    // Sorts the same keys several times and checks the last result.
+    Result Measure(const std::vector<uint64_t>& keys, bool& ordered) {
+        DrawQueue queue;
+        Result result;
+        for (int run = 0; run < kRuns + 1; ++run) {
+            queue.Clear();
+            for (uint32_t i = 0; i < uint32_t(keys.size()); ++i) queue.Push(keys[i], i);
+
+            const auto start = std::chrono::steady_clock::now();
+            queue.Sort();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            // The first run also allocates the scratch buffers.
+            if (run == 0) continue;
+            result.averageMs += ms / kRuns;
+            result.bestMs = std::min(result.bestMs, ms);
+        }
+
+        const auto& items = queue.Items();
+        ordered = items.size() == keys.size();
+        for (size_t i = 1; ordered && i < items.size(); ++i) {
+            if (items[i - 1].key > items[i].key) ordered = false;
+            if (items[i - 1].key == items[i].key && items[i - 1].payload > items[i].payload) ordered = false;
+        }
+        return result;
+    }
+
+    void Report(const char* name, const Result& r) {
+        std::cout << "  " << name << ": " << r.averageMs << " ms average, " << r.bestMs << " ms best (budget "
+                  << kBudgetMs << " ms: " << (r.averageMs < kBudgetMs ? "met" : "NOT met") << ")\n";
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<float> depth(0.5f, 500.f);
+
+    // Every field random: no digit can be skipped.
+    std::vector<uint64_t> randomKeys(kDraws);
+    for (uint64_t& key : randomKeys) key = rng();
+
+    // A frame-like mix: two pipelines, a few hundred materials and meshes, spread in depth.
+    std::uniform_int_distribution<uint32_t> material(0, 299), mesh(0, 999), pipeline(0, 1);
+    std::vector<uint64_t> sceneKeys(kDraws);
+    for (uint64_t& key : sceneKeys) {
+        key = DrawQueue::OpaqueKey(pipeline(rng), DrawQueue::HashPointer(reinterpret_cast<void*>(uintptr_t(material(rng) + 1) * 64)),
+            mesh(rng), depth(rng));
+    }
+    // Keys with many duplicates check that equal keys keep their order.
+    std::vector<uint64_t> duplicateKeys(kDraws);
+    for (uint64_t& key : duplicateKeys) key = DrawQueue::OpaqueKey(0, material(rng) % 8, 0, 1.f);
+
+    bool ok = true, ordered = false;
+    std::cout << "DrawQueue: sorting " << kDraws << " keys\n";
+    Report("random keys", Measure(randomKeys, ordered));
+    ok &= ordered;
+    Report("scene keys", Measure(sceneKeys, ordered));
+    ok &= ordered;
+    Report("duplicate keys", Measure(duplicateKeys, ordered));
+    ok &= ordered;
+
+    if (!ok) {
+        std::cout << "[Error]: the sorted draws are out of order\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Moves 10k objects through a DynamicAABBTree every frame and reports the update time
+// against the 1 ms budget. Fails if a box query misses an object.
+#include "DynamicAABBTree.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace {
+    constexpr uint32_t kObjects = 10000;
+    constexpr int kWarmupFrames = 20;
+    constexpr int kFrames = 300;
+    constexpr float kWorldHalfSize = 200.f;
+    constexpr float kFrameTime = 1.f / 60.f;
+    constexpr double kBudgetMs = 1.0;
+
+    struct Object {
+        BoundingBox box;
+        XMFLOAT3 velocity;
+        int32_t proxy;
+    };
+
+    // Moves an object for one frame, bouncing off the world bounds.
+    XMVECTOR Step(Object& o) {
+        float* c = &o.box.Center.x;
+        float* v = &o.velocity.x;
+        XMFLOAT3 d;
+        float* dp = &d.x;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float next = c[axis] + v[axis] * kFrameTime;
+            if (next < -kWorldHalfSize || next > kWorldHalfSize) v[axis] = -v[axis];
+            dp[axis] = v[axis] * kFrameTime;
+            c[axis] += dp[axis];
+        }
+        return XMLoadFloat3(&d);
+    }
+
+    bool Overlaps(const BoundingBox& a, const BoundingBox& b) {
+        const float* ac = &a.Center.x; const float* ae = &a.Extents.x;
+        const float* bc = &b.Center.x; const float* be = &b.Extents.x;
+        for (int axis = 0; axis < 3; ++axis)
+            if (std::abs(ac[axis] - bc[axis]) > ae[axis] + be[axis]) return false;
+        return true;
+    }
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-kWorldHalfSize, kWorldHalfSize);
+    std::uniform_real_distribution<float> extent(0.25f, 2.f);
+    std::uniform_real_distribution<float> speed(-10.f, 10.f);
+
+    DynamicAABBTree tree;
+    std::vector<Object> objects(kObjects);
+    for (uint32_t i = 0; i < kObjects; ++i) {
+        Object& o = objects[i];
+        o.box.Center = { position(rng), position(rng), position(rng) };
+        const float e = extent(rng);
+        o.box.Extents = { e, e, e };
+        o.velocity = { speed(rng), speed(rng), speed(rng) };
+        o.proxy = tree.CreateProxy(o.box, reinterpret_cast<void*>(uintptr_t(i)));
+    }
+
+    double totalMs = 0.0, worstMs = 0.0;
+    uint64_t reinserted = 0;
+    for (int frame = 0; frame < kWarmupFrames + kFrames; ++frame) {
+        const auto start = std::chrono::steady_clock::now();
+        uint32_t moved = 0;
+        for (Object& o : objects) {
+            const XMVECTOR displacement = Step(o);
+            moved += tree.MoveProxy(o.proxy, o.box, displacement);
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (frame < kWarmupFrames) continue;
+        totalMs += ms;
+        worstMs = std::max(worstMs, ms);
+        reinserted += moved;
+    }
+
+    // The fat bounds may report extra proxies, but never miss one.
+    const BoundingBox query({ 0.f, 0.f, 0.f }, { 60.f, 60.f, 60.f });
+    std::vector<uint8_t> reported(kObjects, 0);
+    tree.QueryBox(query, [&](int32_t proxy) {
+        reported[uintptr_t(tree.GetUserData(proxy))] = 1;
+    });
+    uint32_t missed = 0;
+    for (uint32_t i = 0; i < kObjects; ++i)
+        if (Overlaps(objects[i].box, query) && !reported[i]) ++missed;
+
+    const double averageMs = totalMs / kFrames;
+    std::cout << "DynamicAABBTree: " << kObjects << " moving objects, " << reinserted / kFrames
+              << " reinserted per frame, height " << tree.Height() << "\n";
+    std::cout << "  update: " << averageMs << " ms average, " << worstMs << " ms worst (budget "
+              << kBudgetMs << " ms: " << (averageMs < kBudgetMs ? "met" : "NOT met") << ")\n";
+    if (missed) {
+        std::cout << "[Error]: the box query missed " << missed << " objects\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Drives FrameFenceRing with a fake fence whose GPU only progresses when the test says so.
+#include "FrameFenceRing.h"
+#include <cstdint>
+#include <deque>
+#include <iostream>
+
+namespace {
+    int g_failures = 0;
+
+    void Check(bool condition, const char* what) {
+        if (condition) return;
+        std::cout << "[Error]: " << what << "\n";
+        ++g_failures;
+    }
+
+    /** Fence of a fake queue: signals complete in order, when the GPU steps or is waited on. */
+    struct FakeFence
+    {
+        uint64_t lastSignaled = 0;
+        uint64_t completed = 0;
+        std::deque<uint64_t> pending;
+        uint32_t waits = 0;
+        uint64_t lastWaitValue = 0;
+
+        uint64_t Signal() { pending.push_back(++lastSignaled); return lastSignaled; }
+        uint64_t CompletedValue() { return completed; }
+        void WaitFor(uint64_t value) {
+            ++waits;
+            lastWaitValue = value;
+            while (completed < value) Step();
+        }
+        // Lets the GPU finish the oldest pending frame.
+        void Step() {
+            if (pending.empty()) return;
+            completed = pending.front();
+            pending.pop_front();
+        }
+        uint64_t InFlight() const { return lastSignaled - completed; }
+    };
+
+    using Ring = FrameFenceRing<FakeFence>;
+
+    void FrameCountIsClamped() {
+        FakeFence fence;
+        Ring ring;
+        ring.Initialize(&fence, 0);
+        Check(ring.FrameCount() == 1, "zero frames in flight clamps to one");
+        ring.SetFrameCount(Ring::kMaxFrames + 5);
+        Check(ring.FrameCount() == Ring::kMaxFrames, "too many frames in flight clamps to kMaxFrames");
+        ring.SetFrameCount(2);
+        Check(ring.FrameCount() == 2, "a valid frame count is kept");
+    }
+
+    void EndFrameSignalsItsSlot() {
+        FakeFence fence;
+        Ring ring;
+        ring.Initialize(&fence, 3);
+        for (uint32_t frame = 0; frame < 7; ++frame) {
+            const uint32_t slot = ring.BeginFrame();
+            Check(slot == frame % 3 && ring.Slot() == slot, "frames cycle through the slots");
+            uint64_t before[Ring::kMaxFrames];
+            for (uint32_t s = 0; s < Ring::kMaxFrames; ++s) before[s] = ring.SlotValue(s);
+
+            ring.EndFrame();
+            Check(ring.SlotValue(slot) == fence.lastSignaled, "EndFrame stores the new signal in the frame's slot");
+            for (uint32_t s = 0; s < Ring::kMaxFrames; ++s)
+                if (s != slot) Check(ring.SlotValue(s) == before[s], "EndFrame leaves the other slots alone");
+            fence.Step();
+        }
+    }
+
+    void WaitsOnlyForBusySlots() {
+        for (uint32_t count = 1; count <= Ring::kMaxFrames; ++count) {
+            // The GPU never progresses on its own: the CPU runs count frames ahead, then every
+            // frame waits for the one recorded count frames earlier.
+            FakeFence fence;
+            Ring ring;
+            ring.Initialize(&fence, count);
+            for (uint32_t frame = 0; frame < 12; ++frame) {
+                const uint32_t slot = ring.BeginFrame();
+                const uint32_t waitsBefore = fence.waits;
+                Check(ring.Waited() == (frame >= count), "only a slot with pending work waits");
+                Check(fence.completed >= ring.SlotValue(slot), "a slot is reused once its frame completed");
+                if (ring.Waited()) Check(fence.lastWaitValue == ring.SlotValue(slot), "the wait targets the slot's own value");
+                ring.EndFrame();
+                Check(fence.InFlight() <= count, "no more frames in flight than the frame count");
+                Check(fence.waits == waitsBefore, "EndFrame does not wait");
+            }
+        }
+
+        // A slot whose value equals the completed value is free.
+        FakeFence fence;
+        Ring ring;
+        ring.Initialize(&fence, 2);
+        ring.BeginFrame();
+        ring.EndFrame();
+        ring.BeginFrame();
+        ring.EndFrame();
+        fence.Step();
+        Check(fence.completed == ring.SlotValue(0), "the first frame completed");
+        ring.BeginFrame();
+        Check(!ring.Waited() && fence.waits == 0, "a slot at the completed value does not wait");
+        ring.EndFrame();
+        ring.BeginFrame();
+        Check(ring.Waited() && fence.waits == 1, "a slot above the completed value waits");
+    }
+
+    void FrameCountChangesKeepSlotsSafe() {
+        FakeFence fence;
+        Ring ring;
+        ring.Initialize(&fence, 3);
+        for (uint32_t frame = 0; frame < 30; ++frame) {
+            if (frame == 7) ring.SetFrameCount(2);
+            if (frame == 17) ring.SetFrameCount(3);
+            if (frame == 23) ring.SetFrameCount(1);
+            const uint32_t slot = ring.BeginFrame();
+            Check(slot < ring.FrameCount(), "the slot is within the frame count");
+            Check(fence.completed >= ring.SlotValue(slot), "a slot is reused once its frame completed");
+            ring.EndFrame();
+            Check(fence.InFlight() <= Ring::kMaxFrames, "no more than kMaxFrames in flight");
+        }
+        ring.WaitIdle();
+        Check(fence.completed == fence.lastSignaled, "WaitIdle drains the queue");
+    }
+}
+
+int main() {
+    FrameCountIsClamped();
+    EndFrameSignalsItsSlot();
+    WaitsOnlyForBusySlots();
+    FrameCountChangesKeepSlotsSafe();
+
+    if (g_failures) return 1;
+    std::cout << "FrameFenceRing: all checks passed\n";
+    return 0;
+}
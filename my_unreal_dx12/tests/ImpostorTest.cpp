@@ -0,0 +1,147 @@
+// Checks the octahedral frame mapping of the impostor baker and the layout of a baked atlas.
+#include "Impostor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace {
+    int g_failures = 0;
+
+    void Check(bool condition, const char* what, uint32_t x = 0, uint32_t y = 0) {
+        if (condition) return;
+        std::cout << "[Error]: " << what << " (frame " << x << ", " << y << ")\n";
+        ++g_failures;
+    }
+
+    // Unit octahedron with one face per octant. Each face is colored by the signs of its
+    // octant, one channel per axis, so a texel tells which side of the asset it shows.
+    void MakeOctahedron(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<XMFLOAT3>& colors) {
+        for (int octant = 0; octant < 8; ++octant) {
+            const float sx = (octant & 1) ? 1.f : -1.f;
+            const float sy = (octant & 2) ? 1.f : -1.f;
+            const float sz = (octant & 4) ? 1.f : -1.f;
+            const float corners[3][3] = { { sx, 0.f, 0.f }, { 0.f, sy, 0.f }, { 0.f, 0.f, sz } };
+            const float n = 1.f / std::sqrt(3.f);
+            for (const auto& c : corners) {
+                Vertex v{};
+                v.px = c[0]; v.py = c[1]; v.pz = c[2];
+                v.nx = sx * n; v.ny = sy * n; v.nz = sz * n;
+                v.r = v.g = v.b = 1.f;
+                indices.push_back(uint32_t(vertices.size()));
+                vertices.push_back(v);
+            }
+            colors.push_back({ sx > 0.f ? 1.f : 0.f, sy > 0.f ? 1.f : 0.f, sz > 0.f ? 1.f : 0.f });
+        }
+    }
+
+    void CheckMapping(uint32_t frames) {
+        // Every frame direction maps back to the center of its frame.
+        for (uint32_t y = 0; y < frames; ++y) {
+            for (uint32_t x = 0; x < frames; ++x) {
+                const XMVECTOR d = ImpostorBaker::FrameDirection(x, y, frames);
+                Check(std::fabs(XMVectorGetX(XMVector3Length(d)) - 1.f) < 1e-5f, "frame direction is normalized", x, y);
+                const XMFLOAT2 g = ImpostorBaker::DirectionToGrid(d, frames);
+                Check(std::fabs(g.x - float(x)) < 1e-3f && std::fabs(g.y - float(y)) < 1e-3f,
+                    "frame direction maps back to its frame", x, y);
+
+                XMVECTOR right, up;
+                ImpostorBaker::FrameBasis(d, right, up);
+                const bool orthonormal =
+                    std::fabs(XMVectorGetX(XMVector3Dot(right, up))) < 1e-4f
+                    && std::fabs(XMVectorGetX(XMVector3Dot(right, d))) < 1e-4f
+                    && std::fabs(XMVectorGetX(XMVector3Dot(up, d))) < 1e-4f
+                    && std::fabs(XMVectorGetX(XMVector3Length(right)) - 1.f) < 1e-4f
+                    && std::fabs(XMVectorGetX(XMVector3Length(up)) - 1.f) < 1e-4f;
+                Check(orthonormal, "frame basis is orthonormal", x, y);
+            }
+        }
+
+        // Any direction lands on the grid, in the frame whose view is closest to it.
+        std::mt19937 rng(7);
+        std::normal_distribution<float> gauss;
+        for (int i = 0; i < 2000; ++i) {
+            const XMVECTOR d = XMVector3Normalize(XMVectorSet(gauss(rng), gauss(rng), gauss(rng), 0.f));
+            const XMFLOAT2 g = ImpostorBaker::DirectionToGrid(d, frames);
+            const float hi = float(frames) - 0.5f;
+            Check(g.x >= -0.5f && g.x <= hi && g.y >= -0.5f && g.y <= hi, "grid coordinates stay on the atlas");
+
+            const uint32_t fx = uint32_t(std::min(std::max(std::lround(g.x), 0l), long(frames - 1)));
+            const uint32_t fy = uint32_t(std::min(std::max(std::lround(g.y), 0l), long(frames - 1)));
+            const XMVECTOR view = ImpostorBaker::FrameDirection(fx, fy, frames);
+
+            // The direction is no farther from the view of its frame than the views of the
+            // neighbouring frames are.
+            float minNeighbourCos = 1.f;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int nx = std::min(std::max(int(fx) + dx, 0), int(frames) - 1);
+                    const int ny = std::min(std::max(int(fy) + dy, 0), int(frames) - 1);
+                    const float c = XMVectorGetX(XMVector3Dot(view, ImpostorBaker::FrameDirection(nx, ny, frames)));
+                    minNeighbourCos = std::min(minNeighbourCos, c);
+                }
+            }
+            const float cosToFrame = XMVectorGetX(XMVector3Dot(d, view));
+            Check(cosToFrame >= minNeighbourCos - 1e-4f, "direction is close to the view of its frame", fx, fy);
+        }
+    }
+
+    void CheckAtlas(uint32_t frames, uint32_t frameSize) {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<XMFLOAT3> colors;
+        MakeOctahedron(vertices, indices, colors);
+        const auto atlas = ImpostorBaker::BakeGeometry(vertices, indices, colors, { 0.f, 0.f, 0.f }, 1.f, frames, frameSize);
+
+        const uint32_t size = frames * frameSize;
+        Check(atlas->Size() == size, "atlas size is frames times frame size");
+        Check(atlas->albedo.size() == size_t(size) * size * 4 && atlas->normals.size() == atlas->albedo.size(),
+            "atlas images hold 4 bytes per texel");
+
+        auto texel = [&](const std::vector<uint8_t>& image, uint32_t x, uint32_t y) { return &image[(size_t(y) * size + x) * 4]; };
+
+        for (uint32_t fy = 0; fy < frames; ++fy) {
+            for (uint32_t fx = 0; fx < frames; ++fx) {
+                const uint32_t x0 = fx * frameSize, y0 = fy * frameSize;
+                const uint32_t half = frameSize / 2;
+
+                // The asset fills the middle of its tile; the corners of the tile are past the
+                // sphere, so they stay empty even after dilation.
+                Check(texel(atlas->albedo, x0 + half, y0 + half)[3] == 255, "frame center is covered", fx, fy);
+                Check(texel(atlas->albedo, x0, y0)[3] == 0 && texel(atlas->albedo, x0 + frameSize - 1, y0 + frameSize - 1)[3] == 0,
+                    "frame corners are empty", fx, fy);
+
+                // The middle of frame (x, y) shows the face seen from FrameDirection(x, y).
+                XMFLOAT3 d;
+                XMStoreFloat3(&d, ImpostorBaker::FrameDirection(fx, fy, frames));
+                const uint8_t* c = texel(atlas->albedo, x0 + half, y0 + half);
+                const float axes[3] = { d.x, d.y, d.z };
+                for (int axis = 0; axis < 3; ++axis) {
+                    // Views grazing a face edge may show the neighbouring face.
+                    if (std::fabs(axes[axis]) < 0.1f) continue;
+                    Check((c[axis] > 127) == (axes[axis] > 0.f), "frame shows the side it was rendered from", fx, fy);
+                }
+
+                // Stored normals face the viewer.
+                const uint8_t* n = texel(atlas->normals, x0 + half, y0 + half);
+                const float facing = (n[0] / 127.5f - 1.f) * d.x + (n[1] / 127.5f - 1.f) * d.y + (n[2] / 127.5f - 1.f) * d.z;
+                Check(facing > 0.f, "stored normal faces the viewer", fx, fy);
+            }
+        }
+    }
+}
+
+int main() {
+    CheckMapping(ImpostorBaker::kDefaultFrames);
+    CheckMapping(5);
+    CheckAtlas(ImpostorBaker::kDefaultFrames, 32);
+    CheckAtlas(3, 16);
+
+    if (g_failures) return 1;
+    std::cout << "Impostor: all checks passed\n";
+    return 0;
+}
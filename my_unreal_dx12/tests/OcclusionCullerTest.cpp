@@ -0,0 +1,63 @@
+// Rasterizes a wall in front of the camera and checks which boxes the OcclusionCuller rejects.
+#include "OcclusionCuller.h"
+#include <cstdint>
+#include <iostream>
+
+using namespace DirectX;
+
+namespace {
+    int g_failures = 0;
+
+    void Check(bool condition, const char* what) {
+        if (condition) return;
+        std::cout << "[Error]: " << what << "\n";
+        ++g_failures;
+    }
+}
+
+int main() {
+    // Camera at the origin looking down +z.
+    const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.f, 0.f, 0.f, 1.f),
+        XMVectorSet(0.f, 0.f, 1.f, 1.f), XMVectorSet(0.f, 1.f, 0.f, 0.f));
+    const XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 2.f, 0.1f, 100.f);
+
+    // A 6x6 wall at z = 10, covering the middle of the screen.
+    const XMFLOAT3 wall[4] = { { -3.f, -3.f, 0.f }, { 3.f, -3.f, 0.f }, { 3.f, 3.f, 0.f }, { -3.f, 3.f, 0.f } };
+    const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+    OcclusionCuller culler;
+    culler.SetResolution(256, 128);
+    culler.BeginFrame(XMMatrixMultiply(view, proj));
+    culler.AddOccluder(wall, sizeof(XMFLOAT3), indices, 6, XMMatrixTranslation(0.f, 0.f, 10.f));
+    culler.Rasterize();
+    Check(culler.TriangleCount() == 2, "both wall triangles are rasterized");
+
+    const BoundingBox behind({ 0.f, 0.f, 20.f }, { 1.f, 1.f, 1.f });
+    const BoundingBox aside({ 12.f, 0.f, 20.f }, { 1.f, 1.f, 1.f });
+    const BoundingBox inFront({ 0.f, 0.f, 5.f }, { 1.f, 1.f, 1.f });
+    const BoundingBox straddling({ 6.f, 0.f, 20.f }, { 2.f, 1.f, 1.f });
+
+    Check(!culler.IsVisible(behind), "a box fully behind the wall is rejected");
+    Check(culler.IsVisible(aside), "a box beside the wall is kept");
+    Check(culler.IsVisible(inFront), "a box in front of the wall is kept");
+    Check(culler.IsVisible(straddling), "a box partly past the edge of the wall is kept");
+
+    // The batched test agrees with the single one.
+    const BoundingBox boxes[4] = { behind, aside, inFront, straddling };
+    uint8_t visible[4] = {};
+    culler.Test(boxes, 4, visible);
+    for (int i = 0; i < 4; ++i)
+        Check((visible[i] != 0) == culler.IsVisible(boxes[i]), "Test matches IsVisible");
+
+    // A resize keeps the occluders working at the new resolution.
+    culler.SetResolution(256, 64);
+    Check(culler.Width() == 256 && culler.Height() == 64, "the resolution follows SetResolution");
+    culler.BeginFrame(XMMatrixMultiply(view, proj));
+    culler.AddOccluder(wall, sizeof(XMFLOAT3), indices, 6, XMMatrixTranslation(0.f, 0.f, 10.f));
+    culler.Rasterize();
+    Check(!culler.IsVisible(behind) && culler.IsVisible(aside), "culling still works after a resize");
+
+    if (g_failures) return 1;
+    std::cout << "OcclusionCuller: all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Records the calls CommandStateCache lets through to a mock command list.
+#include "StateCache.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    int g_failures = 0;
+
+    void Check(bool condition, const char* what) {
+        if (condition) return;
+        std::cout << "[Error]: " << what << "\n";
+        ++g_failures;
+    }
+
+    /** Command list that records the name of every call. */
+    struct RecordingCommandList
+    {
+        std::vector<std::string> calls;
+
+        void SetGraphicsRootSignature(ID3D12RootSignature*) { calls.push_back("RootSignature"); }
+        void SetPipelineState(ID3D12PipelineState*) { calls.push_back("PipelineState"); }
+        void SetGraphicsRootConstantBufferView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS) { calls.push_back("CBV" + std::to_string(index)); }
+        void SetGraphicsRootShaderResourceView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS) { calls.push_back("SRV" + std::to_string(index)); }
+        void SetGraphicsRootDescriptorTable(UINT index, D3D12_GPU_DESCRIPTOR_HANDLE) { calls.push_back("Table" + std::to_string(index)); }
+        void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY) { calls.push_back("Topology"); }
+        void IASetVertexBuffers(UINT, UINT, const D3D12_VERTEX_BUFFER_VIEW*) { calls.push_back("VertexBuffer"); }
+        void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW*) { calls.push_back("IndexBuffer"); }
+
+        // Returns the calls since the last Take.
+        std::vector<std::string> Take() { std::vector<std::string> out; out.swap(calls); return out; }
+    };
+
+    using Calls = std::vector<std::string>;
+    using Cache = CommandStateCache<RecordingCommandList>;
+
+    // The cache only compares the pointers, so fake addresses stand in for the objects.
+    template<typename T> T* Fake(uintptr_t address) { return reinterpret_cast<T*>(address); }
+
+    const D3D12_VERTEX_BUFFER_VIEW kVertexBuffer{ 0x1000, 256, 32 };
+    const D3D12_INDEX_BUFFER_VIEW kIndexBuffer{ 0x2000, 128, DXGI_FORMAT_R32_UINT };
+
+    void BindAll(Cache& cache, RecordingCommandList& cmd, ID3D12RootSignature* rootSignature) {
+        cache.SetRootSignature(&cmd, rootSignature);
+        cache.SetPipelineState(&cmd, Fake<ID3D12PipelineState>(0x20));
+        cache.SetRootConstantBufferView(&cmd, 0, 0x3000);
+        cache.SetRootShaderResourceView(&cmd, 1, 0x4000);
+        cache.SetRootDescriptorTable(&cmd, 2, { 0x5000 });
+        cache.SetPrimitiveTopology(&cmd, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        cache.SetVertexBuffer(&cmd, kVertexBuffer);
+        cache.SetIndexBuffer(&cmd, kIndexBuffer);
+    }
+
+    const Calls kAllCalls = { "RootSignature", "PipelineState", "CBV0", "SRV1", "Table2", "Topology", "VertexBuffer", "IndexBuffer" };
+
+    void RepeatedBindsAreSkipped() {
+        RecordingCommandList cmd;
+        Cache cache;
+        BindAll(cache, cmd, Fake<ID3D12RootSignature>(0x10));
+        Check(cmd.Take() == kAllCalls, "first binds are issued");
+
+        BindAll(cache, cmd, Fake<ID3D12RootSignature>(0x10));
+        Check(cmd.Take().empty(), "repeated binds are skipped");
+        Check(cache.GetStats().issued == 8 && cache.GetStats().elided == 8, "stats count issued and skipped binds");
+
+        Check(!cache.SetVertexBuffer(&cmd, kVertexBuffer) && !cache.SetIndexBuffer(&cmd, kIndexBuffer),
+            "buffer binds report when they are skipped");
+
+        // Any field of a view makes it a new binding.
+        D3D12_VERTEX_BUFFER_VIEW vb = kVertexBuffer;
+        vb.StrideInBytes = 16;
+        Check(cache.SetVertexBuffer(&cmd, vb), "a new vertex stride is issued");
+        D3D12_INDEX_BUFFER_VIEW ib = kIndexBuffer;
+        ib.Format = DXGI_FORMAT_R16_UINT;
+        Check(cache.SetIndexBuffer(&cmd, ib), "a new index format is issued");
+        cache.SetPrimitiveTopology(&cmd, D3D_PRIMITIVE_TOPOLOGY_LINELIST);
+        cache.SetPipelineState(&cmd, Fake<ID3D12PipelineState>(0x21));
+        Check(cmd.Take() == Calls{ "VertexBuffer", "IndexBuffer", "Topology", "PipelineState" }, "changed state is issued");
+
+        // Root arguments are compared per parameter.
+        cache.SetRootConstantBufferView(&cmd, 0, 0x3100);
+        cache.SetRootShaderResourceView(&cmd, 1, 0x4000);
+        Check(cmd.Take() == Calls{ "CBV0" }, "only the changed root argument is issued");
+    }
+
+    void RootSignatureChangeDropsRootArguments() {
+        RecordingCommandList cmd;
+        Cache cache;
+        BindAll(cache, cmd, Fake<ID3D12RootSignature>(0x10));
+        cmd.Take();
+
+        cache.SetRootSignature(&cmd, Fake<ID3D12RootSignature>(0x11));
+        cache.SetRootConstantBufferView(&cmd, 0, 0x3000);
+        cache.SetRootShaderResourceView(&cmd, 1, 0x4000);
+        cache.SetRootDescriptorTable(&cmd, 2, { 0x5000 });
+        // Pipeline and input assembler state survive a root signature change.
+        cache.SetPipelineState(&cmd, Fake<ID3D12PipelineState>(0x20));
+        cache.SetVertexBuffer(&cmd, kVertexBuffer);
+        Check(cmd.Take() == Calls{ "RootSignature", "CBV0", "SRV1", "Table2" },
+            "a new root signature forces the root arguments again");
+    }
+
+    void InvalidateForcesBinds() {
+        RecordingCommandList cmd;
+        Cache cache;
+        BindAll(cache, cmd, Fake<ID3D12RootSignature>(0x10));
+        cmd.Take();
+
+        // What CommandContext::Begin does when the list is reset.
+        cache.Invalidate();
+        cache.ResetStats();
+        BindAll(cache, cmd, Fake<ID3D12RootSignature>(0x10));
+        Check(cmd.Take() == kAllCalls, "binds after Invalidate are issued");
+        Check(cache.GetStats().issued == 8 && cache.GetStats().elided == 0, "ResetStats restarts the counts");
+    }
+
+    void ParametersPastTheCacheAreIssued() {
+        RecordingCommandList cmd;
+        Cache cache;
+        const UINT index = Cache::kMaxRootParameters;
+        cache.SetRootConstantBufferView(&cmd, index, 0x3000);
+        cache.SetRootConstantBufferView(&cmd, index, 0x3000);
+        Check(cmd.Take().size() == 2, "root parameters past the cached range are always issued");
+    }
+}
+
+int main() {
+    RepeatedBindsAreSkipped();
+    RootSignatureChangeDropsRootArguments();
+    InvalidateForcesBinds();
+    ParametersPastTheCacheAreIssued();
+
+    if (g_failures) return 1;
+    std::cout << "StateCache: all checks passed\n";
+    return 0;
+}
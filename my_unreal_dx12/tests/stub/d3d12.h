@@ -0,0 +1,40 @@
+#pragma once
+// Stand-in for the few d3d12.h types the engine headers under test name, so they build off
+// Windows. Only declarations are provided; nothing here talks to a device.
+#include <cstdint>
+
+typedef unsigned int UINT;
+typedef uint64_t D3D12_GPU_VIRTUAL_ADDRESS;
+
+struct D3D12_GPU_DESCRIPTOR_HANDLE { uint64_t ptr; };
+
+enum D3D_PRIMITIVE_TOPOLOGY
+{
+    D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+    D3D_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+    D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+};
+typedef D3D_PRIMITIVE_TOPOLOGY D3D12_PRIMITIVE_TOPOLOGY;
+
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_R32_UINT = 42,
+    DXGI_FORMAT_R16_UINT = 57,
+};
+
+struct D3D12_VERTEX_BUFFER_VIEW
+{
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+    UINT SizeInBytes;
+    UINT StrideInBytes;
+};
+
+struct D3D12_INDEX_BUFFER_VIEW
+{
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+    UINT SizeInBytes;
+    DXGI_FORMAT Format;
+};
+
+struct ID3D12RootSignature;
+struct ID3D12PipelineState;